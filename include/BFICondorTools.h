@@ -7,10 +7,16 @@
 #include <cmath>
 #include <memory>
 #include <filesystem>
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <limits>
 
 #include "yaml-cpp/yaml.h"
 
 #include "SampleTool.h"
+#include "SampleCatalog.h"
+#include "YieldBinary.h"
 #include "DefineUserHists.h"
 
 namespace fs = std::filesystem;
@@ -24,22 +30,8 @@ inline std::string GetSampleNameFromKey(const std::string& keyOrPath) {
 }
 
 inline std::string GetProcessNameFromKey(const std::string& keyOrPath) {
-    SampleTool ST;
-    ST.LoadAllFromMaster();
-
-    auto resolveGroup = [&ST](const std::string &Key) -> std::string {
-        std::string keyBase = fs::path(Key).filename().string();    
-        for (const auto &kv : ST.MasterDict) {       // kv.first = canonical group
-            for (const auto &entry : kv.second) {    // entry = full path
-                std::string entryBase = fs::path(entry).filename().string();
-                if (keyBase == entryBase)
-                    return kv.first;
-            }
-        }
-        return keyBase; // fallback
-    };
-
-    return resolveGroup(keyOrPath);
+    const std::string *group = SampleCatalog::Instance().GroupOfFile(keyOrPath);
+    return group ? *group : fs::path(keyOrPath).filename().string(); // fallback
 }
 
 static bool buildCutsForBin(BuildFitInput* BFI,
@@ -65,46 +57,84 @@ static bool buildCutsForBin(BuildFitInput* BFI,
     return true;
 }
 
+// Per-bin yields: sample -> file -> {count, sumW, sumW2} plus per-sample totals
+// (written as [count, sumW, err, sumW2], the error only for readers of the first three fields)
+typedef std::map<std::string, std::map<std::string, std::array<double,3>>> FileYieldMap;
+typedef std::map<std::string, std::array<double,3>> TotalYieldMap;
+struct BinYields {
+    FileYieldMap fileResults;
+    TotalYieldMap totals;
+};
+
 static bool writePartialJSON(const std::string& outPath,
-                             const std::string& binname,
-                             const std::map<std::string, std::map<std::string, std::array<double,3>>>& fileResults,
-                             const std::map<std::string, std::array<double,3>>& totals) 
+                             const std::map<std::string, BinYields>& binResults) 
 {
     std::ofstream ofs(outPath);
     if (!ofs) return false;
-    ofs << "{\n  \"" << binname << "\": {\n";
-    bool firstSample = true;
-    for (const auto &kv : totals) {
-        if (!firstSample) ofs << ",\n";
-        firstSample = false;
-        const std::string &sname = kv.first;
-        std::string sampleId = GetSampleNameFromKey(sname); 
-        const auto &totalVals = kv.second;
-        ofs << "    \"" << sampleId << "\": {\n      \"files\": {\n";
-        bool firstFile = true;
-        auto itFiles = fileResults.find(sname);
-        if (itFiles != fileResults.end()) {
-            for (const auto &fkv : itFiles->second) {
-                if (!firstFile) ofs << ",\n";
-                firstFile = false;
-                ofs << "        \"" << fkv.first << "\": ["
-                    << (long long)fkv.second[0] << ", "
-                    << fkv.second[1] << ", "
-                    << fkv.second[2] << "]";
+    ofs << std::setprecision(std::numeric_limits<double>::max_digits10);
+    ofs << "{\n";
+    bool firstBin = true;
+    for (const auto &bkv : binResults) {
+        if (!firstBin) ofs << ",\n";
+        firstBin = false;
+        const auto &fileResults = bkv.second.fileResults;
+        const auto &totals = bkv.second.totals;
+        ofs << "  \"" << bkv.first << "\": {\n";
+        bool firstSample = true;
+        for (const auto &kv : totals) {
+            if (!firstSample) ofs << ",\n";
+            firstSample = false;
+            const std::string &sname = kv.first;
+            std::string sampleId = GetSampleNameFromKey(sname); 
+            const auto &totalVals = kv.second;
+            ofs << "    \"" << sampleId << "\": {\n      \"files\": {\n";
+            bool firstFile = true;
+            auto itFiles = fileResults.find(sname);
+            if (itFiles != fileResults.end()) {
+                for (const auto &fkv : itFiles->second) {
+                    if (!firstFile) ofs << ",\n";
+                    firstFile = false;
+                    ofs << "        \"" << fkv.first << "\": ["
+                        << (long long)fkv.second[0] << ", "
+                        << fkv.second[1] << ", "
+                        << std::sqrt(fkv.second[2]) << ", "
+                        << fkv.second[2] << "]";
+                }
             }
+            ofs << "\n      },\n";
+            ofs << "      \"totals\": ["
+                << (long long)totalVals[0] << ", "
+                << totalVals[1] << ", "
+                << std::sqrt(totalVals[2]) << ", "
+                << totalVals[2] << "]\n";
+            ofs << "    }";
         }
-        ofs << "\n      },\n";
-        ofs << "      \"totals\": ["
-            << (long long)totalVals[0] << ", "
-            << totalVals[1] << ", "
-            << totalVals[2] << "]\n";
-        ofs << "    }";
+        ofs << "\n  }";
     }
-    ofs << "\n  }\n}\n";
+    ofs << "\n}\n";
     ofs.close();
     return true;
 }
 
+// Same content as writePartialJSON in the binary yield format (YieldBinary.h)
+static bool writePartialBinary(const std::string& outPath,
+                               const std::map<std::string, BinYields>& binResults)
+{
+    YieldBinary out;
+    for (const auto &bkv : binResults) {
+        for (const auto &kv : bkv.second.totals) {
+            const std::string sampleId = GetSampleNameFromKey(kv.first);
+            auto itFiles = bkv.second.fileResults.find(kv.first);
+            if (itFiles != bkv.second.fileResults.end()) {
+                for (const auto &fkv : itFiles->second)
+                    out.Add(bkv.first, sampleId, fkv.first, fkv.second[0], fkv.second[1], fkv.second[2]);
+            }
+            out.Add(bkv.first, sampleId, "", kv.second[0], kv.second[1], kv.second[2]);
+        }
+    }
+    return out.Write(outPath);
+}
+
 static std::vector<DerivedVar> loadDerivedVariablesYAML(const std::string &yamlPath) {
     std::vector<DerivedVar> vars;
     YAML::Node root = YAML::LoadFile(yamlPath);
@@ -118,3 +148,47 @@ static std::vector<DerivedVar> loadDerivedVariablesYAML(const std::string &yamlP
     }
     return vars;
 }
+
+// One bin as written in config/bin_cfgs/*.yaml
+struct BinSpec {
+    std::string name;
+    std::vector<std::string> cuts, lepCuts, predefCuts, userCuts;
+    std::vector<std::string> finalCutsExpanded; // filled once BuildFitInput has built the cuts
+};
+
+// Drop '#' comments line by line (same as strip_inline_comments in python/submitJobs.py)
+static std::string stripInlineComments(const std::string &s) {
+    std::stringstream ss(s);
+    std::string line, out;
+    while (std::getline(ss, line)) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        if (!out.empty()) out += "\n";
+        out += line;
+    }
+    return out;
+}
+
+// Load every bin of a bins YAML, optionally restricted to the names in `selected`
+static std::vector<BinSpec> loadBinsYAML(const std::string &yamlPath, const std::vector<std::string> &selected = {}) {
+    std::vector<BinSpec> bins;
+    YAML::Node root = YAML::LoadFile(yamlPath);
+    for (const auto &bnode : root) {
+        BinSpec b;
+        b.name = bnode.first.as<std::string>();
+        if (!selected.empty() && std::find(selected.begin(), selected.end(), b.name) == selected.end()) continue;
+        const YAML::Node &cfg = bnode.second;
+        if (!cfg.IsMap()) continue;
+        auto field = [&cfg](const char* key) -> std::vector<std::string> {
+            if (!cfg[key] || cfg[key].IsNull()) return {};
+            return splitTopLevel(stripInlineComments(cfg[key].as<std::string>()));
+        };
+        b.cuts       = field("cuts");
+        b.lepCuts    = field("lep-cuts");
+        for (auto &lc : b.lepCuts) lc.erase(std::remove(lc.begin(), lc.end(), ' '), lc.end());
+        b.predefCuts = field("predefined-cuts");
+        b.userCuts   = field("user-cuts");
+        bins.push_back(b);
+    }
+    return bins;
+}
@@ -0,0 +1,152 @@
+#ifndef BINMASKENGINE_H
+#define BINMASKENGINE_H
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TTreeReader.h"
+#include <ROOT/RDataFrame.hxx>
+
+#include "FilterTrie.h"
+
+// Yields of many bins built from a shared vocabulary of atomic predicates (FilterTrie::Atoms).
+// Every predicate that is safe on any event (FilterTrie::Movable) is bit k of a word column,
+// evaluated exactly once per event whichever bins use it and wherever they put it. A predicate that
+// is not (SIP3D_lep[2]<4 needs Nlep>=3 first) gets one bit per distinct set of predicates before
+// it in its bins, set only when all of those bits are; the && short-circuits, so it runs behind them
+// as in a Filter chain. A bin is then the match (bits & mask) == value on the bits of its
+// predicates, accumulated without branches. Cost per event: the distinct predicates plus the
+// guarded ones whose guard passed, and a few integer operations per bin, instead of one filter
+// chain per bin.
+class BinMaskEngine {
+public:
+    // predicates[b]: canonical atomic predicates of bin b, in order, all of which must pass
+    explicit BinMaskEngine(const std::vector<std::vector<std::string>> &predicates) : nBins_(predicates.size()) {
+        std::map<std::pair<std::set<size_t>, std::string>, size_t> index; // (guard, predicate) -> bit
+        std::vector<std::set<size_t>> binBits(nBins_);
+        for (size_t b = 0; b < nBins_; ++b) {
+            std::set<size_t> &before = binBits[b];
+            for (const auto &p : predicates[b]) {
+                const std::set<size_t> guard = FilterTrie::Movable(p) ? std::set<size_t>() : before;
+                auto it = index.find({guard, p});
+                if (it == index.end()) {
+                    it = index.emplace(std::make_pair(guard, p), bits_.size()).first;
+                    bits_.push_back({std::vector<size_t>(guard.begin(), guard.end()), p});
+                }
+                before.insert(it->second);
+            }
+        }
+        nWords_ = std::max<size_t>(1, (bits_.size() + 63) / 64);
+        mask_.assign(nBins_ * nWords_, 0);
+        for (size_t b = 0; b < nBins_; ++b)
+            for (size_t k : binBits[b]) mask_[b * nWords_ + k / 64] |= ULong64_t(1) << (k % 64);
+        value_ = mask_; // every predicate of the bin passes; bins without predicates match every event
+    }
+
+    size_t NBins() const { return nBins_; }
+    size_t NBits() const { return bits_.size(); }
+    size_t NGuarded() const {
+        return std::count_if(bits_.begin(), bits_.end(), [](const Bit &b) { return !b.guard.empty(); });
+    }
+    size_t NWords() const { return nWords_; }
+    const std::vector<ULong64_t> &Mask() const { return mask_; }
+    const std::vector<ULong64_t> &Value() const { return value_; }
+
+    // Expression for the ROOT::RVec<ULong64_t> column of predicate bits, every bit evaluated at most once
+    std::string Expr() const {
+        std::string e = "([&]() { ROOT::RVec<ULong64_t> bm_bits(" + std::to_string(nWords_) + ", 0); ";
+        for (size_t k = 0; k < bits_.size(); ++k) {
+            const std::string n = "bm_bit" + std::to_string(k);
+            e += "const bool " + n + " = ";
+            for (size_t g : bits_[k].guard) e += "bm_bit" + std::to_string(g) + " && ";
+            e += "bool(" + bits_[k].predicate + "); bm_bits[" + std::to_string(k / 64) + "] |= ULong64_t(" + n +
+                 ") << " + std::to_string(k % 64) + "; ";
+        }
+        return e + "return bm_bits; })()";
+    }
+
+private:
+    struct Bit {
+        std::vector<size_t> guard; // bits that must be set before the predicate runs (earlier bits only)
+        std::string predicate;
+    };
+    size_t nBins_;
+    std::vector<Bit> bits_;
+    size_t nWords_ = 1;
+    std::vector<ULong64_t> mask_, value_; // [bin * nWords + word]
+};
+
+struct BinMaskResult {
+    std::vector<ULong64_t> count; // [bin]
+    std::vector<double> sumW, sumW2;
+};
+
+// RDF action over (bits, weight, weight^2): per-slot counters for every bin, merged in Finalize()
+class BinMaskHelper : public ROOT::Detail::RDF::RActionImpl<BinMaskHelper> {
+public:
+    using Result_t = BinMaskResult;
+
+    BinMaskHelper(const BinMaskEngine &engine, unsigned int nSlots)
+        : nBins_(engine.NBins()), nWords_(engine.NWords()), mask_(engine.Mask()), value_(engine.Value()),
+          count_(nSlots, std::vector<ULong64_t>(nBins_, 0)),
+          w_(nSlots, std::vector<double>(nBins_, 0.)),
+          w2_(nSlots, std::vector<double>(nBins_, 0.)),
+          result_(std::make_shared<Result_t>()) {}
+    BinMaskHelper(BinMaskHelper &&) = default;
+    BinMaskHelper(const BinMaskHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot, const ROOT::RVec<ULong64_t> &bits, double w, double w2) {
+        ULong64_t *c = count_[slot].data();
+        double *sw = w_[slot].data(), *sw2 = w2_[slot].data();
+        const ULong64_t *m = mask_.data(), *v = value_.data();
+        if (nWords_ == 1) {
+            const ULong64_t x = bits[0];
+            for (size_t b = 0; b < nBins_; ++b) {
+                const ULong64_t pass = (x & m[b]) == v[b];
+                c[b] += pass;
+                sw[b] += pass ? w : 0.; // a select; NaN/inf weights stay out of failed bins
+                sw2[b] += pass ? w2 : 0.;
+            }
+            return;
+        }
+        for (size_t b = 0; b < nBins_; ++b) {
+            ULong64_t miss = 0;
+            for (size_t k = 0; k < nWords_; ++k) miss |= (bits[k] & m[b * nWords_ + k]) ^ v[b * nWords_ + k];
+            const ULong64_t pass = miss == 0;
+            c[b] += pass;
+            sw[b] += pass ? w : 0.;
+            sw2[b] += pass ? w2 : 0.;
+        }
+    }
+
+    void Finalize() {
+        result_->count.assign(nBins_, 0);
+        result_->sumW.assign(nBins_, 0.);
+        result_->sumW2.assign(nBins_, 0.);
+        for (size_t s = 0; s < count_.size(); ++s) {
+            for (size_t b = 0; b < nBins_; ++b) {
+                result_->count[b] += count_[s][b];
+                result_->sumW[b] += w_[s][b];
+                result_->sumW2[b] += w2_[s][b];
+            }
+        }
+    }
+
+    std::string GetActionName() { return "BinMask"; }
+
+private:
+    size_t nBins_, nWords_;
+    std::vector<ULong64_t> mask_, value_;
+    std::vector<std::vector<ULong64_t>> count_;
+    std::vector<std::vector<double>> w_, w2_;
+    std::shared_ptr<Result_t> result_;
+};
+
+#endif
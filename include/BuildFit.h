@@ -3,9 +3,11 @@
 
 #include "JSONFactory.h"
 #include "BuildFitTools.h"
+#include "YieldTable.h"
 #include <iostream>
 #include <vector>
 #include <map>
+#include <set>
 #include <string>
 
 #include "CombineHarvester/CombineTools/interface/CombineHarvester.h"
@@ -19,6 +21,16 @@ using ch::syst::SystMapFunc;
 using ch::syst::bin;
 using json = nlohmann::json;
 
+// Everything the datacards take from the JSON, built once and shared (read-only) by all signal points
+struct FitInputs {
+	explicit FitInputs(const json& j) : table(j) {}
+	YieldTable table;                    // bin index x process index -> rate, error
+	ch::Categories cats{};               // {bin index, bin name}
+	std::vector<float> obs{};            // Asimov observation per bin index
+	std::vector<std::string> bkgprocs{}; // first appearance order
+	std::vector<std::string> binset{};
+};
+
 class BuildFit{
 	
 	public:
@@ -30,7 +42,11 @@ class BuildFit{
 	std::vector<std::string> ExtractSignalDetails( std::string signalPoint);
 	std::vector<std::string> GetBinSet( JSONFactory* j);
        
+	FitInputs PrepareInputs(JSONFactory* j);
+
 	void BuildAsimovFit(JSONFactory* j, std::string signaPoint, std::string datacard_dir);
+	//thread safe for distinct BuildFit objects: reads only `in`, progress goes to `log`
+	void BuildAsimovFit(const FitInputs& in, const std::string& signalPoint, const std::string& datacard_dir, std::ostream& log = std::cout);
 	
 	std::vector<std::string> sigkeys = { "Cascades", "SMS" };
 
@@ -3,6 +3,7 @@
 #include "BuildFitTools.h"
 #include "Math/Vector4Dfwd.h"
 #include "Math/PxPyPzE4D.h"
+#include "YieldCube.h"
 
 using namespace std;
 using ROOT::RDF::RNode;
@@ -12,10 +13,14 @@ typedef ROOT::RDF::RNode RN;
 typedef std::vector<std::string> stringlist;
 typedef std::pair<std::string,std::string> proc_cut_pair;
 typedef std::map< proc_cut_pair, std::unique_ptr<RN> > nodemap;
-typedef std::map<proc_cut_pair, double> errormap;
+typedef std::map<proc_cut_pair, double> sumw2map; // sum of squared weights
 typedef std::map<proc_cut_pair, double> countmap;
 typedef std::map<proc_cut_pair, double> summap;
 
+class CutCache;
+class FilterTrie;
+struct ZonePrunedTree;
+
 struct CutDef {
     std::string name;                   // user-defined name for the cut
     std::vector<std::string> columns;   // columns needed to compute/apply the cut
@@ -40,6 +45,20 @@ class BuildFitInput{
 	nodemap bkg_filtered_dataframes;//these are the analysis bins constructed from filters
 	nodemap sig_filtered_dataframes;
 
+	//optional compiled-expression cache used by FilterRegions (not owned)
+	CutCache* cutCache = nullptr;
+	//directory of BFI_skim.x outputs; a sample is read from its skim when the provenance
+	//matches and no column registered with RequireColumns was dropped
+	std::string skimDir;
+	//when > 0, FilterRegions orders each bin's predicates by cost and pass rate measured on this
+	//many events of the first loaded sample (cheap and selective first, see PredicateProfile.h)
+	unsigned adaptiveOrderEvents = 0;
+	//bins the samples will be filtered with (call before loading): samples read from the source
+	//then skip the clusters in which, by their zone map in skimDir (while it matches the source's
+	//entries), none of them can pass;
+	//FilterRegions throws for a bin applying the cuts of none of them
+	void PruneClustersFor(const std::vector<stringlist>& binCuts);
+
 	BuildFitInput();
 	
 	//load helpers
@@ -58,17 +77,26 @@ class BuildFitInput{
 	
 	//helpers print and debug df datastructures
 	void ReportRegions(int verbosity=1);//report on base frame, initates action
-        void ReportRegions(int verbosity, countmap &countResults, summap &sumResults, errormap &errorResults, bool DoSig);
+        void ReportRegions(int verbosity, countmap &countResults, summap &sumResults, sumw2map &sumW2Results, bool DoSig);
+	//book Count/Sum on every filtered (process, bin) node of bkg and sig, then run all graphs at once.
+	//Unlike ReportRegions(..., DoSig), which reads the unfiltered _base_rdf_*Dict per sample and splits
+	//the sample key at its last '_', the results are the yields of each (process, bin) after the bin's cuts
+	void ReportRegionsBatched(int verbosity, countmap &countResults, summap &sumResults, sumw2map &sumW2Results,
+	                          countmap &countResults_S, summap &sumResults_S, sumw2map &sumW2Results_S);
+	//one YieldCube per sample over `axes` after `preselection`, every sample read once; the axis
+	//expressions need RequireColumns before loading like cuts. Answers what-if cuts via YieldCube::Query
+	void FillYieldCubes(const std::vector<CubeAxis>& axes, const stringlist& preselection,
+	                    std::map<std::string, YieldCube>& bkgCubes, std::map<std::string, YieldCube>& sigCubes);
 	void PrintCountReports( const countmap& resultmap);
 	void PrintSumReports( const summap& sumResults);
-	void FullReport( const countmap& countResults, const summap& sumResults, const errormap& errorResults);
+	void FullReport( const countmap& countResults, const summap& sumResults, const sumw2map& sumW2Results);
 	
 	//helpers bin objects
 	void CreateBin(const std::string& binname);
 	void CreateBin(const std::string& binName, const std::vector<std::string>& cuts);
 	std::map<std::string, Process*> CombineBkgs( std::map<std::string, Process*>& bkgProcs );
-	void ConstructBkgBinObjects( countmap countResults, summap sumResults, errormap errorResults );
-	void AddSigToBinObjects( countmap countResults, summap sumResults, errormap errorResults, std::map<std::string, Bin*>& analysisbins);
+	void ConstructBkgBinObjects( countmap countResults, summap sumResults, sumw2map sumW2Results );
+	void AddSigToBinObjects( countmap countResults, summap sumResults, sumw2map sumW2Results, std::map<std::string, Bin*>& analysisbins);
 	void PrintBins(int verbosity=1);
 
         //helpers cut objects
@@ -105,6 +133,13 @@ class BuildFitInput{
 	std::string BuildLeptonCut(const std::string& shorthand, const std::string& side = "");
 	ROOT::RDF::RNode DefineLeptonPairCounts(ROOT::RDF::RNode rdf, const std::string& side = "");
 	ROOT::RDF::RNode DefinePairKinematics(ROOT::RDF::RNode rdf, const std::string& side = "");
+	//lazy column materialisation: register the cut/hist expressions that will be used, and only
+	//the per-side lepton columns (and kernel stages) they reference get defined on load
+	static std::set<std::string> ExpressionIdentifiers(const std::string& expr);
+	void RequireColumns(const stringlist& exprs);
+	void RequireAllColumns();
+	const std::set<std::string>& RequiredColumns() const { return requiredColumns_; }
+	ROOT::RDF::RNode DefineLeptonColumns(ROOT::RDF::RNode rdf);
         struct Registrar {
                 Registrar(const std::string& name, CutFn fn) {
                     cutMap_[name] = fn;
@@ -116,6 +151,19 @@ class BuildFitInput{
 
     private:
         static std::unordered_map<std::string, CutFn> cutMap_;
+        std::set<std::string> requiredColumns_;
+        bool lazyColumns_ = false;
+        std::map<std::string, stringlist> skimPreselection_; // subkey -> preselection of the skim it was loaded from
+        //"bkg:"/"sig:" + subkey -> Filter nodes shared by the sample's bins, rooted at rdf_*Dict as of the
+        //first FilterRegions call (define columns before creating bins)
+        std::map<std::string, std::shared_ptr<FilterTrie>> filterTries_;
+        std::pair<std::string, std::string> profileSource_; // (tree, file) profiled for adaptiveOrderEvents
+        std::map<std::string, double> predicateRanks_;      // predicate -> PredicateStats::Rank()
+        void RankPredicates(stringlist& predicates);
+        std::vector<stringlist> zoneBins_;                            // atomic predicates of PruneClustersFor bins
+        std::map<std::string, std::shared_ptr<ZonePrunedTree>> zonePruned_; // subkey -> clusters read
+        ROOT::RDataFrame OpenSample(const std::string& source, const std::string& tree, const std::string& subkey);
+        std::string ResolveSkim(const std::string& source, const std::string& tree, const std::string& subkey);
 };
 #define REGISTER_CUT(classname, funcname, cutname) \
     static BuildFitInput::Registrar _registrar_##funcname( \
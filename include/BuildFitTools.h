@@ -2,6 +2,7 @@
 #define BFTOOLS_H
 #include <string>
 #include <map>
+#include <set>
 #include <sstream> 
 #include <cmath>
 #include <vector>
@@ -24,9 +25,12 @@
 #include <TLorentzVector.h>
 #include "TInterpreter.h"
 #include <ROOT/RDataFrame.hxx>
+#include <ROOT/RDFHelpers.hxx> // RunGraphs
+#include <ROOT/RResultHandle.hxx>
 #include <ROOT/RVec.hxx>
 
 #include "ValidationTools.h"
+#include "SignalIndex.h"
 
 typedef std::vector<std::string> stringlist;
 
@@ -36,18 +40,16 @@ class Process{
 	std::string procname{};
 	long long unsigned int nevents{};
 	double wnevents{};
-	double staterror{};
+	double sumw2{}; // sum of squared weights, the stat. error is only derived for output
 
-	Process(std::string name, long long unsigned int n, double wn, double err) :procname(name), nevents(n), wnevents(wn), staterror(err){}
+	Process(std::string name, long long unsigned int n, double wn, double w2) :procname(name), nevents(n), wnevents(wn), sumw2(w2){}
 	//assume it is initialized from 0
 	void Add(Process* p){
 		nevents += p->nevents;
 		wnevents += p->wnevents;
-		staterror += p->staterror * p->staterror;
-	}
-	void FixError(){
-		staterror = std::sqrt(staterror);
+		sumw2 += p->sumw2;
 	}
+	double StatError() const { return std::sqrt(sumw2); }
 };
 class Bin{
 	
@@ -66,6 +68,9 @@ class BFTool{
 	static std::vector<std::string> SplitString(const std::string& str,const std::string& delimiter);
 	static std::string GetSignalTokensCascades(const std::string& input);
 	static stringlist GetSignalTokensSMS(const std::string& input);
+	// Read the file itself, bypassing the signal index (used to build it)
+	static std::string ReadSignalTokensCascades(const std::string& input, long long* entries = nullptr);
+	static stringlist ReadSignalTreesSMS(const std::string& input, long long* entries = nullptr);
 	static bool  ContainsAnySubstring(const std::string& mainString, const std::vector<std::string>& substrings);
         static stringlist filterSignalsSMS;
         static void SetFilterSignalsSMS(const stringlist& filters);
@@ -98,8 +103,25 @@ inline std::vector<std::string> BFTool::SplitString(const std::string& str,const
 
 inline stringlist BFTool::GetSignalTokensSMS(const std::string& input ){
 
+    SignalIndex::Entry indexed;
+    stringlist all_trees = SignalIndex::Instance().Lookup(input, indexed) ? indexed.smsTrees
+                                                                         : ReadSignalTreesSMS(input);
     std::vector<std::string> tree_names;
-    TFile *file = TFile::Open(input.c_str(), "READ");
+    for (const auto& tree_name : all_trees) {
+        if (!BFTool::filterSignalsSMS.empty())
+            if (std::find(BFTool::filterSignalsSMS.begin(), BFTool::filterSignalsSMS.end(), tree_name) == BFTool::filterSignalsSMS.end())
+                continue;
+        tree_names.push_back(tree_name);
+    }
+    return tree_names;
+
+}
+
+inline stringlist BFTool::ReadSignalTreesSMS(const std::string& input, long long* entries ){
+
+    std::vector<std::string> tree_names;
+    if (entries) *entries = 0;
+    std::unique_ptr<TFile> file(TFile::Open(input.c_str(), "READ"));
     if (!file || file->IsZombie()) {
         std::cerr << "Error: could not open file " << input << std::endl;
         return tree_names;
@@ -118,10 +140,14 @@ inline stringlist BFTool::GetSignalTokensSMS(const std::string& input ){
         std::string tree_name = key->GetName();
         if (!std::regex_match(tree_name, sms_pattern))
             continue; // skip if not matching SMS_X_Y format
-        if (!BFTool::filterSignalsSMS.empty())
-            if (std::find(BFTool::filterSignalsSMS.begin(), BFTool::filterSignalsSMS.end(), tree_name) == BFTool::filterSignalsSMS.end())
-                continue;
+        if (std::find(tree_names.begin(), tree_names.end(), tree_name) != tree_names.end())
+            continue; // older cycles of the same tree
         tree_names.push_back(tree_name);
+        if (entries) {
+            TTree *tree = nullptr;
+            file->GetObject(tree_name.c_str(), tree);
+            if (tree) *entries += tree->GetEntries();
+        }
     }
     file->Close();
     return tree_names;
@@ -130,7 +156,16 @@ inline stringlist BFTool::GetSignalTokensSMS(const std::string& input ){
 
 inline std::string BFTool::GetSignalTokensCascades(const std::string& input ){
 
-    TFile *file = TFile::Open(input.c_str(), "READ");
+    SignalIndex::Entry indexed;
+    if (SignalIndex::Instance().Lookup(input, indexed) && indexed.token != "-")
+        return indexed.token;
+    return ReadSignalTokensCascades(input);
+
+}
+
+inline std::string BFTool::ReadSignalTokensCascades(const std::string& input, long long* entries ){
+
+    std::unique_ptr<TFile> file(TFile::Open(input.c_str(), "READ"));
     if (!file || file->IsZombie()) {
         std::cerr << "Error: could not open file " << input << std::endl;
         return "";
@@ -144,38 +179,39 @@ inline std::string BFTool::GetSignalTokensCascades(const std::string& input ){
         file->Close();
         return "";
     }
+    if (entries) *entries = tree->GetEntries();
+
+    // Only the six mass branches are read, each one until it has given a non-zero value
+    const char* names[6] = {"MP", "MSlepL", "MSneu", "MN2", "MC1", "MN1"};
+    int masses[6] = {0, 0, 0, 0, 0, 0};
+    int tmp[6] = {0, 0, 0, 0, 0, 0};
+    TBranch* branches[6] = {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+    tree->SetBranchStatus("*", 0);
+    for (int b = 0; b < 6; ++b) {
+        tree->SetBranchStatus(names[b], 1);
+        tree->SetBranchAddress(names[b], &tmp[b], &branches[b]);
+        if (!branches[b]) std::cerr << "Error: no branch " << names[b] << " in " << input << std::endl;
+    }
 
-    // Variables to hold final values
-    int MP = 0, MSlepL = 0, MSneu = 0, MN2 = 0, MC1 = 0, MN1 = 0;
-    
-    // Temporary variables to read event-by-event
-    int tMP, tMSlepL, tMSneu, tMN2, tMC1, tMN1;
-    tree->SetBranchAddress("MP",     &tMP);
-    tree->SetBranchAddress("MSlepL", &tMSlepL);
-    tree->SetBranchAddress("MSneu",  &tMSneu);
-    tree->SetBranchAddress("MN2",    &tMN2);
-    tree->SetBranchAddress("MC1",    &tMC1);
-    tree->SetBranchAddress("MN1",    &tMN1);
-    
+    int missing = 0;
+    for (int b = 0; b < 6; ++b) if (branches[b]) ++missing;
     Long64_t nEntries = tree->GetEntries();
-    for (Long64_t i = 0; i < nEntries; ++i) {
-        tree->GetEntry(i);
-    
-        if (!MP     && tMP)     MP     = tMP;
-        if (!MSlepL && tMSlepL) MSlepL = tMSlepL;
-        if (!MSneu  && tMSneu)  MSneu  = tMSneu;
-        if (!MN2    && tMN2)    MN2    = tMN2;
-        if (!MC1    && tMC1)    MC1    = tMC1;
-        if (!MN1    && tMN1)    MN1    = tMN1;
-    
-        if (MP && MSlepL && MSneu && MN2 && MC1 && MN1) break;
+    for (Long64_t i = 0; i < nEntries && missing > 0; ++i) {
+        Long64_t local = tree->LoadTree(i);
+        if (local < 0) break;
+        for (int b = 0; b < 6; ++b) {
+            if (!branches[b] || masses[b]) continue;
+            branches[b]->GetEntry(local);
+            if (tmp[b]) { masses[b] = tmp[b]; --missing; }
+        }
     }
+    tree->ResetBranchAddresses();
 
     file->Close();
     std::ostringstream oss;
     oss << "Cascades_"
-    << MP << "_" << MSlepL << "_" << MSneu << "_" 
-    << MN2 << "_" << MC1 << "_" << MN1;
+    << masses[0] << "_" << masses[1] << "_" << masses[2] << "_" 
+    << masses[3] << "_" << masses[4] << "_" << masses[5];
     
     std::string combined = oss.str();
     return combined;
@@ -0,0 +1,190 @@
+#ifndef CUTCACHE_H
+#define CUTCACHE_H
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "TROOT.h"
+#include "TSystem.h"
+#include "BuildFitInput.h"
+
+// Persistent cache of compiled string expressions (cuts and derived variables).
+//
+// Every expression is keyed by a hash of its normalised text, the types of the
+// columns it reads, the ROOT version and the safe-helper code. On a hit the entry
+// point of <dir>/bfi_expr_<key>.so books the Filter/Define with a compiled lambda,
+// so Cling never sees the expression. On a miss the expression is jitted as before,
+// unless the cache was opened with build=true, in which case the library is
+// generated and compiled once (written atomically, so concurrent jobs can share a
+// directory) and used right away.
+class CutCache {
+public:
+    typedef void (*EntryFn)(ROOT::RDF::RNode*, const char*, int);
+
+    explicit CutCache(const std::string &dir, bool build = false) : dir_(dir), build_(build) {
+        if (build_) gSystem->mkdir(dir_.c_str(), true);
+    }
+
+    ROOT::RDF::RNode Filter(ROOT::RDF::RNode node, const std::string &expr, const std::string &name = "") {
+        if (EntryFn fn = Resolve(node, expr)) { fn(&node, name.c_str(), 0); return node; }
+        return name.empty() ? node.Filter(expr) : node.Filter(expr, name);
+    }
+
+    ROOT::RDF::RNode Define(ROOT::RDF::RNode node, const std::string &name, const std::string &expr) {
+        if (EntryFn fn = Resolve(node, expr)) { fn(&node, name.c_str(), 1); return node; }
+        return node.Define(name, expr);
+    }
+
+    void PrintStats() const {
+        std::cout << "[CutCache] " << dir_ << ": " << hits_ << " loaded, " << built_ << " compiled, "
+                  << misses_ << " jitted\n";
+    }
+
+    // Whitespace-collapsed expression (outside string literals)
+    static std::string Normalize(const std::string &expr) {
+        std::string out;
+        char quote = 0;
+        bool pendingSpace = false;
+        for (char c : expr) {
+            if (quote) { out += c; if (c == quote) quote = 0; continue; }
+            if (std::isspace(static_cast<unsigned char>(c))) { pendingSpace = !out.empty(); continue; }
+            if (pendingSpace) { out += ' '; pendingSpace = false; }
+            if (c == '"' || c == '\'') quote = c;
+            out += c;
+        }
+        return out;
+    }
+
+    // Type to use for a column parameter of a compiled lambda
+    static std::string ParamType(std::string type) {
+        for (const std::string pre : {"std::vector<", "vector<"}) {
+            if (type.compare(0, pre.size(), pre) == 0 && type.back() == '>')
+                return "ROOT::RVec<" + type.substr(pre.size(), type.size() - pre.size() - 1) + ">";
+        }
+        return type;
+    }
+
+    static std::string Hash(const std::string &s) {
+        uint64_t h = 1469598103934665603ULL; // FNV-1a
+        for (unsigned char c : s) { h ^= c; h *= 1099511628211ULL; }
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(h));
+        return buf;
+    }
+
+private:
+    struct Signature {
+        std::string expr, key;
+        std::vector<std::pair<std::string, std::string>> columns; // name, parameter type
+    };
+
+    EntryFn Resolve(ROOT::RDF::RNode &node, const std::string &expr) {
+        Signature sig;
+        if (!MakeSignature(node, expr, sig)) { ++misses_; return nullptr; }
+        auto it = loaded_.find(sig.key);
+        if (it != loaded_.end()) { if (it->second) ++hits_; else ++misses_; return it->second; }
+
+        const std::string lib = dir_ + "/bfi_expr_" + sig.key + ".so";
+        EntryFn fn = nullptr;
+        if (!gSystem->AccessPathName(lib.c_str())) {
+            fn = Load(lib, sig.key);
+            if (fn) ++hits_;
+        } else if (build_ && Compile(sig, lib)) {
+            fn = Load(lib, sig.key);
+            if (fn) ++built_;
+        }
+        if (!fn) ++misses_;
+        loaded_[sig.key] = fn;
+        return fn;
+    }
+
+    bool MakeSignature(ROOT::RDF::RNode &node, const std::string &expr, Signature &sig) {
+        sig.expr = Normalize(expr);
+        if (sig.expr.empty()) return false;
+        const auto cols = node.GetColumnNames();
+        const std::set<std::string> known(cols.begin(), cols.end());
+        std::string keySrc = sig.expr + "\n";
+        for (const auto &id : BuildFitInput::ExpressionIdentifiers(sig.expr)) {
+            if (!known.count(id)) continue;
+            std::string type;
+            try { type = node.GetColumnType(id); } catch (...) { return false; }
+            if (type.empty() || type.find("CLING_UNKNOWN") != std::string::npos) return false;
+            sig.columns.emplace_back(id, ParamType(type));
+            keySrc += id + ":" + sig.columns.back().second + "\n";
+        }
+        keySrc += std::to_string(gROOT->GetVersionCode()) + "\n" + SafeHelpersCode();
+        sig.key = Hash(keySrc);
+        return true;
+    }
+
+    bool Compile(const Signature &sig, const std::string &lib) {
+        const std::string base = dir_ + "/bfi_expr_" + sig.key;
+        const std::string tmp = base + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream src(tmp + ".C");
+            if (!src) return false;
+            std::string params, names;
+            for (size_t i = 0; i < sig.columns.size(); ++i) {
+                if (i) { params += ", "; names += ", "; }
+                params += "const " + sig.columns[i].second + " &" + sig.columns[i].first;
+                names += "\"" + sig.columns[i].first + "\"";
+            }
+            src << "// " << sig.expr << "\n"
+                << "#include <cmath>\n"
+                << "#include <ROOT/RDataFrame.hxx>\n"
+                << "#include \"TMath.h\"\n" // as in the interpreter, where cuts use TMath::Pi() etc.
+                << SafeHelpersCode() << "\n"
+                << "using namespace ROOT::VecOps;\n"
+                << "extern \"C\" void bfi_expr_" << sig.key << "(ROOT::RDF::RNode *node, const char *name, int define) {\n"
+                << "    auto f = [](" << params << ") { return (" << sig.expr << "); };\n"
+                << "    if (define) *node = node->Define(name, f, {" << names << "});\n"
+                << "    else        *node = node->Filter(f, {" << names << "}, name);\n"
+                << "}\n";
+        }
+        const std::string cmd = "$(root-config --cxx) -O2 -shared -fPIC $(root-config --cflags) -o " + tmp + ".so "
+                              + tmp + ".C $(root-config --libs) -lROOTDataFrame";
+        const bool ok = gSystem->Exec(cmd.c_str()) == 0 && std::rename((tmp + ".so").c_str(), lib.c_str()) == 0;
+        if (ok) std::rename((tmp + ".C").c_str(), (base + ".C").c_str());
+        else {
+            std::cerr << "[CutCache] WARNING: failed to compile \"" << sig.expr << "\", it will be jitted\n";
+            std::remove((tmp + ".C").c_str());
+            std::remove((tmp + ".so").c_str());
+        }
+        return ok;
+    }
+
+    EntryFn Load(const std::string &lib, const std::string &key) {
+        if (gSystem->Load(lib.c_str()) < 0) {
+            std::cerr << "[CutCache] WARNING: cannot load " << lib << "\n";
+            return nullptr;
+        }
+        const std::string sym = "bfi_expr_" + key;
+        return reinterpret_cast<EntryFn>(gSystem->DynFindSymbol(lib.c_str(), sym.c_str()));
+    }
+
+    std::string dir_;
+    bool build_;
+    std::map<std::string, EntryFn> loaded_;
+    unsigned hits_ = 0, built_ = 0, misses_ = 0;
+};
+
+// Filter/Define through the cache when one is given, otherwise jit as usual
+inline ROOT::RDF::RNode FilterExpr(ROOT::RDF::RNode node, const std::string &expr, CutCache *cache,
+                                   const std::string &name = "") {
+    if (cache) return cache->Filter(node, expr, name);
+    return name.empty() ? node.Filter(expr) : node.Filter(expr, name);
+}
+
+inline ROOT::RDF::RNode DefineExpr(ROOT::RDF::RNode node, const std::string &name, const std::string &expr,
+                                   CutCache *cache) {
+    if (cache) return cache->Define(node, name, expr);
+    return node.Define(name, expr);
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef CUTFLOWTOOLS_H
+#define CUTFLOWTOOLS_H
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TTreeReader.h"
+#include <ROOT/RDataFrame.hxx>
+
+#include "FilterTrie.h"
+
+// Weighted cut flow of one ordered cut list, filled in a single pass.
+struct CutFlowResult {
+    std::vector<double> sumw, sumw2;       // [i]: events passing cuts 0..i
+    std::vector<double> nm1Sumw, nm1Sumw2; // [k]: events passing every cut except k (empty without N-1)
+};
+
+// Expression for an int column summarising one event against `cuts`, evaluated in order
+// with short-circuiting:
+//   -1        all cuts pass
+//   k >= 0    cut k is the only failing one (N-1 mode only)
+//   -(2 + k)  cut k is the first failing one (and, in N-1 mode, not the only one)
+// Without N-1 the first failure ends the evaluation, with N-1 the second one does. After the first
+// failure only cuts that are safe on any event (FilterTrie::Movable) run: reaching any other one
+// ends the evaluation as a second failure would, since it may rely on the failed cut (Nlep>=3 before
+// SIP3D_lep[2]<4), so such events do not count towards the N-1 yield of the failed cut.
+inline std::string BuildCutFlowExpr(const std::vector<std::string> &cuts, bool nminus1) {
+    std::string e = "([&]() -> int { ";
+    if (nminus1) e += "int first = -1; ";
+    for (size_t k = 0; k < cuts.size(); ++k) {
+        const std::string idx = std::to_string(k);
+        if (nminus1 && FilterTrie::Movable(cuts[k]))
+            e += "if (!(" + cuts[k] + ")) { if (first >= 0) return -(2 + first); first = " + idx + "; } ";
+        else if (nminus1)
+            e += "if (first >= 0) return -(2 + first); if (!(" + cuts[k] + ")) first = " + idx + "; ";
+        else
+            e += "if (!(" + cuts[k] + ")) return -" + std::to_string(2 + k) + "; ";
+    }
+    e += nminus1 ? "return first; })()" : "return -1; })()";
+    return e;
+}
+
+// RDF action over (code, weight, weight^2) columns: per-slot buckets indexed by the first
+// failing cut (n = passed all) and, for N-1, by the only failing cut. Merged in Finalize().
+class CutFlowHelper : public ROOT::Detail::RDF::RActionImpl<CutFlowHelper> {
+public:
+    using Result_t = CutFlowResult;
+
+    CutFlowHelper(size_t nCuts, bool nminus1, unsigned int nSlots)
+        : n_(nCuts), nm1_(nminus1),
+          w_(nSlots, std::vector<double>(2*nCuts + 1, 0.)),
+          w2_(nSlots, std::vector<double>(2*nCuts + 1, 0.)),
+          result_(std::make_shared<Result_t>()) {}
+    CutFlowHelper(CutFlowHelper &&) = default;
+    CutFlowHelper(const CutFlowHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot, int code, double w, double w2) {
+        auto &bw = w_[slot];
+        auto &bw2 = w2_[slot];
+        size_t first = n_;
+        if (code >= 0) {
+            first = static_cast<size_t>(code);
+            bw[n_ + 1 + first] += w;
+            bw2[n_ + 1 + first] += w2;
+        } else if (code <= -2) {
+            first = static_cast<size_t>(-code - 2);
+        }
+        bw[first] += w;
+        bw2[first] += w2;
+    }
+
+    void Finalize() {
+        std::vector<double> tw(2*n_ + 1, 0.), tw2(2*n_ + 1, 0.);
+        for (size_t s = 0; s < w_.size(); ++s) {
+            for (size_t i = 0; i < tw.size(); ++i) { tw[i] += w_[s][i]; tw2[i] += w2_[s][i]; }
+        }
+        // passing cuts 0..i == first failure after i
+        result_->sumw.assign(n_, 0.);
+        result_->sumw2.assign(n_, 0.);
+        double accw = tw[n_], accw2 = tw2[n_];
+        for (size_t i = n_; i-- > 0;) {
+            result_->sumw[i] = accw;
+            result_->sumw2[i] = accw2;
+            accw += tw[i];
+            accw2 += tw2[i];
+        }
+        if (nm1_) {
+            result_->nm1Sumw.resize(n_);
+            result_->nm1Sumw2.resize(n_);
+            for (size_t k = 0; k < n_; ++k) {
+                result_->nm1Sumw[k] = tw[n_] + tw[n_ + 1 + k];
+                result_->nm1Sumw2[k] = tw2[n_] + tw2[n_ + 1 + k];
+            }
+        }
+    }
+
+    std::string GetActionName() { return "CutFlow"; }
+
+private:
+    size_t n_;
+    bool nm1_;
+    std::vector<std::vector<double>> w_, w2_;
+    std::shared_ptr<Result_t> result_;
+};
+
+#endif
@@ -1,6 +1,12 @@
 #include "HistTools.h"
 #include "TLorentzVector.h"
 
+// Raw branches read by loadHistogramsUser below; keep in sync with its Defines so that
+// BFI_condor.x --hist-yaml (RequireColumns) and BFI_skim.x keep them available
+static const std::vector<std::string> kUserHistBranches = {
+    "PT_lep", "Eta_lep", "Phi_lep", "M_lep", "Charge_lep", "PDGID_lep", "HT_eta24", "MET"
+};
+
 // User existing HistDef type
 static std::vector<HistDef> loadHistogramsUser(ROOT::RDF::RNode &node) {
     std::vector<HistDef> hdefs;
@@ -0,0 +1,276 @@
+#ifndef ENTRYBITMAP_H
+#define ENTRYBITMAP_H
+#include <cstdint>
+#include <cstdio>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "TChain.h"
+#include "TEntryList.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TTreeReader.h"
+#include "RVersion.h"
+#include <ROOT/RDataFrame.hxx>
+
+// Compressed set of tree entries, Roaring style: entries are grouped by their high bits into
+// chunks of 65536, each stored as a sorted uint16 array while sparse (<= 4096 entries, 8 kB at
+// most) and as a 65536-bit bitset once denser. A tight bin selecting 1e4 of 1e7 entries takes
+// about 20 kB.
+class EntryBitmap {
+public:
+    static constexpr uint32_t kMaxArray = 4096;
+
+    void Add(uint64_t entry) {
+        Chunk &c = chunks_[entry >> 16];
+        const uint16_t low = entry & 0xffff;
+        if (!c.bits.empty()) {
+            uint64_t &w = c.bits[low >> 6];
+            const uint64_t m = uint64_t(1) << (low & 63);
+            c.card += !(w & m);
+            w |= m;
+            return;
+        }
+        // entries mostly arrive in order within a task
+        if (c.array.empty() || c.array.back() < low) c.array.push_back(low);
+        else {
+            auto it = std::lower_bound(c.array.begin(), c.array.end(), low);
+            if (it != c.array.end() && *it == low) return;
+            c.array.insert(it, low);
+        }
+        if (++c.card > kMaxArray) ToBits(c);
+    }
+
+    void Or(const EntryBitmap &o) {
+        for (const auto &kv : o.chunks_) {
+            if (!chunks_.count(kv.first)) { chunks_[kv.first] = kv.second; continue; }
+            if (kv.second.bits.empty()) {
+                for (uint16_t low : kv.second.array) Add((kv.first << 16) | low);
+                continue;
+            }
+            Chunk &c = chunks_[kv.first];
+            if (c.bits.empty()) ToBits(c);
+            c.card = 0;
+            for (size_t i = 0; i < kWords; ++i) {
+                c.bits[i] |= kv.second.bits[i];
+                c.card += __builtin_popcountll(c.bits[i]);
+            }
+        }
+    }
+
+    uint64_t Cardinality() const {
+        uint64_t n = 0;
+        for (const auto &kv : chunks_) n += kv.second.card;
+        return n;
+    }
+
+    // f(entry) for every entry, ascending
+    template <class F> void ForEach(F f) const {
+        for (const auto &kv : chunks_) {
+            const uint64_t high = kv.first << 16;
+            if (kv.second.bits.empty()) {
+                for (uint16_t low : kv.second.array) f(high | low);
+                continue;
+            }
+            for (size_t i = 0; i < kWords; ++i)
+                for (uint64_t w = kv.second.bits[i]; w; w &= w - 1)
+                    f(high | (i << 6) | __builtin_ctzll(w));
+        }
+    }
+
+    // f(begin, end) for every run [begin, end) of consecutive entries, ascending
+    template <class F> void ForEachRange(F f) const {
+        uint64_t begin = 0, end = 0;
+        ForEach([&](uint64_t e) {
+            if (e == end && end > begin) { ++end; return; }
+            if (end > begin) f(begin, end);
+            begin = e;
+            end = e + 1;
+        });
+        if (end > begin) f(begin, end);
+    }
+
+    void Write(std::ostream &out) const {
+        uint64_t n = chunks_.size();
+        out.write(reinterpret_cast<const char*>(&n), 8);
+        for (const auto &kv : chunks_) {
+            const uint64_t key = kv.first;
+            const uint32_t card = kv.second.card, isBits = !kv.second.bits.empty();
+            out.write(reinterpret_cast<const char*>(&key), 8);
+            out.write(reinterpret_cast<const char*>(&card), 4);
+            out.write(reinterpret_cast<const char*>(&isBits), 4);
+            if (isBits) out.write(reinterpret_cast<const char*>(kv.second.bits.data()), kWords * 8);
+            else out.write(reinterpret_cast<const char*>(kv.second.array.data()), card * 2);
+        }
+    }
+
+    bool Read(std::istream &in) {
+        chunks_.clear();
+        auto get = [&](void *p, size_t n) { in.read(static_cast<char*>(p), n); return bool(in); };
+        uint64_t n = 0;
+        if (!get(&n, 8)) return false;
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t key = 0;
+            uint32_t card = 0, isBits = 0;
+            if (!get(&key, 8) || !get(&card, 4) || !get(&isBits, 4) || isBits > 1) return false;
+            // the layout Add() keeps: arrays of at most kMaxArray sorted entries, bitsets whose card
+            // is their population count
+            if (!isBits && card > kMaxArray) return false;
+            Chunk &c = chunks_[key];
+            c.card = card;
+            if (isBits) {
+                c.bits.resize(kWords);
+                if (!get(c.bits.data(), kWords * 8)) return false;
+                uint32_t count = 0;
+                for (uint64_t w : c.bits) count += __builtin_popcountll(w);
+                if (count != card) return false;
+            } else {
+                c.array.resize(card);
+                if (!get(c.array.data(), card * 2)) return false;
+                for (size_t k = 1; k < c.array.size(); ++k) if (c.array[k] <= c.array[k - 1]) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static constexpr size_t kWords = 65536 / 64;
+    struct Chunk {
+        uint32_t card = 0;
+        std::vector<uint16_t> array; // sorted, while card <= kMaxArray
+        std::vector<uint64_t> bits;  // kWords words otherwise
+    };
+    static void ToBits(Chunk &c) {
+        c.bits.assign(kWords, 0);
+        for (uint16_t low : c.array) c.bits[low >> 6] |= uint64_t(1) << (low & 63);
+        c.array.clear();
+        c.array.shrink_to_fit();
+    }
+    std::map<uint64_t, Chunk> chunks_;
+};
+
+// Entries of one bin in one input (the file actually read: source or skim) and tree; a reader
+// only trusts them when the bin's cuts hash and the tree's entry count are unchanged
+struct EntryListRecord {
+    std::string input, tree, bin;
+    std::string cutsHash;
+    int64_t treeEntries = 0;
+    EntryBitmap entries;
+};
+
+// Sidecar of a yields run ("BEL2"), written to a temporary and renamed
+inline bool WriteEntryLists(const std::string &path, const std::vector<EntryListRecord> &records) {
+    static const uint32_t magic = 0x324c4542; // "BEL2"
+    const std::string tmp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) return false;
+        auto putStr = [&](const std::string &s) { uint64_t n = s.size(); out.write(reinterpret_cast<const char*>(&n), 8); out.write(s.data(), n); };
+        uint64_t n = records.size();
+        out.write(reinterpret_cast<const char*>(&magic), 4);
+        out.write(reinterpret_cast<const char*>(&n), 8);
+        for (const auto &r : records) {
+            putStr(r.input); putStr(r.tree); putStr(r.bin); putStr(r.cutsHash);
+            out.write(reinterpret_cast<const char*>(&r.treeEntries), 8);
+            r.entries.Write(out);
+        }
+        if (!out) { std::remove(tmp.c_str()); return false; }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+inline bool ReadEntryLists(const std::string &path, std::vector<EntryListRecord> &records) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    auto get = [&](void *p, size_t n) { in.read(static_cast<char*>(p), n); return bool(in); };
+    auto getStr = [&](std::string &s) {
+        uint64_t n = 0;
+        if (!get(&n, 8) || n > (1u << 20)) return false;
+        s.resize(n);
+        return get(&s[0], n);
+    };
+    uint32_t magic = 0;
+    uint64_t n = 0;
+    if (!get(&magic, 4) || magic != 0x324c4542 || !get(&n, 8)) return false;
+    records.clear();
+    for (uint64_t i = 0; i < n; ++i) {
+        EntryListRecord r;
+        if (!getStr(r.input) || !getStr(r.tree) || !getStr(r.bin) || !getStr(r.cutsHash) ||
+            !get(&r.treeEntries, 8) || !r.entries.Read(in)) return false;
+        records.push_back(std::move(r));
+    }
+    return true;
+}
+
+// Entries of `tree` in `file`, -1 when it cannot be read
+inline int64_t TreeEntries(const std::string &file, const std::string &tree) {
+    std::unique_ptr<TFile> f(TFile::Open(file.c_str(), "READ"));
+    TTree *t = (f && !f->IsZombie()) ? f->Get<TTree>(tree.c_str()) : nullptr;
+    return t ? t->GetEntries() : -1;
+}
+
+// RDF action without columns: the tree entries reaching the node, one bitmap per slot, merged in
+// Finalize(). The entry is the one the task's reader loaded, rdfentry_ is not that entry under MT.
+class EntryBitmapHelper : public ROOT::Detail::RDF::RActionImpl<EntryBitmapHelper> {
+public:
+    using Result_t = EntryBitmap;
+
+    explicit EntryBitmapHelper(unsigned int nSlots)
+        : slots_(nSlots), readers_(nSlots, nullptr), result_(std::make_shared<Result_t>()) {}
+    EntryBitmapHelper(EntryBitmapHelper &&) = default;
+    EntryBitmapHelper(const EntryBitmapHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+    void Initialize() {}
+    void InitTask(TTreeReader *r, unsigned int slot) { readers_[slot] = r; }
+    void Exec(unsigned int slot) { slots_[slot].Add(readers_[slot]->GetTree()->GetReadEntry()); }
+
+    void Finalize() {
+        for (const auto &s : slots_) result_->Or(s);
+        slots_.clear();
+    }
+
+    std::string GetActionName() { return "EntryBitmap"; }
+
+private:
+    std::vector<EntryBitmap> slots_;
+    std::vector<TTreeReader*> readers_;
+    std::shared_ptr<Result_t> result_;
+};
+
+// Entries [begin, end) into `l`, one call per range where ROOT has TEntryList::EnterRange
+inline void EnterEntryRange(TEntryList &l, Long64_t begin, Long64_t end) {
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6, 26, 0)
+    l.EnterRange(begin, end);
+#else
+    for (Long64_t e = begin; e < end; ++e) l.Enter(e);
+#endif
+}
+
+// `file`:`tree` restricted through an entry list to the ranges fill(range) passes to
+// range(begin, end); the list outlives the chain
+struct EntryListTree {
+    std::unique_ptr<TEntryList> list;
+    std::unique_ptr<TChain> chain;
+
+    EntryListTree(const EntryBitmap &entries, const std::string &tree, const std::string &file)
+        : EntryListTree(tree, file, [&](auto range) { entries.ForEachRange(range); }) {}
+
+    template <class Fill> EntryListTree(const std::string &tree, const std::string &file, Fill fill) {
+        TEntryList sub("", "", tree.c_str(), file.c_str());
+        fill([&](Long64_t begin, Long64_t end) { EnterEntryRange(sub, begin, end); });
+        list.reset(new TEntryList());
+        list->Add(&sub);
+        chain.reset(new TChain(tree.c_str()));
+        chain->Add(file.c_str());
+        chain->SetEntryList(list.get(), "sync");
+    }
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef FILTERTRIE_H
+#define FILTERTRIE_H
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <regex>
+
+#include "CutCache.h"
+
+// Filter nodes shared between bins. Cuts are split into atomic predicates (top-level &&),
+// canonicalised, and applied one Filter per predicate along a trie keyed on the predicate
+// text: bins whose predicate lists share a prefix share those Filter nodes, so the prefix is
+// evaluated once per event instead of once per bin. Every bin keeps its own order, since a predicate
+// may only be safe to evaluate behind the ones before it (Nlep>=3 before MAX(SIP3D_lep)<4).
+class FilterTrie {
+public:
+    // named: each Filter carries its predicate as name (shows up in RDataFrame reports)
+    explicit FilterTrie(ROOT::RDF::RNode root, CutCache *cache = nullptr, bool named = false)
+        : cache_(cache), named_(named) {
+        nodes_.push_back({root, {}});
+    }
+
+    // Node after `predicates` (canonical, in order), creating the missing part of the path
+    ROOT::RDF::RNode Path(const std::vector<std::string> &predicates) {
+        size_t cur = 0;
+        for (const auto &p : predicates) {
+            auto it = nodes_[cur].children.find(p);
+            if (it == nodes_[cur].children.end()) {
+                ROOT::RDF::RNode child = FilterExpr(nodes_[cur].node, p, cache_, named_ ? p : "");
+                nodes_.push_back({child, {}});
+                it = nodes_[cur].children.emplace(p, nodes_.size() - 1).first;
+            }
+            cur = it->second;
+        }
+        return nodes_[cur].node;
+    }
+
+    size_t NFilters() const { return nodes_.size() - 1; }
+
+    // Whitespace-collapsed predicate without parentheses around the whole of it
+    static std::string Canonical(const std::string &pred) {
+        std::string s = CutCache::Normalize(pred);
+        while (s.size() >= 2 && s.front() == '(' && s.back() == ')' && Closing(s, 0) == s.size() - 1)
+            s = CutCache::Normalize(s.substr(1, s.size() - 2));
+        return s;
+    }
+
+    // Canonical atomic predicates of `cuts`, in order; repeated predicates are kept once
+    static std::vector<std::string> Atoms(const std::vector<std::string> &cuts) {
+        std::vector<std::string> out;
+        std::set<std::string> seen;
+        for (const auto &c : cuts) {
+            for (const auto &a : SplitAnd(Canonical(c))) {
+                const std::string k = Canonical(a);
+                if (!k.empty() && seen.insert(k).second) out.push_back(k);
+            }
+        }
+        return out;
+    }
+
+    // Whether `pred` is safe on any event, so it may run ahead of the predicates before it: no
+    // subscript and no ROOT::VecOps call that needs a non-empty vector (MAX/MIN expand to
+    // ROOT::VecOps::Max/Min). Anything else is taken to rely on the predicates before it.
+    static bool Movable(const std::string &pred) {
+        static const std::regex unsafe(R"(\[|VecOps::(Max|Min|ArgMax|ArgMin|Front|Back)\b)");
+        return !std::regex_search(pred, unsafe);
+    }
+
+    // Predicates sorted by rank (lower first, e.g. PredicateRanks); predicates without a rank go
+    // last. One global key, so shared prefixes stay shared. A predicate that is not Movable() stays
+    // where it is, with everything before it still before it.
+    static void RankedOrder(std::vector<std::vector<std::string>> &bins, const std::map<std::string, double> &ranks) {
+        auto rank = [&](const std::string &p) {
+            auto it = ranks.find(p);
+            return it == ranks.end() ? std::numeric_limits<double>::max() : it->second;
+        };
+        auto byRank = [&](const std::string &x, const std::string &y) { return rank(x) < rank(y); };
+        for (auto &b : bins) {
+            auto from = b.begin();
+            for (auto it = b.begin(); it != b.end(); ++it) {
+                if (Movable(*it)) continue;
+                std::stable_sort(from, it, byRank);
+                from = it + 1;
+            }
+            std::stable_sort(from, b.end(), byRank);
+        }
+    }
+
+private:
+    struct TrieNode {
+        ROOT::RDF::RNode node;
+        std::map<std::string, size_t> children;
+    };
+
+    // Index of the bracket closing the one at `open`, npos if unbalanced (string literals skipped)
+    static size_t Closing(const std::string &s, size_t open) {
+        int depth = 0;
+        char quote = 0;
+        for (size_t i = open; i < s.size(); ++i) {
+            const char c = s[i];
+            if (quote) { if (c == '\\') ++i; else if (c == quote) quote = 0; continue; }
+            if (c == '"' || c == '\'') quote = c;
+            else if (c == '(' || c == '[' || c == '{') ++depth;
+            else if (c == ')' || c == ']' || c == '}') { if (--depth == 0) return i; }
+        }
+        return std::string::npos;
+    }
+
+    // Splits on && outside brackets and string literals; a top-level || or ?: binds looser than
+    // && (a || b && c is a || (b && c)), so such an expression stays one predicate
+    static std::vector<std::string> SplitAnd(const std::string &s) {
+        std::vector<std::string> parts;
+        int depth = 0;
+        char quote = 0;
+        size_t start = 0;
+        for (size_t i = 0; i < s.size(); ++i) {
+            const char c = s[i];
+            if (quote) { if (c == '\\') ++i; else if (c == quote) quote = 0; continue; }
+            if (c == '"' || c == '\'') quote = c;
+            else if (c == '(' || c == '[' || c == '{') ++depth;
+            else if (c == ')' || c == ']' || c == '}') --depth;
+            else if (depth == 0 && (c == '?' || (c == '|' && i + 1 < s.size() && s[i + 1] == '|'))) return {s};
+            else if (depth == 0 && c == '&' && i + 1 < s.size() && s[i + 1] == '&') {
+                parts.push_back(s.substr(start, i - start));
+                start = i + 2;
+                ++i;
+            }
+        }
+        parts.push_back(s.substr(start));
+        return parts;
+    }
+
+    std::vector<TrieNode> nodes_;
+    CutCache *cache_;
+    bool named_;
+};
+
+#endif
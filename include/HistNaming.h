@@ -0,0 +1,53 @@
+#ifndef HISTNAMING_H
+#define HISTNAMING_H
+#include <string>
+#include <tuple>
+
+// Histogram names written by BFI_condor: <bin>__<proc>__<var> (var = CutFlow, NMinus1 or a
+// YAML histogram). Shared by the plotters and mergeHists.x.
+struct HistId {
+    std::string bin; std::string proc; std::string var;
+    bool operator<(const HistId& other) const {
+        return std::tie(bin, proc, var) < std::tie(other.bin, other.proc, other.var);
+    }
+};
+
+inline std::string MakeHistName(const std::string &bin, const std::string &proc, const std::string &var) {
+    return bin + "__" + proc + "__" + var;
+}
+
+inline HistId ParseHistName(const std::string &name) {
+    std::string s = name;
+    // strip ";..." suffix
+    size_t sem = s.find(';');
+    if (sem != std::string::npos)
+        s = s.substr(0, sem);
+    // strip leading "can_" or "c_"
+    if (s.rfind("can_", 0) == 0) s = s.substr(4);
+    else if (s.rfind("c_", 0) == 0) s = s.substr(2);
+    HistId out{"", "", ""};
+    // split by "__"
+    size_t first = s.find("__");
+    if (first == std::string::npos) {
+        out.var = s;
+        return out;
+    }
+    size_t second = s.find("__", first + 2);
+    if (second == std::string::npos) {
+        // only one "__" -> treat as bin + var
+        out.bin = s.substr(0, first);
+        out.var = s.substr(first + 2);
+        return out;
+    }
+    out.bin  = s.substr(0, first);
+    out.proc = s.substr(first + 2, second - (first + 2));
+    out.var  = s.substr(second + 2);
+    return out;
+}
+
+// Key PlotHistograms groups processes under: <bin>__<var> (or <var> without a bin)
+inline std::string HistGroupKey(const HistId &id) {
+    return id.bin.empty() ? id.var : id.bin + "__" + id.var;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include "TH2D.h"
 
 #include "BuildFitInput.h"
+#include "CutCache.h"
 
 struct UserCutInfo {
     std::string name;                 // name of the user cut
@@ -116,28 +117,81 @@ HistFilterPlan BuildHistFilterPlan(const HistDef &h,
     return plan;
 }
 
-// Fill a histogram from a validated plan. Assumes MT is enabled for speed.
-// Recreates node under MT-on context, applies base filters + plan.appliedUserCuts, and fills.
+// Books histograms from validated plans on a single node without triggering the event loop.
+// Plans that start with the same filters share the filtered nodes, and WriteAll() runs one
+// loop for everything booked on the graph (including any yield actions booked beside it).
+class HistBatch {
+public:
+    explicit HistBatch(ROOT::RDF::RNode base, CutCache *cache = nullptr) : base_(base), cache_(cache) {}
+
+    void Book(const HistFilterPlan &plan, const HistDef &h, const std::string &hname) {
+        std::vector<std::string> filters = plan.baseFilters;
+        for (const auto &uci : plan.appliedUserCuts) filters.push_back(uci.expr);
+        ROOT::RDF::RNode hnode = NodeFor(filters);
+
+        Booked b;
+        b.name = hname;
+        b.x_title = h.x_title;
+        b.y_title = h.y_title;
+        if (h.type == "1D") {
+            b.h1 = hnode.Histo1D({hname.c_str(), hname.c_str(), h.nbins, h.xmin, h.xmax}, h.expr, "weight_scaled");
+        } else if (h.type == "2D") {
+            b.h2 = hnode.Histo2D({hname.c_str(), hname.c_str(), h.nbins, h.xmin, h.xmax, h.nybins, h.ymin, h.ymax},
+                                 h.expr, h.yexpr, "weight_scaled");
+        } else {
+            return;
+        }
+        hists_.push_back(std::move(b));
+    }
+
+    size_t Size() const { return hists_.size(); }
+
+    // Runs the event loop (if not already done) and writes everything to the current directory
+    void WriteAll() {
+        for (auto &b : hists_) {
+            TH1 *hist = b.h1 ? static_cast<TH1*>(b.h1.GetPtr()) : static_cast<TH1*>(b.h2.GetPtr());
+            hist->GetXaxis()->SetTitle(b.x_title.c_str());
+            hist->GetYaxis()->SetTitle(b.y_title.empty() ? "Events" : b.y_title.c_str());
+            if (hist->Write() == 0) std::cerr << "error writing: " << b.name << std::endl;
+        }
+    }
+
+private:
+    struct Booked {
+        std::string name, x_title, y_title;
+        ROOT::RDF::RResultPtr<TH1D> h1;
+        ROOT::RDF::RResultPtr<TH2D> h2;
+    };
+
+    // Filter chain for `filters`, reusing the longest already-built prefix
+    ROOT::RDF::RNode NodeFor(const std::vector<std::string> &filters) {
+        ROOT::RDF::RNode node = base_;
+        std::string key;
+        for (const auto &f : filters) {
+            key += f;
+            key += '\x1f';
+            auto it = prefixNodes_.find(key);
+            if (it == prefixNodes_.end())
+                it = prefixNodes_.emplace(key, FilterExpr(node, f, cache_)).first;
+            node = it->second;
+        }
+        return node;
+    }
+
+    ROOT::RDF::RNode base_;
+    CutCache *cache_;
+    std::map<std::string, ROOT::RDF::RNode> prefixNodes_;
+    std::vector<Booked> hists_;
+};
+
+// Fill a single histogram from a validated plan (runs its own event loop; prefer HistBatch).
 void FillHistFromPlan(const ROOT::RDF::RNode &node,
                       const HistFilterPlan &plan,
                       const HistDef &h,
                       const std::string &hname) {
-    ROOT::RDF::RNode hnode = node; // create fresh node (inherits current MT state)
-    for (const auto &f : plan.baseFilters) hnode = hnode.Filter(f);
-    for (const auto &uci : plan.appliedUserCuts) hnode = hnode.Filter(uci.expr);
-
-    if (h.type == "1D") {
-        auto hist = hnode.Histo1D({hname.c_str(), hname.c_str(), h.nbins, h.xmin, h.xmax}, h.expr, "weight_scaled");
-        hist->GetXaxis()->SetTitle(h.x_title.c_str());
-        hist->GetYaxis()->SetTitle(h.y_title.empty() ? "Events" : h.y_title.c_str());
-        if (hist->Write() == 0) std::cerr << "error writing: " << hname << std::endl;
-    } else if (h.type == "2D") {
-        auto hist = hnode.Histo2D({hname.c_str(), hname.c_str(), h.nbins, h.xmin, h.xmax, h.nybins, h.ymin, h.ymax},
-                                  h.expr, h.yexpr, "weight_scaled");
-        hist->GetXaxis()->SetTitle(h.x_title.c_str());
-        hist->GetYaxis()->SetTitle(h.y_title.empty() ? "Events" : h.y_title.c_str());
-        if (hist->Write() == 0) std::cerr << "error writing: " << hname << std::endl;
-    }
+    HistBatch batch(node);
+    batch.Book(plan, h, hname);
+    batch.WriteAll();
 }
 
 static bool ValidateDerivedVarNode(ROOT::RDF::RNode node, const DerivedVar &dv, unsigned nCheck = 50) {
@@ -3,10 +3,13 @@
 
 #include "nlohmann/json.hpp" // JSON lib
 #include "BuildFitTools.h"
+#include "YieldBinary.h"
 #include <vector>
 #include <map>
+#include <set>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
 
 using json = nlohmann::json;
 
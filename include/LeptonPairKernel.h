@@ -0,0 +1,117 @@
+#ifndef LEPTONPAIRKERNEL_H
+#define LEPTONPAIRKERNEL_H
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <cstdlib>
+
+#include <ROOT/RVec.hxx>
+
+// Pair classes, in the order used for the column names (A_OSSFPairs, A_NumOSOFPairs, ...)
+enum LepPairClass { kOSSF = 0, kOSOF, kSSSF, kSSOF, kNLepPairClasses };
+
+inline const char* LepPairClassName(int c) {
+    static const char* names[kNLepPairClasses] = {"OSSF", "OSOF", "SSSF", "SSOF"};
+    return names[c];
+}
+
+// Struct-of-arrays summary of the leptons on one side (All/A/B) of an event.
+// One instance per processing slot is refilled in place every event, so once the
+// buffers have grown to the largest multiplicity seen there are no further allocations.
+// The per-side RDF columns are non-owning RVec views into these arrays.
+struct LepPairSummary {
+    // per lepton (flavour: 0=elec, 1=muon)
+    ROOT::RVec<int> flavor, charge, qual;
+    ROOT::RVec<double> pt, eta, phi, m;
+    // per pair class
+    ROOT::RVec<std::pair<int,int>> pairs[kNLepPairClasses];
+    ROOT::RVec<double> mass[kNLepPairClasses];
+    ROOT::RVec<double> dR[kNLepPairClasses];
+    int count[kNLepPairClasses] = {0, 0, 0, 0};
+    // scratch: cartesian components per lepton, computed once and reused for every pair
+    ROOT::RVec<double> px_, py_, pz_, e_;
+
+    void Clear() {
+        flavor.clear(); charge.clear(); qual.clear();
+        pt.clear(); eta.clear(); phi.clear(); m.clear();
+        px_.clear(); py_.clear(); pz_.clear(); e_.clear();
+        for (int c = 0; c < kNLepPairClasses; ++c) {
+            pairs[c].clear(); mass[c].clear(); dR[c].clear(); count[c] = 0;
+        }
+    }
+};
+
+// Single scan over the leptons of one side: selects them (idx == nullptr means all leptons),
+// then classifies every i<j pair and computes its invariant mass and DeltaR.
+// The kinematic inputs may be null when no kinematic column is needed (pt/eta/phi/m and the
+// pair masses/DeltaR stay empty), and withPairs=false skips the pair loop altogether.
+inline void FillLepPairSummary(LepPairSummary &s,
+                               const std::vector<int> &pdgid,
+                               const std::vector<int> &charge,
+                               const std::vector<int> &qual,
+                               const std::vector<double> *pt,
+                               const std::vector<double> *eta,
+                               const std::vector<double> *phi,
+                               const std::vector<double> *m,
+                               const std::vector<int> *idx,
+                               bool withPairs = true)
+{
+    s.Clear();
+    const bool withKin = pt && eta && phi && m;
+    const size_t nsel = idx ? idx->size() : pdgid.size();
+    for (size_t k = 0; k < nsel; ++k) {
+        const size_t i = idx ? static_cast<size_t>((*idx)[k]) : k;
+        if (i >= pdgid.size()) continue;
+        s.flavor.push_back(std::abs(pdgid[i]) == 11 ? 0 : 1);
+        s.charge.push_back(charge[i]);
+        s.qual.push_back(qual[i]);
+        if (!withKin) continue;
+        const double lpt = (*pt)[i], leta = (*eta)[i], lphi = (*phi)[i], lm = (*m)[i];
+        s.pt.push_back(lpt);
+        s.eta.push_back(leta);
+        s.phi.push_back(lphi);
+        s.m.push_back(lm);
+
+        const double px = lpt*std::cos(lphi);
+        const double py = lpt*std::sin(lphi);
+        const double pz = lpt*std::sinh(leta);
+        s.px_.push_back(px);
+        s.py_.push_back(py);
+        s.pz_.push_back(pz);
+        s.e_.push_back(std::sqrt(px*px + py*py + pz*pz + lm*lm));
+    }
+    if (!withPairs) return;
+
+    const size_t n = s.flavor.size();
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = i+1; j < n; ++j) {
+            const bool sameFlavor = s.flavor[i] == s.flavor[j];
+            const bool sameCharge = s.charge[i] == s.charge[j];
+            const int c = sameCharge ? (sameFlavor ? kSSSF : kSSOF)
+                                     : (sameFlavor ? kOSSF : kOSOF);
+            s.pairs[c].emplace_back((int)i, (int)j);
+            if (!withKin) continue;
+
+            const double E  = s.e_[i]  + s.e_[j];
+            const double px = s.px_[i] + s.px_[j];
+            const double py = s.py_[i] + s.py_[j];
+            const double pz = s.pz_[i] + s.pz_[j];
+            const double mass2 = E*E - (px*px + py*py + pz*pz);
+            s.mass[c].push_back(mass2 > 0. ? std::sqrt(mass2) : 0.);
+
+            double dphi = std::abs(s.phi[i] - s.phi[j]);
+            if (dphi > M_PI) dphi = 2*M_PI - dphi;
+            const double deta = s.eta[i] - s.eta[j];
+            s.dR[c].push_back(std::sqrt(deta*deta + dphi*dphi));
+        }
+    }
+    for (int c = 0; c < kNLepPairClasses; ++c) s.count[c] = (int)s.pairs[c].size();
+}
+
+// Non-owning RVec over one of the summary arrays (valid for the current event only)
+template <typename T>
+inline ROOT::RVec<T> LepPairView(const ROOT::RVec<T> &v) {
+    return ROOT::RVec<T>(const_cast<T*>(v.data()), v.size());
+}
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef MERGETOOLS_H
+#define MERGETOOLS_H
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+#include "nlohmann/json.hpp"
+#include "YieldBinary.h"
+
+// {count, sumW, sumW2}: merging is a plain sum, the error is sqrt(sumW2) on output
+struct MergeYield {
+    double count = 0., sumW = 0., sumW2 = 0.;
+    void Add(const MergeYield &o) { count += o.count; sumW += o.sumW; sumW2 += o.sumW2; }
+    double Error() const { return std::sqrt(sumW2); }
+};
+
+// merged totals: bin -> group -> yield, and optionally bin -> group -> file -> yield
+struct MergeAccumulator {
+    std::map<std::string, std::map<std::string, MergeYield>> totals;
+    std::map<std::string, std::map<std::string, std::map<std::string, MergeYield>>> files;
+
+    void Add(const MergeAccumulator &o) {
+        for (const auto &b : o.totals)
+            for (const auto &s : b.second) totals[b.first][s.first].Add(s.second);
+        for (const auto &b : o.files)
+            for (const auto &s : b.second)
+                for (const auto &f : s.second) files[b.first][s.first][f.first].Add(f.second);
+    }
+};
+
+// SAX handler folding one BFI_condor partial JSON straight into an accumulator,
+// without building a DOM. Accepted layouts under bin -> sample:
+//   {"files": {file: Y}, "totals": Y}   (BFI_condor)
+//   Y                                   (mergeJSONs output)
+// with Y = [count, sumW, err, sumW2]; sumW2 is err^2 for older 3-element files.
+// Sample keys are mapped to groups by `resolve` (identity when empty).
+class PartialJSONSax : public nlohmann::json_sax<nlohmann::json> {
+public:
+    typedef std::function<std::string(const std::string&)> Resolver;
+
+    PartialJSONSax(MergeAccumulator &acc, bool keepFiles, const Resolver &resolve)
+        : acc_(acc), keepFiles_(keepFiles), resolve_(resolve) {}
+
+    bool null() override { return Value(0.); }
+    bool boolean(bool) override { return Value(0.); }
+    bool number_integer(number_integer_t v) override { return Value(static_cast<double>(v)); }
+    bool number_unsigned(number_unsigned_t v) override { return Value(static_cast<double>(v)); }
+    bool number_float(number_float_t v, const string_t &) override { return Value(v); }
+    bool string(string_t &) override { return Value(0.); }
+    bool binary(binary_t &) override { return Value(0.); }
+
+    bool start_object(std::size_t) override { Push(false); return true; }
+    bool end_object() override { stack_.pop_back(); return true; }
+    bool start_array(std::size_t) override { Push(true); pendingN_ = 0; return true; }
+    bool end_array() override { Commit(); stack_.pop_back(); return true; }
+    bool key(string_t &k) override { key_ = k; return true; }
+
+    bool parse_error(std::size_t pos, const std::string &, const nlohmann::detail::exception &ex) override {
+        error_ = "at byte " + std::to_string(pos) + ": " + ex.what();
+        return false;
+    }
+    const std::string &Error() const { return error_; }
+
+private:
+    struct Frame {
+        bool array;
+        std::string key; // key of this container in its parent
+        size_t index;    // next element index (arrays)
+    };
+
+    void Push(bool array) {
+        std::string k = (!stack_.empty() && stack_.back().array) ? std::to_string(stack_.back().index++) : key_;
+        stack_.push_back({array, std::move(k), 0});
+        if (stack_.size() == 3) group_ = Group(stack_[2].key); // bin -> sample container
+    }
+
+    std::string Group(const std::string &sample) {
+        if (!resolve_) return sample;
+        auto it = memo_.find(sample);
+        if (it == memo_.end()) it = memo_.emplace(sample, resolve_(sample)).first;
+        return it->second;
+    }
+
+    bool Value(double v) {
+        if (stack_.empty() || !stack_.back().array) return true;
+        const size_t i = stack_.back().index++;
+        if (i < 4) { pending_[i] = v; pendingN_ = i + 1; }
+        return true;
+    }
+
+    // Adds the yield array being closed to its total or file entry
+    void Commit() {
+        const size_t depth = stack_.size();
+        if (depth < 3 || pendingN_ < 2) return;
+        MergeYield *y = nullptr;
+        if (depth == 3 || (depth == 4 && stack_[3].key == "totals")) y = &acc_.totals[stack_[1].key][group_];
+        else if (depth == 5 && keepFiles_ && stack_[3].key == "files") y = &acc_.files[stack_[1].key][group_][stack_[4].key];
+        if (!y) return;
+        y->count += pending_[0];
+        y->sumW += pending_[1];
+        if (pendingN_ > 3) y->sumW2 += pending_[3];
+        else if (pendingN_ > 2) y->sumW2 += pending_[2]*pending_[2];
+    }
+
+    MergeAccumulator &acc_;
+    bool keepFiles_;
+    const Resolver &resolve_;
+    std::vector<Frame> stack_;
+    std::string key_, group_, error_;
+    double pending_[4] = {0., 0., 0., 0.};
+    size_t pendingN_ = 0;
+    std::unordered_map<std::string, std::string> memo_;
+};
+
+// Folds a binary yield file (YieldBinary.h) into `acc`, like PartialJSONSax does for JSON
+inline void FoldYieldBinary(const YieldBinary &in, MergeAccumulator &acc, bool keepFiles,
+                            const PartialJSONSax::Resolver &resolve) {
+    std::unordered_map<uint32_t, std::string> groups; // proc string id -> group
+    for (size_t i = 0; i < in.Size(); ++i) {
+        const YieldRecord &r = in.Record(i);
+        if (r.file != YieldBinary::kNoFile && !keepFiles) continue;
+        auto g = groups.find(r.proc);
+        if (g == groups.end()) {
+            const std::string proc(in.String(r.proc));
+            g = groups.emplace(r.proc, resolve ? resolve(proc) : proc).first;
+        }
+        const MergeYield y{r.count, r.sumW, r.sumW2};
+        const std::string bin(in.String(r.bin));
+        if (r.file == YieldBinary::kNoFile) acc.totals[bin][g->second].Add(y);
+        else acc.files[bin][g->second][std::string(in.String(r.file))].Add(y);
+    }
+}
+
+// Parses `inputs` (JSON or binary yields) on `nThreads` threads, each folding into its own accumulator, and
+// adds the per-thread results to `acc`. Returns false (after all files) if any file
+// could not be read or parsed.
+inline bool MergePartialJSONs(const std::vector<std::string> &inputs, MergeAccumulator &acc, bool keepFiles,
+                              const PartialJSONSax::Resolver &resolve, unsigned nThreads) {
+    if (inputs.empty()) return true;
+    if (nThreads == 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min<unsigned>(nThreads, inputs.size());
+
+    std::vector<MergeAccumulator> partial(nThreads);
+    std::atomic<size_t> next{0};
+    std::atomic<bool> ok{true};
+    std::mutex logMutex;
+
+    auto worker = [&](unsigned t) {
+        PartialJSONSax::Resolver res = resolve; // per-thread copy
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+            if (YieldBinary::IsBinary(inputs[i])) {
+                YieldBinary in;
+                if (in.Open(inputs[i])) FoldYieldBinary(in, partial[t], keepFiles, res);
+                else {
+                    std::lock_guard<std::mutex> lock(logMutex);
+                    std::cerr << "[mergeJSONs] Cannot read " << inputs[i] << "\n";
+                    ok = false;
+                }
+                continue;
+            }
+            std::ifstream ifs(inputs[i], std::ios::binary);
+            if (!ifs.is_open()) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << "[mergeJSONs] Cannot open " << inputs[i] << "\n";
+                ok = false;
+                continue;
+            }
+            PartialJSONSax sax(partial[t], keepFiles, res);
+            if (!nlohmann::json::sax_parse(ifs, &sax)) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << "[mergeJSONs] Parse error in " << inputs[i] << " " << sax.Error() << "\n";
+                ok = false;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < nThreads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto &th : pool) th.join();
+
+    for (const auto &p : partial) acc.Add(p);
+    return ok;
+}
+
+// Binary yields of `acc`: per-group totals, plus the per-file records when withFiles
+inline bool WriteYieldBinary(const std::string &path, const MergeAccumulator &acc, bool withFiles) {
+    YieldBinary out;
+    for (const auto &b : acc.totals)
+        for (const auto &s : b.second) out.Add(b.first, s.first, "", s.second.count, s.second.sumW, s.second.sumW2);
+    if (withFiles) {
+        for (const auto &b : acc.files)
+            for (const auto &s : b.second)
+                for (const auto &f : s.second) out.Add(b.first, s.first, f.first, f.second.count, f.second.sumW, f.second.sumW2);
+    }
+    return out.Write(path);
+}
+
+// JSON yields of `acc` as [count, sumW, err, sumW2]: the totals to `path` and, when `filesPath`
+// is set, the per-file breakdown. Written to a temporary file and renamed into place.
+inline bool WriteYieldJSON(const std::string &path, const MergeAccumulator &acc, const std::string &filesPath = "") {
+    auto yieldArray = [](const MergeYield &y) { return nlohmann::json::array({y.count, y.sumW, y.Error(), y.sumW2}); };
+    auto write = [](const std::string &out, const nlohmann::json &j) {
+        const std::string tmp = out + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream ofs(tmp);
+            if (!ofs.is_open()) return false;
+            ofs << j.dump(4) << "\n";
+            if (!ofs) { std::remove(tmp.c_str()); return false; }
+        }
+        return std::rename(tmp.c_str(), out.c_str()) == 0;
+    };
+
+    nlohmann::json totals = nlohmann::json::object();
+    for (const auto &b : acc.totals)
+        for (const auto &s : b.second) totals[b.first][s.first] = yieldArray(s.second);
+    if (!write(path, totals)) return false;
+    if (filesPath.empty()) return true;
+
+    nlohmann::json files = nlohmann::json::object();
+    for (const auto &b : acc.files)
+        for (const auto &s : b.second)
+            for (const auto &f : s.second) files[b.first][s.first][f.first] = yieldArray(f.second);
+    return write(filesPath, files);
+}
+
+#endif
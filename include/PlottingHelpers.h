@@ -31,6 +31,9 @@
 #include <TPaveText.h>
 
 #include "SampleTool.h"
+#include "SampleCatalog.h"
+#include "HistNaming.h"
+#include "SignificanceTools.h"
 
 using namespace std;
 
@@ -105,13 +108,7 @@ double BinContentSafe(TH1* h, int bin){
 }
 
 double CalculateZbi(double Nsig, double Nbkg, double deltaNbkg){
-  double Nobs = Nsig+Nbkg;
-  double tau = 1./Nbkg/(deltaNbkg*deltaNbkg);
-  double aux = Nbkg*tau;
-  double Pvalue = TMath::BetaIncomplete(1./(1.+tau),Nobs,aux+1.);
-  double sigma = sqrt(2.)*TMath::ErfcInverse(Pvalue*2);
-
-  return (isnan(sigma))?0:sigma;
+  return SigTools::Zbi(Nsig, Nbkg, deltaNbkg);
 }
 
 const TColor rf_blue0(7000,0.749,0.78,0.933);
@@ -311,42 +308,6 @@ void loadFormatMaps(){
 
 }
 
-struct HistId {
-    string bin; string proc; string var; 
-    bool operator<(const HistId& other) const {
-        return std::tie(bin, proc, var) < std::tie(other.bin, other.proc, other.var);
-    }
-};
-
-HistId ParseHistName(const std::string &name) {
-    std::string s = name;
-    // strip ";..." suffix
-    size_t sem = s.find(';');
-    if (sem != std::string::npos)
-        s = s.substr(0, sem);
-    // strip leading "can_" or "c_"
-    if (s.rfind("can_", 0) == 0) s = s.substr(4);
-    else if (s.rfind("c_", 0) == 0) s = s.substr(2);
-    HistId out{"", "", ""};
-    // split by "__"
-    size_t first = s.find("__");
-    if (first == std::string::npos) {
-        out.var = s;
-        return out;
-    }
-    size_t second = s.find("__", first + 2);
-    if (second == std::string::npos) {
-        // only one "__" -> treat as bin + var
-        out.bin = s.substr(0, first);
-        out.var = s.substr(first + 2);
-        return out;
-    }
-    out.bin  = s.substr(0, first);
-    out.proc = s.substr(first + 2, second - (first + 2));
-    out.var  = s.substr(second + 2); 
-    return out;
-}
-
 // Return just the bin name from the hist title
 std::string ExtractBinName(const std::string &histName) {
     HistId id = ParseHistName(histName);
@@ -379,7 +340,7 @@ bool IsSignalHist(const std::string &histName, const SampleTool &tool) {
 // Return true if the histogram belongs to a background sample
 bool IsBkgHist(const std::string &histName, const SampleTool &tool) {
     HistId id = ParseHistName(histName);
-    return tool.BkgDict.count(id.proc) > 0;
+    return tool.BkgDict.count(id.proc) > 0 || SampleCatalog::Instance().IsBackground(id.proc);
 }
 
 template<typename T>
@@ -100,11 +100,13 @@ void Plot_Eff(TEfficiency* e){
 // ----------------------
 // Plot stack
 // ----------------------
+// bkgTotal: summed background from mergeHists.x --totals, if available
 void Plot_Stack(const string& hname,
                 vector<TH1*>& bkgHists,
                 vector<TH1*>& sigHists,
                 TH1* dataHist = nullptr,
-                double signal_boost = 1.0)
+                double signal_boost = 1.0,
+                TH1* bkgTotal = nullptr)
 {
     if (bkgHists.empty() && (sigHists.empty() || !dataHist)) return;
     vector<TH1*> allHists = bkgHists; allHists.insert(allHists.end(), sigHists.begin(), sigHists.end());
@@ -113,17 +115,17 @@ void Plot_Stack(const string& hname,
     if (hmin <= 0.) hmin = 1.e-1;
 
     int stack_index = 0;
-    TH1D* h_BKG = nullptr;
+    TH1D* h_BKG = bkgTotal ? (TH1D*) bkgTotal->Clone("TOT_BKG") : nullptr;
     for (auto* h : bkgHists) {
         if (!h) continue;
         SetMinimumBinContent(h, 1.e-6); 
-        if (!h_BKG) { 
-            h_BKG = (TH1D*) h->Clone("TOT_BKG"); 
+        if (stack_index == 0) { 
+            if (!bkgTotal) h_BKG = (TH1D*) h->Clone("TOT_BKG"); 
         } else {
             for(int k = 0; k < stack_index; k++){
               bkgHists[k]->Add(h);
             }
-            h_BKG->Add(h);
+            if (!bkgTotal) h_BKG->Add(h);
         }
         stack_index++;
     }
@@ -201,7 +203,8 @@ void Plot_CutFlow(const std::string &hname,
                        const std::vector<TH1*> &bkgHists,
                        const std::vector<TH1*> &sigHists,
                        TH1* dataHist,
-                       double signal_boost)
+                       double signal_boost,
+                       TH1* bkgTotal = nullptr)
 {
     if (bkgHists.empty() && (sigHists.empty() || !dataHist)) return;
 
@@ -214,11 +217,12 @@ void Plot_CutFlow(const std::string &hname,
     GetMinMaxIntegral(allHists, hmin, hmax);
     if (hmin <= 0.) hmin = 1.e-4;
 
-    // Total background
-    TH1D* h_BKG = nullptr;
+    // Total background (precomputed by mergeHists.x --totals when available)
+    TH1D* h_BKG = bkgTotal ? (TH1D*) bkgTotal->Clone("TOT_BKG") : nullptr;
     for (auto* h : bkgHists) {
         if (!h) continue;
         SetMinimumBinContent(h, 1.e-6);
+        if (bkgTotal) continue;
         if (!h_BKG) h_BKG = (TH1D*) h->Clone("TOT_BKG");
         else h_BKG->Add(h);
     }
@@ -645,11 +649,11 @@ void MakeAndPlotCutflow2D(
     }
 
     // --- 3) classify processes into bkg / sig (use tool) ---
+    const SampleCatalog &catalog = SampleCatalog::Instance();
     std::vector<std::string> allBkgs, allSigs;
     for (const auto &p : procSet) {
-        if (tool.BkgDict.count(p)) allBkgs.push_back(p);
-        else if (std::find(tool.SignalKeys.begin(), tool.SignalKeys.end(), p) != tool.SignalKeys.end()
-                 || p.find("SMS") != std::string::npos || p.find("Cascades") != std::string::npos)
+        if (tool.BkgDict.count(p) || catalog.IsBackground(p)) allBkgs.push_back(p);
+        else if (catalog.IsSignal(p))
             allSigs.push_back(p);
         else
             allBkgs.push_back(p); // default unknown -> background
@@ -0,0 +1,104 @@
+#ifndef SAMPLECATALOG_H
+#define SAMPLECATALOG_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include "SampleTool.h"
+
+// Hashed view of SampleTool::MasterDict, built once per process:
+//   file basename -> group, basename prefix (up to the first '_') -> group,
+//   group -> files and signal / background flag.
+// Lookups keep the first-match order of a scan over MasterDict (groups in map
+// order, files in list order), so results are the same as the old nested loops.
+class SampleCatalog {
+public:
+    // `master` must outlive the catalog (file lists are not copied)
+    explicit SampleCatalog(const std::map<std::string, stringlist>& master) {
+        size_t rank = 0;
+        for (const auto& kv : master) {
+            const std::string& group = kv.first;
+            groups_.emplace(group, GroupInfo{&kv.second, IsSignalGroup(group)});
+            for (const auto& file : kv.second) {
+                const std::string base(Basename(file));
+                byBasename_.emplace(base, group); // first occurrence wins
+                const std::string prefix = base.substr(0, base.find('_'));
+                auto it = byPrefix_.find(prefix);
+                if (it == byPrefix_.end()) {
+                    byPrefix_.emplace(prefix, std::make_pair(rank, group));
+                    prefixLengths_.insert(prefix.size());
+                }
+                ++rank;
+            }
+        }
+    }
+
+    // Catalog of the default SampleTool
+    static const SampleCatalog& Instance() {
+        static const SampleTool st;
+        static const SampleCatalog catalog(st.MasterDict);
+        return catalog;
+    }
+
+    // Rule shared with SampleTool::LoadAllFromMaster: "Cascades" or anything containing "SMS" is signal
+    static bool IsSignalGroup(const std::string& group) {
+        return group == "Cascades" || group.find("SMS") != std::string::npos;
+    }
+
+    static std::string_view Basename(std::string_view path) {
+        const size_t slash = path.find_last_of('/');
+        return slash == std::string_view::npos ? path : path.substr(slash + 1);
+    }
+
+    // Group owning a file with the same basename as `keyOrPath`, nullptr if none
+    const std::string* GroupOfFile(const std::string& keyOrPath) const {
+        auto it = byBasename_.find(std::string(Basename(keyOrPath)));
+        return it == byBasename_.end() ? nullptr : &it->second;
+    }
+
+    // Group of the first catalog file whose basename prefix (up to the first '_')
+    // starts the basename of `key`, nullptr if none
+    const std::string* GroupOfPrefix(const std::string& key) const {
+        const std::string_view base = Basename(key);
+        const std::pair<size_t, std::string>* best = nullptr;
+        for (size_t len : prefixLengths_) {
+            if (len > base.size()) break;
+            auto it = byPrefix_.find(std::string(base.substr(0, len)));
+            if (it != byPrefix_.end() && (!best || it->second.first < best->first)) best = &it->second;
+        }
+        return best ? &best->second : nullptr;
+    }
+
+    const stringlist* Files(const std::string& group) const {
+        auto it = groups_.find(group);
+        return it == groups_.end() ? nullptr : it->second.files;
+    }
+
+    bool IsBackground(const std::string& group) const {
+        auto it = groups_.find(group);
+        return it != groups_.end() && !it->second.signal;
+    }
+
+    // Signal group, or a signal process name (Cascades_* mass point, SMS_* tree)
+    bool IsSignal(const std::string& proc) const {
+        auto it = groups_.find(proc);
+        if (it != groups_.end()) return it->second.signal;
+        return proc.find("SMS") != std::string::npos || proc.find("Cascades") != std::string::npos;
+    }
+
+private:
+    struct GroupInfo {
+        const stringlist* files;
+        bool signal;
+    };
+
+    std::unordered_map<std::string, GroupInfo> groups_;
+    std::unordered_map<std::string, std::string> byBasename_;
+    std::unordered_map<std::string, std::pair<size_t, std::string>> byPrefix_; // prefix -> (first rank, group)
+    std::set<size_t> prefixLengths_;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef SIGNALINDEX_H
+#define SIGNALINDEX_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On-disk signal metadata, one tab-separated line per file:
+//   path <TAB> cascades token <TAB> SMS trees (comma separated, "-" if none) <TAB> entries
+// Built once by buildSignalIndex.x and memory-mapped read-only by every tool, so the mass
+// tokens and SMS tree names of a signal file are known without opening it.
+// Location: $BFI_SIGNAL_INDEX, or ./signal_index.tsv when the variable is not set.
+class SignalIndex {
+public:
+    struct Entry {
+        std::string token;                 // Cascades_MP_MSlepL_MSneu_MN2_MC1_MN1 ("-" for SMS files)
+        std::vector<std::string> smsTrees; // SMS_X_Y trees in the file
+        long long entries = -1;            // KUAnalysis entries, or summed over the SMS trees
+    };
+
+    static const SignalIndex& Instance() {
+        static SignalIndex index(DefaultPath());
+        return index;
+    }
+
+    static std::string DefaultPath() {
+        const char* env = std::getenv("BFI_SIGNAL_INDEX");
+        return (env && *env) ? env : "signal_index.tsv";
+    }
+
+    bool Empty() const { return rows_.empty(); }
+
+    bool Lookup(const std::string& path, Entry& e) const {
+        auto it = rows_.find(std::string_view(path));
+        if (it == rows_.end()) return false;
+        std::vector<std::string_view> f = Split(it->second, '\t');
+        if (f.size() < 3) return false;
+        e.token = std::string(f[0]);
+        e.smsTrees.clear();
+        if (f[1] != "-") for (auto t : Split(f[1], ',')) if (!t.empty()) e.smsTrees.emplace_back(t);
+        e.entries = std::atoll(std::string(f[2]).c_str());
+        return true;
+    }
+
+    // Writes the index to `path` (via a temporary file, so readers never see a partial index)
+    static bool Write(const std::string& path, const std::vector<std::pair<std::string, Entry>>& rows) {
+        const std::string tmp = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream out(tmp);
+            if (!out) { std::cerr << "[SignalIndex] ERROR: cannot write " << tmp << "\n"; return false; }
+            out << "# path\ttoken\tsms_trees\tentries\n";
+            for (const auto& r : rows) {
+                std::string trees;
+                for (const auto& t : r.second.smsTrees) { if (!trees.empty()) trees += ","; trees += t; }
+                out << r.first << "\t" << (r.second.token.empty() ? "-" : r.second.token) << "\t"
+                    << (trees.empty() ? "-" : trees) << "\t" << r.second.entries << "\n";
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::cerr << "[SignalIndex] ERROR: cannot move " << tmp << " to " << path << "\n";
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    ~SignalIndex() { if (data_) munmap(const_cast<char*>(data_), size_); }
+    SignalIndex(const SignalIndex&) = delete;
+    SignalIndex& operator=(const SignalIndex&) = delete;
+
+private:
+    explicit SignalIndex(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return; // no index: callers fall back to reading the files
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) { data_ = static_cast<const char*>(p); size_ = st.st_size; }
+        }
+        close(fd);
+        if (!data_) return;
+
+        // path -> rest of the line, both pointing into the mapping
+        std::string_view all(data_, size_);
+        size_t pos = 0;
+        while (pos < all.size()) {
+            size_t eol = all.find('\n', pos);
+            if (eol == std::string_view::npos) eol = all.size();
+            std::string_view line = all.substr(pos, eol - pos);
+            pos = eol + 1;
+            if (line.empty() || line[0] == '#') continue;
+            size_t tab = line.find('\t');
+            if (tab == std::string_view::npos) continue;
+            rows_[line.substr(0, tab)] = line.substr(tab + 1);
+        }
+        std::cout << "[SignalIndex] " << rows_.size() << " signal files indexed in " << path << "\n";
+    }
+
+    static std::vector<std::string_view> Split(std::string_view s, char delim) {
+        std::vector<std::string_view> out;
+        size_t pos = 0;
+        while (true) {
+            size_t next = s.find(delim, pos);
+            out.push_back(s.substr(pos, next == std::string_view::npos ? std::string_view::npos : next - pos));
+            if (next == std::string_view::npos) break;
+            pos = next + 1;
+        }
+        return out;
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::unordered_map<std::string_view, std::string_view> rows_;
+};
+
+#endif
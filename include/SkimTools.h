@@ -0,0 +1,120 @@
+#ifndef SKIMTOOLS_H
+#define SKIMTOOLS_H
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <iostream>
+#include <memory>
+#include <cctype>
+#include <filesystem>
+
+#include "TFile.h"
+#include "TNamed.h"
+#include "TSystem.h"
+#include "nlohmann/json.hpp"
+#include "EntryBitmap.h"
+
+// Provenance of one skimmed tree written by BFI_skim.x, stored next to the tree as
+// TNamed "SkimProvenance_<tree>" holding a JSON document.
+struct SkimInfo {
+    std::string source, tree;
+    long long entries = 0, skimEntries = 0;
+    double sumW = 0., sumW2 = 0.;                         // unscaled sums of weight / weight2 before any cut
+    std::vector<std::string> preselection;                // applied in this order
+    std::vector<std::pair<double,double>> preselectionSums; // cumulative (sumW, sumW2) after each preselection cut
+    std::vector<std::string> columns;                     // columns in the skim
+    std::vector<std::string> dropped;                     // source branches not kept
+};
+
+// Skim file for a source ntuple: <skimDir>/<source stem>.root
+inline std::string SkimPathFor(const std::string &skimDir, const std::string &source) {
+    return (std::filesystem::path(skimDir) / (std::filesystem::path(source).stem().string() + ".root")).string();
+}
+
+inline std::string SkimProvenanceName(const std::string &tree) { return "SkimProvenance_" + tree; }
+
+// Cut strings compare equal when they only differ by whitespace
+inline std::string SkimCutKey(const std::string &cut) {
+    std::string k;
+    for (char c : cut) if (!std::isspace(static_cast<unsigned char>(c))) k += c;
+    return k;
+}
+
+inline bool WriteSkimInfo(const std::string &skimPath, const SkimInfo &info) {
+    nlohmann::json j;
+    j["source"] = info.source;
+    j["tree"] = info.tree;
+    j["entries"] = info.entries;
+    j["skim_entries"] = info.skimEntries;
+    j["sumW"] = info.sumW;
+    j["sumW2"] = info.sumW2;
+    j["preselection"] = info.preselection;
+    j["preselection_sums"] = info.preselectionSums;
+    j["columns"] = info.columns;
+    j["dropped"] = info.dropped;
+
+    std::unique_ptr<TFile> f(TFile::Open(skimPath.c_str(), "UPDATE"));
+    if (!f || f->IsZombie()) {
+        std::cerr << "[SkimTools] ERROR: cannot open " << skimPath << " to write provenance\n";
+        return false;
+    }
+    TNamed prov(SkimProvenanceName(info.tree).c_str(), j.dump().c_str());
+    prov.Write(nullptr, TObject::kOverwrite);
+    f->Close();
+    return true;
+}
+
+inline bool ReadSkimInfo(const std::string &skimPath, const std::string &tree, SkimInfo &info) {
+    if (gSystem->AccessPathName(skimPath.c_str())) return false; // no skim
+    std::unique_ptr<TFile> f(TFile::Open(skimPath.c_str(), "READ"));
+    if (!f || f->IsZombie()) return false;
+    auto *prov = dynamic_cast<TNamed*>(f->Get(SkimProvenanceName(tree).c_str()));
+    if (!prov) return false;
+    try {
+        auto j = nlohmann::json::parse(prov->GetTitle());
+        info.source = j.at("source").get<std::string>();
+        info.tree = j.at("tree").get<std::string>();
+        info.entries = j.at("entries").get<long long>();
+        info.skimEntries = j.at("skim_entries").get<long long>();
+        info.sumW = j.at("sumW").get<double>();
+        info.sumW2 = j.at("sumW2").get<double>();
+        info.preselection = j.at("preselection").get<std::vector<std::string>>();
+        info.preselectionSums = j.at("preselection_sums").get<std::vector<std::pair<double,double>>>();
+        info.columns = j.at("columns").get<std::vector<std::string>>();
+        info.dropped = j.at("dropped").get<std::vector<std::string>>();
+    } catch (const std::exception &e) {
+        std::cerr << "[SkimTools] WARNING: bad provenance in " << skimPath << ": " << e.what() << "\n";
+        return false;
+    }
+    return info.preselection.size() == info.preselectionSums.size();
+}
+
+// A skim can replace `source` when it was made from it (and the source tree still has the
+// entries it had then, so a regenerated source is not shadowed by an old skim), keeps every
+// column the configuration references (`needed` may hold non-column identifiers too), and its
+// preselection is part of every bin's cuts. binCuts == nullptr skips the last check.
+inline bool SkimUsable(const SkimInfo &info, const std::string &source, const std::set<std::string> &needed,
+                       const std::vector<std::vector<std::string>> *binCuts, std::string &why) {
+    if (info.source != source) { why = "made from " + info.source; return false; }
+    const int64_t entries = TreeEntries(source, info.tree);
+    if (entries != info.entries) {
+        why = "made for " + std::to_string(info.entries) + " source entries, the tree has " + std::to_string(entries);
+        return false;
+    }
+    for (const auto &d : info.dropped) {
+        if (needed.count(d)) { why = "column " + d + " was dropped"; return false; }
+    }
+    if (binCuts) {
+        for (const auto &cuts : *binCuts) {
+            std::set<std::string> keys;
+            for (const auto &c : cuts) keys.insert(SkimCutKey(c));
+            for (const auto &p : info.preselection) {
+                if (!keys.count(SkimCutKey(p))) { why = "preselection \"" + p + "\" is not applied by every bin"; return false; }
+            }
+        }
+    }
+    return true;
+}
+
+#endif
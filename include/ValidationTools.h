@@ -169,9 +169,9 @@ inline bool ValidateDerivedVar(ROOT::RDF::RNode node,
     }
 }
 
-// Register helper functions with ROOT's Cling interpreter
-inline void RegisterSafeHelpers() {
-    gInterpreter->Declare(R"(
+// Helper functions usable in cut/derived-variable expressions (also compiled into CutCache libraries)
+inline const char* SafeHelpersCode() {
+    return R"(
         #include "ROOT/RVec.hxx"
         #include <cmath>
 
@@ -185,5 +185,11 @@ inline void RegisterSafeHelpers() {
         inline T SafeIndex(const ROOT::RVec<T>& vec, unsigned idx, T def = -1) {
             return (idx < vec.size()) ? vec[idx] : def;
         }
-    )");
+    )";
+}
+
+// Register helper functions with ROOT's Cling interpreter (once per process)
+inline void RegisterSafeHelpers() {
+    static bool declared = false;
+    if (!declared) declared = gInterpreter->Declare(SafeHelpersCode());
 }
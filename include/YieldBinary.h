@@ -0,0 +1,223 @@
+#ifndef YIELDBINARY_H
+#define YIELDBINARY_H
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "nlohmann/json.hpp"
+
+// Binary yield file ("BYF1"), the compact alternative to the yield JSONs:
+//   header   | magic "BYF1", version, flags, nStrings, stringBytes, nRecords
+//   offsets  | uint32[nStrings + 1] into the string blob
+//   strings  | bin / process / file names, padded to 8 bytes
+//   records  | YieldRecord[nRecords]
+// Records with file == kNoFile are per-process totals. Files are read through mmap, so
+// opening one costs a page fault, not a parse. Native byte order (all producers are x86).
+struct YieldRecord {
+    uint32_t bin, proc, file, pad;
+    double count, sumW, sumW2;
+};
+
+class YieldBinary {
+public:
+    static constexpr uint32_t kNoFile = 0xffffffffu;
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kPartial = 1u; // flags: per-file records present (BFI_condor layout)
+
+    struct Header {
+        char magic[4];
+        uint32_t version, flags, nStrings;
+        uint64_t stringBytes, nRecords;
+    };
+
+    // --- writing ---
+    uint32_t Intern(const std::string &s) {
+        auto it = ids_.find(s);
+        if (it != ids_.end()) return it->second;
+        const uint32_t id = strings_.size();
+        strings_.push_back(s);
+        ids_.emplace(s, id);
+        return id;
+    }
+
+    void Add(const std::string &bin, const std::string &proc, const std::string &file,
+             double count, double sumW, double sumW2) {
+        YieldRecord r{Intern(bin), Intern(proc), file.empty() ? kNoFile : Intern(file), 0, count, sumW, sumW2};
+        if (r.file != kNoFile) flags_ |= kPartial;
+        records_.push_back(r);
+    }
+
+    // Written to a temporary file and renamed into place
+    bool Write(const std::string &path) const {
+        std::vector<uint32_t> offsets(1, 0);
+        std::string blob;
+        for (const auto &s : strings_) { blob += s; offsets.push_back(blob.size()); }
+        const size_t headBytes = sizeof(Header) + offsets.size() * sizeof(uint32_t);
+        blob.resize(Pad(headBytes + blob.size()) - headBytes, '\0');
+
+        Header h;
+        std::memcpy(h.magic, "BYF1", 4);
+        h.version = kVersion;
+        h.flags = flags_;
+        h.nStrings = strings_.size();
+        h.stringBytes = blob.size();
+        h.nRecords = records_.size();
+
+        const std::string tmp = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!out) { std::cerr << "[YieldBinary] ERROR: cannot write " << tmp << "\n"; return false; }
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+            out.write(blob.data(), blob.size());
+            out.write(reinterpret_cast<const char*>(records_.data()), records_.size() * sizeof(YieldRecord));
+            if (!out) { std::remove(tmp.c_str()); return false; }
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    // --- reading ---
+    YieldBinary() = default;
+    YieldBinary(const YieldBinary&) = delete;
+    YieldBinary& operator=(const YieldBinary&) = delete;
+    ~YieldBinary() { Close(); }
+
+    static bool IsBinary(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[4] = {0, 0, 0, 0};
+        in.read(magic, 4);
+        return in && std::memcmp(magic, "BYF1", 4) == 0;
+    }
+
+    bool Open(const std::string &path) {
+        Close();
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header)) {
+            void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) { map_ = static_cast<const char*>(p); mapSize_ = st.st_size; }
+        }
+        close(fd);
+        if (!map_) {
+            std::cerr << "[YieldBinary] ERROR: cannot read " << path << " as a BYF1 file\n";
+            return false;
+        }
+
+        head_ = reinterpret_cast<const Header*>(map_);
+        if (!Valid()) {
+            std::cerr << "[YieldBinary] ERROR: " << path << " is not a valid BYF1 file\n";
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    size_t Size() const { return head_ ? head_->nRecords : records_.size(); }
+    const YieldRecord &Record(size_t i) const { return head_ ? recs_[i] : records_[i]; }
+    bool Partial() const { return (head_ ? head_->flags : flags_) & kPartial; }
+    std::string_view String(uint32_t id) const {
+        if (!head_) return strings_[id];
+        return std::string_view(blob_ + offsets_[id], offsets_[id + 1] - offsets_[id]);
+    }
+
+    // Totals only, as flattened JSON {bin: {proc: [n, w, err, sumW2]}} (JSONFactory / BF.x layout)
+    nlohmann::json ToFlatJSON() const {
+        nlohmann::json j = nlohmann::json::object();
+        for (size_t i = 0; i < Size(); ++i) {
+            const YieldRecord &r = Record(i);
+            if (r.file != kNoFile) continue;
+            j[std::string(String(r.bin))][std::string(String(r.proc))] = {r.count, r.sumW, std::sqrt(r.sumW2), r.sumW2};
+        }
+        return j;
+    }
+
+    // Flattened JSON {bin: {proc: [n, w, err, sumW2]}} (JSONFactory / BF.x layout) into binary;
+    // 3-element arrays from older files give sumW2 = err^2
+    void FromFlatJSON(const nlohmann::json &j) {
+        for (const auto &b : j.items())
+            for (const auto &p : b.value().items()) {
+                const auto &v = p.value();
+                double sumW2 = 0.;
+                if (v.size() > 3) sumW2 = v[3].get<double>();
+                else if (v.size() > 2) sumW2 = v[2].get<double>() * v[2].get<double>();
+                Add(b.key(), p.key(), "", v[0].get<double>(), v[1].get<double>(), sumW2);
+            }
+    }
+
+private:
+    static size_t Pad(size_t n) { return (n + 7) & ~size_t(7); }
+
+    // Checks the mapped header, offsets and records once, so String() and Record() stay inside the
+    // mapping for a corrupt or partly transferred file; sets offsets_, blob_ and recs_
+    bool Valid() {
+        if (std::memcmp(head_->magic, "BYF1", 4) != 0 || head_->version != kVersion) return false;
+        const uint64_t nStrings = head_->nStrings;
+        size_t left = mapSize_ - sizeof(Header);
+        if ((nStrings + 1) > left / sizeof(uint32_t)) return false;
+        const size_t offBytes = (nStrings + 1) * sizeof(uint32_t);
+        left -= offBytes;
+        if (head_->stringBytes > left) return false;
+        left -= head_->stringBytes;
+        if (head_->nRecords > left / sizeof(YieldRecord)) return false;
+
+        offsets_ = reinterpret_cast<const uint32_t*>(map_ + sizeof(Header));
+        blob_ = map_ + sizeof(Header) + offBytes;
+        recs_ = reinterpret_cast<const YieldRecord*>(blob_ + head_->stringBytes);
+
+        // offsets start at 0, never decrease, and the blob is the strings padded to 8 bytes (Write)
+        if (offsets_[0] != 0) return false;
+        for (uint64_t i = 0; i < nStrings; ++i)
+            if (offsets_[i + 1] < offsets_[i]) return false;
+        const size_t headBytes = sizeof(Header) + offBytes;
+        if (offsets_[nStrings] > head_->stringBytes ||
+            head_->stringBytes != Pad(headBytes + offsets_[nStrings]) - headBytes) return false;
+
+        for (uint64_t i = 0; i < head_->nRecords; ++i) {
+            const YieldRecord &r = recs_[i];
+            if (r.bin >= nStrings || r.proc >= nStrings || (r.file != kNoFile && r.file >= nStrings)) return false;
+        }
+        return true;
+    }
+
+    void Close() {
+        if (map_) munmap(const_cast<char*>(map_), mapSize_);
+        map_ = nullptr; mapSize_ = 0; head_ = nullptr;
+    }
+
+    // writer state
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::vector<YieldRecord> records_;
+    uint32_t flags_ = 0;
+
+    // reader state
+    const char *map_ = nullptr;
+    size_t mapSize_ = 0;
+    const Header *head_ = nullptr;
+    const uint32_t *offsets_ = nullptr;
+    const char *blob_ = nullptr;
+    const YieldRecord *recs_ = nullptr;
+};
+
+// Output path with the extension for `format` ("json" or "binary")
+inline std::string YieldPathFor(const std::string &path, const std::string &format) {
+    const std::string ext = (format == "binary") ? ".byf" : ".json";
+    const size_t slash = path.find_last_of('/');
+    const size_t dot = path.find_last_of('.');
+    const std::string stem = (dot != std::string::npos && (slash == std::string::npos || dot > slash)) ? path.substr(0, dot) : path;
+    return stem + ext;
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef YIELDCUBE_H
+#define YIELDCUBE_H
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+
+#include "TTreeReader.h"
+#include <ROOT/RDataFrame.hxx>
+
+// One axis of a yield cube: the value of `expr` binned by `edges` (plus under/overflow)
+struct CubeAxis {
+    std::string name, expr;
+    std::vector<double> edges;
+    // nBins equal bins in [lo, hi]
+    static CubeAxis Uniform(const std::string &name, const std::string &expr, int nBins, double lo, double hi) {
+        CubeAxis a{name, expr, {}};
+        for (int i = 0; i <= nBins; ++i) a.edges.push_back(lo + (hi - lo) * i / nBins);
+        return a;
+    }
+};
+
+// lo <= axis < hi; thresholds are snapped to the nearest bin edge (with a warning when not on one).
+// Thresholds beyond the first/last edge fall in the open under/overflow bin, which then passes only
+// in part and is left out (with a warning): the yield misses those events.
+struct CubeCut {
+    std::string axis;
+    double lo = -std::numeric_limits<double>::infinity();
+    double hi = std::numeric_limits<double>::infinity();
+};
+
+struct CubeYield {
+    double sumW = 0., sumW2 = 0., count = 0.;
+    void Add(const CubeYield &o) { sumW += o.sumW; sumW2 += o.sumW2; count += o.count; }
+};
+
+// Fine-binned weighted yields of one process over a few cut variables, filled once and stored
+// sparsely (only occupied cells). Query() answers "yield for MET>=x && RISR>=y ..." for any box
+// of whole bins by a scan over the occupied cells, or after Freeze() from a dense prefix-sum
+// table (2^d lookups). The table holds every cell (24 B each, up to kMaxDenseCells), so freeze
+// only the cubes queried many times, e.g. the per-process sums of a cut scan.
+class YieldCube {
+public:
+    static constexpr size_t kMaxDenseCells = size_t(1) << 22;
+
+    YieldCube() {}
+    explicit YieldCube(const std::vector<CubeAxis> &axes) : axes_(axes) {
+        size_t stride = 1;
+        for (const auto &a : axes_) { strides_.push_back(stride); stride *= a.edges.size() + 1; }
+        nCells_ = stride;
+    }
+
+    const std::vector<CubeAxis> &Axes() const { return axes_; }
+    size_t Occupied() const { return cells_.size(); }
+
+    void Fill(const double *x, double w, double w2) {
+        uint64_t idx = 0;
+        for (size_t d = 0; d < axes_.size(); ++d) idx += BinOf(d, x[d]) * strides_[d];
+        CubeYield &c = cells_[idx];
+        c.sumW += w; c.sumW2 += w2; c.count += 1.;
+        prefix_.clear();
+    }
+
+    // Adds a cube with the same axes (other processes, other slots, other files)
+    bool Add(const YieldCube &o) {
+        if (!SameAxes(o)) return false;
+        for (const auto &kv : o.cells_) cells_[kv.first].Add(kv.second);
+        prefix_.clear();
+        return true;
+    }
+
+    bool SameAxes(const YieldCube &o) const {
+        if (axes_.size() != o.axes_.size()) return false;
+        for (size_t d = 0; d < axes_.size(); ++d)
+            if (axes_[d].name != o.axes_[d].name || axes_[d].edges != o.axes_[d].edges) return false;
+        return true;
+    }
+
+    // Builds the dense inclusive prefix sums when they fit; later fills drop them again
+    void Freeze() {
+        prefix_.clear();
+        if (nCells_ > kMaxDenseCells) return;
+        prefix_.assign(nCells_, CubeYield{});
+        for (const auto &kv : cells_) prefix_[kv.first] = kv.second;
+        // one running sum per dimension turns cell contents into sums over [0..i0] x [0..i1] x ...
+        for (size_t d = 0; d < axes_.size(); ++d) {
+            const size_t n = axes_[d].edges.size() + 1, s = strides_[d];
+            for (size_t i = 0; i < nCells_; ++i)
+                if ((i / s) % n != 0) prefix_[i].Add(prefix_[i - s]);
+        }
+    }
+
+    // Yield inside every cut (cuts on the same axis intersect); unknown axes are reported and ignored
+    CubeYield Query(const std::vector<CubeCut> &cuts) const {
+        const size_t D = axes_.size();
+        std::vector<size_t> lo(D, 0), hi(D);
+        for (size_t d = 0; d < D; ++d) hi[d] = axes_[d].edges.size(); // overflow bin
+        bool empty = false;
+        for (const auto &c : cuts) {
+            const size_t d = AxisIndex(c.axis);
+            if (d == D) { std::cerr << "[YieldCube] No axis " << c.axis << "\n"; continue; }
+            // bin k covers [edges[k-1], edges[k]); a threshold at edge e starts bin e+1 / ends bin e
+            int side = 0;
+            if (std::isfinite(c.lo)) {
+                lo[d] = std::max(lo[d], SnapEdge(d, c.lo, side) + 1); // below: underflow left out
+                empty = empty || side > 0;                              // above: only the overflow could pass
+            }
+            if (std::isfinite(c.hi)) {
+                hi[d] = std::min(hi[d], SnapEdge(d, c.hi, side)); // above: overflow left out
+                empty = empty || side < 0;
+            }
+        }
+        CubeYield out;
+        if (empty) return out;
+        for (size_t d = 0; d < D; ++d) if (lo[d] > hi[d]) return out;
+
+        if (prefix_.empty()) {
+            for (const auto &kv : cells_) {
+                bool in = true;
+                for (size_t d = 0; d < D && in; ++d) {
+                    const size_t k = (kv.first / strides_[d]) % (axes_[d].edges.size() + 1);
+                    in = k >= lo[d] && k <= hi[d];
+                }
+                if (in) out.Add(kv.second);
+            }
+            return out;
+        }
+        // inclusion-exclusion over the 2^D corners of the box
+        for (uint64_t corner = 0; corner < (uint64_t(1) << D); ++corner) {
+            uint64_t idx = 0;
+            int sign = 1;
+            bool skip = false;
+            for (size_t d = 0; d < D && !skip; ++d) {
+                if (corner >> d & 1) {
+                    if (lo[d] == 0) skip = true;
+                    idx += (lo[d] - 1) * strides_[d];
+                    sign = -sign;
+                } else {
+                    idx += hi[d] * strides_[d];
+                }
+            }
+            if (skip) continue;
+            const CubeYield &p = prefix_[idx];
+            out.sumW += sign * p.sumW;
+            out.sumW2 += sign * p.sumW2;
+            out.count += sign * p.count;
+        }
+        return out;
+    }
+
+    // Cubes keyed by process in one binary file (written to a temporary, then renamed)
+    static bool Write(const std::string &path, const std::map<std::string, YieldCube> &cubes) {
+        const std::string tmp = path + ".tmp" + std::to_string(getpid());
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!out) return false;
+            auto put = [&](const void *p, size_t n) { out.write(static_cast<const char*>(p), n); };
+            auto putStr = [&](const std::string &s) { uint64_t n = s.size(); put(&n, 8); put(s.data(), n); };
+            put(&kMagic, 4);
+            uint64_t n = cubes.size();
+            put(&n, 8);
+            for (const auto &kv : cubes) {
+                putStr(kv.first);
+                uint64_t nAxes = kv.second.axes_.size(), nOcc = kv.second.cells_.size();
+                put(&nAxes, 8);
+                for (const auto &a : kv.second.axes_) {
+                    putStr(a.name); putStr(a.expr);
+                    uint64_t ne = a.edges.size();
+                    put(&ne, 8); put(a.edges.data(), ne * sizeof(double));
+                }
+                put(&nOcc, 8);
+                for (const auto &c : kv.second.cells_) { put(&c.first, 8); put(&c.second, sizeof(CubeYield)); }
+            }
+            if (!out) { std::remove(tmp.c_str()); return false; }
+        }
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+
+    static bool Read(const std::string &path, std::map<std::string, YieldCube> &cubes) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        auto get = [&](void *p, size_t n) { in.read(static_cast<char*>(p), n); return bool(in); };
+        auto getStr = [&](std::string &s) {
+            uint64_t n = 0;
+            if (!get(&n, 8) || n > (1u << 20)) return false;
+            s.resize(n);
+            return get(&s[0], n);
+        };
+        uint32_t magic = 0;
+        uint64_t n = 0;
+        if (!get(&magic, 4) || magic != kMagic || !get(&n, 8)) return false;
+        for (uint64_t i = 0; i < n; ++i) {
+            std::string name;
+            uint64_t nAxes = 0, nOcc = 0;
+            if (!getStr(name) || !get(&nAxes, 8) || nAxes > 64) return false;
+            std::vector<CubeAxis> axes(nAxes);
+            for (auto &a : axes) {
+                uint64_t ne = 0;
+                if (!getStr(a.name) || !getStr(a.expr) || !get(&ne, 8) || ne > (1u << 24)) return false;
+                a.edges.resize(ne);
+                if (!get(a.edges.data(), ne * sizeof(double))) return false;
+            }
+            YieldCube cube(axes);
+            if (!get(&nOcc, 8)) return false;
+            for (uint64_t k = 0; k < nOcc; ++k) {
+                uint64_t idx = 0;
+                CubeYield y;
+                if (!get(&idx, 8) || !get(&y, sizeof(CubeYield))) return false;
+                cube.cells_[idx] = y;
+            }
+            cubes[name] = std::move(cube);
+        }
+        return true;
+    }
+
+private:
+    static constexpr uint32_t kMagic = 0x42435942; // "BYCB"
+
+    // 0 underflow, k in [1, n-1] for [edges[k-1], edges[k]), n = edges.size() overflow
+    size_t BinOf(size_t d, double x) const {
+        const auto &e = axes_[d].edges;
+        return std::upper_bound(e.begin(), e.end(), x) - e.begin();
+    }
+    size_t NearestEdge(size_t d, double x) const {
+        const auto &e = axes_[d].edges;
+        size_t k = std::lower_bound(e.begin(), e.end(), x) - e.begin();
+        if (k == e.size() || (k > 0 && x - e[k - 1] < e[k] - x)) --k;
+        return k;
+    }
+    // NearestEdge, warning when x is not on it; side is -1/+1 when x lies beyond the first/last edge
+    size_t SnapEdge(size_t d, double x, int &side) const {
+        const auto &e = axes_[d].edges;
+        const size_t k = NearestEdge(d, x);
+        const double tol = 1e-9 * std::max(1., std::fabs(e[k]));
+        side = x < e.front() - tol ? -1 : (x > e.back() + tol ? 1 : 0);
+        if (side != 0)
+            std::cerr << "[YieldCube] " << axes_[d].name << " threshold " << x << " is outside [" << e.front() << ", "
+                      << e.back() << "]; the " << (side < 0 ? "underflow" : "overflow") << " bin is not counted\n";
+        else if (std::fabs(x - e[k]) > tol)
+            std::cerr << "[YieldCube] " << axes_[d].name << " threshold " << x << " snapped to the bin edge " << e[k] << "\n";
+        return k;
+    }
+    size_t AxisIndex(const std::string &name) const {
+        for (size_t d = 0; d < axes_.size(); ++d) if (axes_[d].name == name) return d;
+        return axes_.size();
+    }
+
+    std::vector<CubeAxis> axes_;
+    std::vector<size_t> strides_;
+    size_t nCells_ = 0;
+    std::unordered_map<uint64_t, CubeYield> cells_;
+    std::vector<CubeYield> prefix_; // dense inclusive prefix sums, empty until Freeze()
+};
+
+// RDF action over (values, weight, weight^2): one cube per slot, merged in Finalize()
+class YieldCubeHelper : public ROOT::Detail::RDF::RActionImpl<YieldCubeHelper> {
+public:
+    using Result_t = YieldCube;
+
+    YieldCubeHelper(const std::vector<CubeAxis> &axes, unsigned int nSlots)
+        : slots_(nSlots, YieldCube(axes)), result_(std::make_shared<Result_t>(axes)) {}
+    YieldCubeHelper(YieldCubeHelper &&) = default;
+    YieldCubeHelper(const YieldCubeHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+    void Initialize() {}
+    void InitTask(TTreeReader *, unsigned int) {}
+
+    void Exec(unsigned int slot, const ROOT::RVec<double> &x, double w, double w2) {
+        slots_[slot].Fill(x.data(), w, w2);
+    }
+
+    void Finalize() {
+        for (const auto &s : slots_) result_->Add(s);
+        slots_.clear();
+    }
+
+    std::string GetActionName() { return "YieldCube"; }
+
+private:
+    std::vector<YieldCube> slots_;
+    std::shared_ptr<Result_t> result_;
+};
+
+#endif
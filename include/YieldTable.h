@@ -0,0 +1,78 @@
+#ifndef YIELDTABLE_H
+#define YIELDTABLE_H
+#include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "nlohmann/json.hpp"
+
+// Immutable, indexed view of a flattened yield JSON {bin: {proc: [n, w, err, sumW2]}}:
+// bins and processes are numbered once (JSON order, processes by first appearance) and the
+// rates / errors sit in dense bin x process arrays. Safe to share read-only between threads.
+class YieldTable {
+public:
+    static constexpr uint32_t kNone = 0xffffffffu;
+
+    explicit YieldTable(const nlohmann::json &j) {
+        for (auto b = j.begin(); b != j.end(); ++b) {
+            const uint32_t bi = bins_.size();
+            binIndex_.emplace(b.key(), bi);
+            bins_.push_back(b.key());
+            procsIn_.emplace_back();
+            for (auto p = b.value().begin(); p != b.value().end(); ++p) {
+                auto it = procIndex_.find(p.key());
+                if (it == procIndex_.end()) {
+                    it = procIndex_.emplace(p.key(), procs_.size()).first;
+                    procs_.push_back(p.key());
+                }
+                procsIn_[bi].push_back(it->second);
+                const auto &v = p.value();
+                double sumW2 = 0.;
+                if (v.size() > 3) sumW2 = v[3].get<double>();
+                else if (v.size() > 2) sumW2 = v[2].get<double>() * v[2].get<double>();
+                cells_.push_back({bi, it->second, v.size() > 1 ? v[1].get<float>() : 0.f, static_cast<float>(std::sqrt(sumW2))});
+            }
+        }
+        // dense arrays once the process count is known
+        rate_.assign(bins_.size() * procs_.size(), 0.f);
+        err_.assign(rate_.size(), 0.f);
+        present_.assign(rate_.size(), 0);
+        for (const auto &c : cells_) {
+            const size_t k = size_t(c.bin) * procs_.size() + c.proc;
+            rate_[k] = c.rate;
+            err_[k] = c.err;
+            present_[k] = 1;
+        }
+        cells_.clear();
+        cells_.shrink_to_fit();
+    }
+
+    size_t NBins() const { return bins_.size(); }
+    size_t NProcs() const { return procs_.size(); }
+    const std::string &Bin(uint32_t b) const { return bins_[b]; }
+    const std::string &Proc(uint32_t p) const { return procs_[p]; }
+    uint32_t BinIndex(const std::string &bin) const { auto it = binIndex_.find(bin); return it == binIndex_.end() ? kNone : it->second; }
+    uint32_t ProcIndex(const std::string &proc) const { auto it = procIndex_.find(proc); return it == procIndex_.end() ? kNone : it->second; }
+    // processes of bin b, in JSON order
+    const std::vector<uint32_t> &ProcsIn(uint32_t b) const { return procsIn_[b]; }
+
+    bool Has(uint32_t b, uint32_t p) const { return b < bins_.size() && p < procs_.size() && present_[Index(b, p)]; }
+    float Rate(uint32_t b, uint32_t p) const { return rate_[Index(b, p)]; }   // weighted events
+    float Error(uint32_t b, uint32_t p) const { return err_[Index(b, p)]; }   // sqrt(sumW2)
+
+private:
+    struct Cell { uint32_t bin, proc; float rate, err; };
+
+    size_t Index(uint32_t b, uint32_t p) const { return size_t(b) * procs_.size() + p; }
+
+    std::vector<std::string> bins_, procs_;
+    std::unordered_map<std::string, uint32_t> binIndex_, procIndex_;
+    std::vector<std::vector<uint32_t>> procsIn_;
+    std::vector<float> rate_, err_;
+    std::vector<char> present_;
+    std::vector<Cell> cells_; // construction only
+};
+
+#endif
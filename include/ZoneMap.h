@@ -0,0 +1,263 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "TEntryList.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TTreeReader.h"
+#include <ROOT/RDataFrame.hxx>
+#include "nlohmann/json.hpp"
+#include "EntryBitmap.h"
+
+// "<branch> <op> <number>", the scalar cuts a zone map can decide
+struct ZoneCut {
+    size_t branch = 0;
+    std::string op;
+    double value = 0.;
+};
+
+// Per-cluster min/max of a few scalar branches of one source tree, written by BFI_skim.x next to
+// the skim as <stem>.zonemap.json (ZoneMapPathFor). A cluster in which no entry can pass a
+// bin's scalar cuts (MET>=150 with max(MET) < 150) is never read for that bin; the readers build
+// an entry list of the clusters some bin may pass, so the others are not even decompressed.
+// NaN values are left out of min/max: they fail every comparison a ZoneCut can hold.
+struct ZoneMap {
+    std::string source, tree;
+    long long entries = 0;
+    std::vector<std::string> branches;
+    std::vector<long long> clusterStart; // first entry of every cluster, then `entries`
+    std::vector<double> min, max;        // [cluster * branches.size() + branch]
+
+    size_t NClusters() const { return clusterStart.empty() ? 0 : clusterStart.size() - 1; }
+
+    bool Parse(const std::string &atom, ZoneCut &cut) const {
+        static const std::regex re(R"(^\s*([A-Za-z_]\w*)\s*(>=|<=|==|>|<)\s*([-+]?(\d+\.?\d*|\.\d+)([eE][-+]?\d+)?)\s*$)");
+        std::smatch m;
+        if (!std::regex_match(atom, m, re)) return false;
+        auto it = std::find(branches.begin(), branches.end(), m[1].str());
+        if (it == branches.end()) return false;
+        cut.branch = it - branches.begin();
+        cut.op = m[2].str();
+        cut.value = std::stod(m[3].str());
+        return true;
+    }
+
+    // false when no entry of cluster c can pass `cut`
+    bool MayPass(size_t c, const ZoneCut &cut) const {
+        const double lo = min[c * branches.size() + cut.branch], hi = max[c * branches.size() + cut.branch];
+        if (lo > hi) return false; // only NaN
+        if (cut.op == ">=") return hi >= cut.value;
+        if (cut.op == ">")  return hi > cut.value;
+        if (cut.op == "<=") return lo <= cut.value;
+        if (cut.op == "<")  return lo < cut.value;
+        return lo <= cut.value && cut.value <= hi; // ==
+    }
+
+    // Clusters some bin may pass; binAtoms are the bins' atomic predicates (FilterTrie::Atoms),
+    // a bin without a mapped cut keeps every cluster
+    std::vector<char> Keep(const std::vector<std::vector<std::string>> &binAtoms) const {
+        std::vector<char> keep(NClusters(), 0);
+        for (const auto &atoms : binAtoms) {
+            std::vector<ZoneCut> cuts;
+            ZoneCut zc;
+            for (const auto &a : atoms) if (Parse(a, zc)) cuts.push_back(zc);
+            for (size_t c = 0; c < NClusters(); ++c) {
+                if (keep[c]) continue;
+                keep[c] = std::all_of(cuts.begin(), cuts.end(), [&](const ZoneCut &z) { return MayPass(c, z); });
+            }
+        }
+        return keep;
+    }
+
+    long long KeptEntries(const std::vector<char> &keep) const {
+        long long n = 0;
+        for (size_t c = 0; c < keep.size(); ++c) if (keep[c]) n += clusterStart[c + 1] - clusterStart[c];
+        return n;
+    }
+};
+
+// Zone maps of `source` written next to its skim in `dir`, small enough to ship to every job
+inline std::string ZoneMapPathFor(const std::string &dir, const std::string &source) {
+    return (std::filesystem::path(dir) / (std::filesystem::path(source).stem().string() + ".zonemap.json")).string();
+}
+
+// One JSON object per file, keyed by tree
+inline bool WriteZoneMaps(const std::string &path, const std::vector<ZoneMap> &maps) {
+    // JSON has no infinities: clusters without a value store null
+    auto finite = [](const std::vector<double> &v) {
+        nlohmann::json a = nlohmann::json::array();
+        for (double x : v) a.push_back(std::isfinite(x) ? nlohmann::json(x) : nlohmann::json());
+        return a;
+    };
+    nlohmann::json out = nlohmann::json::object();
+    for (const auto &zm : maps) {
+        nlohmann::json &j = out[zm.tree];
+        j["source"] = zm.source;
+        j["tree"] = zm.tree;
+        j["entries"] = zm.entries;
+        j["branches"] = zm.branches;
+        j["cluster_start"] = zm.clusterStart;
+        j["min"] = finite(zm.min);
+        j["max"] = finite(zm.max);
+    }
+    // written to a temporary and renamed, so a reader never sees a partial sidecar
+    const std::string tmp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream f(tmp);
+        if (!(f << out.dump() << "\n")) {
+            std::cerr << "[ZoneMap] ERROR: cannot write the zone maps to " << tmp << "\n";
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "[ZoneMap] ERROR: cannot write the zone maps to " << path << "\n";
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+inline bool ReadZoneMap(const std::string &path, const std::string &tree, ZoneMap &zm) {
+    std::ifstream f(path);
+    if (!f) return false;
+    try {
+        const auto all = nlohmann::json::parse(f);
+        if (!all.contains(tree)) return false;
+        const auto &j = all.at(tree);
+        zm.source = j.at("source").get<std::string>();
+        zm.tree = j.at("tree").get<std::string>();
+        zm.entries = j.at("entries").get<long long>();
+        zm.branches = j.at("branches").get<std::vector<std::string>>();
+        zm.clusterStart = j.at("cluster_start").get<std::vector<long long>>();
+        zm.min.clear();
+        zm.max.clear();
+        for (const auto &x : j.at("min")) zm.min.push_back(x.is_null() ? std::numeric_limits<double>::infinity() : x.get<double>());
+        for (const auto &x : j.at("max")) zm.max.push_back(x.is_null() ? -std::numeric_limits<double>::infinity() : x.get<double>());
+    } catch (const std::exception &e) {
+        std::cerr << "[ZoneMap] WARNING: bad zone map in " << path << ": " << e.what() << "\n";
+        return false;
+    }
+    return zm.clusterStart.size() >= 1 && zm.min.size() == zm.NClusters() * zm.branches.size() &&
+           zm.max.size() == zm.min.size();
+}
+
+// Whether `zm` still describes `source`:`tree`; a regenerated source with other entries would
+// otherwise prune the wrong clusters
+inline bool ZoneMapCurrent(const ZoneMap &zm, const std::string &source, const std::string &tree, std::string &why) {
+    if (zm.source != source) { why = "made from " + zm.source; return false; }
+    if (zm.clusterStart.back() != zm.entries) { why = "cluster ranges do not cover its entries"; return false; }
+    const int64_t entries = TreeEntries(source, tree);
+    if (entries != zm.entries) {
+        why = "made for " + std::to_string(zm.entries) + " entries, the tree has " + std::to_string(entries);
+        return false;
+    }
+    return true;
+}
+
+// Branches worth mapping: those compared to a number in the most atoms over all bins
+inline std::vector<std::string> ZoneMapCandidates(const std::vector<std::vector<std::string>> &binAtoms,
+                                                  const std::set<std::string> &scalarBranches, size_t maxBranches) {
+    static const std::regex re(R"(^\s*([A-Za-z_]\w*)\s*(>=|<=|==|>|<)\s*[-+.\d])");
+    std::map<std::string, size_t> uses;
+    std::smatch m;
+    for (const auto &atoms : binAtoms)
+        for (const auto &a : atoms)
+            if (std::regex_search(a, m, re) && scalarBranches.count(m[1].str())) ++uses[m[1].str()];
+    std::vector<std::pair<size_t, std::string>> order;
+    for (const auto &u : uses) order.emplace_back(u.second, u.first);
+    std::stable_sort(order.begin(), order.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    std::vector<std::string> out;
+    for (size_t i = 0; i < order.size() && i < maxBranches; ++i) out.push_back(order[i].second);
+    return out;
+}
+
+// First entry of every cluster of `tree`, then its number of entries
+inline std::vector<long long> ClusterStarts(TTree *tree) {
+    std::vector<long long> starts;
+    const long long n = tree->GetEntries();
+    auto it = tree->GetClusterIterator(0);
+    long long start;
+    while ((start = it()) < n) starts.push_back(start);
+    starts.push_back(n);
+    return starts;
+}
+
+// RDF action over the branch values: per-slot min/max for every cluster, merged in Finalize(). The
+// cluster comes from the tree entry the task's reader loaded, rdfentry_ is not that entry under MT.
+class ZoneMapHelper : public ROOT::Detail::RDF::RActionImpl<ZoneMapHelper> {
+public:
+    using Result_t = ZoneMap;
+
+    ZoneMapHelper(const ZoneMap &layout, unsigned int nSlots)
+        : nb_(layout.branches.size()), starts_(layout.clusterStart), result_(std::make_shared<Result_t>(layout)) {
+        const size_t n = layout.NClusters() * nb_;
+        min_.assign(nSlots, std::vector<double>(n, std::numeric_limits<double>::infinity()));
+        max_.assign(nSlots, std::vector<double>(n, -std::numeric_limits<double>::infinity()));
+        readers_.assign(nSlots, nullptr);
+    }
+    ZoneMapHelper(ZoneMapHelper &&) = default;
+    ZoneMapHelper(const ZoneMapHelper &) = delete;
+
+    std::shared_ptr<Result_t> GetResultPtr() const { return result_; }
+    void Initialize() {}
+    void InitTask(TTreeReader *r, unsigned int slot) { readers_[slot] = r; }
+
+    void Exec(unsigned int slot, const ROOT::RVec<double> &x) {
+        const long long entry = readers_[slot]->GetTree()->GetReadEntry();
+        const size_t c = std::upper_bound(starts_.begin(), starts_.end(), entry) - starts_.begin() - 1;
+        double *lo = &min_[slot][c * nb_], *hi = &max_[slot][c * nb_];
+        for (size_t b = 0; b < nb_; ++b) {
+            if (std::isnan(x[b])) continue;
+            lo[b] = std::min(lo[b], x[b]);
+            hi[b] = std::max(hi[b], x[b]);
+        }
+    }
+
+    void Finalize() {
+        result_->min.assign(min_.empty() ? 0 : min_[0].size(), std::numeric_limits<double>::infinity());
+        result_->max.assign(result_->min.size(), -std::numeric_limits<double>::infinity());
+        for (size_t s = 0; s < min_.size(); ++s)
+            for (size_t i = 0; i < result_->min.size(); ++i) {
+                result_->min[i] = std::min(result_->min[i], min_[s][i]);
+                result_->max[i] = std::max(result_->max[i], max_[s][i]);
+            }
+    }
+
+    std::string GetActionName() { return "ZoneMap"; }
+
+private:
+    size_t nb_;
+    std::vector<long long> starts_;
+    std::vector<std::vector<double>> min_, max_;
+    std::vector<TTreeReader*> readers_;
+    std::shared_ptr<Result_t> result_;
+};
+
+// `file`:`tree` restricted to the kept clusters, entered one run of adjacent kept clusters at a time
+struct ZonePrunedTree : EntryListTree {
+    ZonePrunedTree(const ZoneMap &zm, const std::vector<char> &keep, const std::string &tree, const std::string &file)
+        : EntryListTree(tree, file, [&](auto range) {
+              for (size_t c = 0; c < keep.size();) {
+                  if (!keep[c]) { ++c; continue; }
+                  const size_t first = c;
+                  while (c < keep.size() && keep[c]) ++c;
+                  range(zm.clusterStart[first], zm.clusterStart[c]);
+              }
+          }) {}
+};
+
+#endif
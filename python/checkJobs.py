@@ -40,7 +40,9 @@ def check_job_ok(base_dir: str, job: str, check_json: bool, check_root: bool) ->
     json_path, root_path, out_path, err_path = job_paths(base_dir, job)
 
     # Use non-zero-size checks to avoid counting partial/empty files as success
-    json_ok = _file_nonzero(json_path) if check_json else True
+    # jobs run with --yield-format binary write <job>.byf instead of <job>.json
+    byf_path = os.path.splitext(json_path)[0] + ".byf"
+    json_ok = (_file_nonzero(json_path) or _file_nonzero(byf_path)) if check_json else True
     root_ok = _file_nonzero(root_path) if check_root else True
 
     # require whichever flags were set
@@ -200,7 +202,7 @@ def main():
         print("[checkJobs] Warning: could not extract LogFile->Args mapping from original submit; "
               "falling back to filesystem enumeration.", file=sys.stderr)
         names = set()
-        for d, ext in ((json_dir, ".json"), (out_dir, ".out"), (err_dir, ".err")):
+        for d, ext in ((json_dir, ".json"), (json_dir, ".byf"), (out_dir, ".out"), (err_dir, ".err")):
             if os.path.isdir(d):
                 for fn in os.listdir(d):
                     if fn.endswith(ext):
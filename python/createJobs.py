@@ -46,11 +46,9 @@ def write_hadd_script(bin_name, condor_dir="condor", root_dir="root"):
     os.makedirs(os.path.dirname(hadd_script_path), exist_ok=True)
     with open(hadd_script_path, "w") as f:
         f.write("#!/usr/bin/env bash\n")
-        f.write("# Auto-generated per-bin hadd script\n")
-        f.write(f"hadd -f {condor_dir}/{bin_name}/{bin_name}.root "
-                f"{condor_dir}/{bin_name}/{root_dir}/*.root > /dev/null 2>&1 || "
-                f"hadd -f {condor_dir}/{bin_name}/{bin_name}.root "
-                f"{condor_dir}/{bin_name}/{root_dir}/*.root\n")
+        f.write("# Auto-generated per-bin hadd script (mergeHists.x reads the directory, no glob)\n")
+        f.write(f"./mergeHists.x -o {condor_dir}/{bin_name}/{bin_name}.root "
+                f"{condor_dir}/{bin_name}/{root_dir}\n")
     os.chmod(hadd_script_path, 0o755)
     print(f"[createJobs] Generated hadd script: {hadd_script_path}")
 
@@ -143,9 +141,21 @@ def build_jobs(tool, bin_name, cuts, lep_cuts, predef_cuts, user_cuts, sms_filte
 # ----------------------------------------
 # Condor submit file writing
 # ----------------------------------------
-def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json=True, make_root=True, dryrun=False):
+def is_inside(path, directory):
+    # Path.is_relative_to needs Python 3.9
+    try:
+        path.resolve().relative_to(directory.resolve())
+        return True
+    except ValueError:
+        return False
+
+def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json=True, make_root=True, dryrun=False, bins_yaml=None, cut_cache=None, signal_index=None, yield_format="json", bitmask=False, adaptive_order=0, zone_maps=None, save_entry_lists=False, entry_lists=None, skim_dir=None, nminus1=False):
     bin_safe = sanitize(bin_name)
     bin_dir = CONDOR_DIR / bin_safe
+    # the work dir is recreated below, so entry lists of an earlier run must live elsewhere
+    if entry_lists and is_inside(Path(entry_lists), bin_dir):
+        print(f"[createJobs] ERROR: --entry-lists {entry_lists} is inside {bin_dir}, which is recreated; copy it out first")
+        return
     if bin_dir.exists():
         print("[createJobs] Removing existing condor dir:", bin_dir.name)
         shutil.rmtree(bin_dir)
@@ -163,7 +173,8 @@ def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json
     err_dir = bin_dir / "err"
     json_dir = bin_dir / "json"
     root_dir = bin_dir / "root"
-    for d in (log_dir, out_dir, err_dir, json_dir, root_dir):
+    bel_dir = bin_dir / "bel"
+    for d in (log_dir, out_dir, err_dir, json_dir, root_dir, bel_dir):
         d.mkdir(parents=True, exist_ok=True)
 
     submit_path = bin_dir / f"{bin_safe}.sub"
@@ -179,6 +190,16 @@ def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json
 
     # Build per-job inputs collection (global)
     all_inputs = set([str(bin_dir / "BFI_condor.x")])
+    # Single-pass mode: every bin of the YAML is evaluated by each job
+    if bins_yaml:
+        all_inputs.add(bins_yaml)
+    # Compiled expression cache, shipped as a directory and only read by the jobs
+    if cut_cache:
+        all_inputs.add(cut_cache.rstrip("/"))
+    # Signal metadata index, so jobs never open signal files just for their mass tokens
+    if signal_index:
+        all_inputs.add(signal_index)
+        submit_lines.append(f'environment = "BFI_SIGNAL_INDEX={os.path.basename(signal_index)}"')
     all_remaps = []
 
     # helper: flatten multi-line YAML literal blocks into a single-line string
@@ -201,10 +222,15 @@ def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json
     # Add per-job outputs (use $(LogFile) placeholders) once, globally,
     # so condor knows each job will produce these outputs.
     per_job_outputs = []
+    # yield files per job: .json and/or .byf (binary yields)
+    yield_exts = {"json": ["json"], "binary": ["byf"], "both": ["json", "byf"]}[yield_format]
     if make_json:
-        per_job_outputs.append("$(LogFile).json")
+        per_job_outputs.extend(f"$(LogFile).{ext}" for ext in yield_exts)
     if make_root:
         per_job_outputs.append("$(LogFile).root")
+    # entry lists sidecar per job, input of a later --entry-lists run
+    if save_entry_lists:
+        per_job_outputs.append("$(LogFile).bel")
 
     if per_job_outputs:
         submit_lines.append("transfer_output_files = " + ", ".join(per_job_outputs))
@@ -212,9 +238,12 @@ def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json
         # Remap these per-job outputs into the desired subdirectories
         remap_entries = []
         if make_json:
-            remap_entries.append(f"$(LogFile).json = {json_dir.as_posix()}/$(LogFile).json")
+            for ext in yield_exts:
+                remap_entries.append(f"$(LogFile).{ext} = {json_dir.as_posix()}/$(LogFile).{ext}")
         if make_root:
             remap_entries.append(f"$(LogFile).root = {root_dir.as_posix()}/$(LogFile).root")
+        if save_entry_lists:
+            remap_entries.append(f"$(LogFile).bel = {bel_dir.as_posix()}/$(LogFile).bel")
 
         # Single transfer_output_remaps line (avoid f-string brace pitfalls)
         submit_lines.append('transfer_output_remaps = "' + "; ".join(remap_entries) + '"')
@@ -237,6 +266,10 @@ def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json
             local_json = f"{base}.json"
             outputs.append("--json")
             outputs.append(f"--json-output {local_json}")
+            if yield_format != "json":
+                outputs.append(f"--yield-format {yield_format}")
+            if bitmask:
+                outputs.append("--bitmask")
             job["remap_outputs"] = job.get("remap_outputs", [])
             job["remap_outputs"].append(f"{local_json} = json/{local_json}")
 
@@ -269,20 +302,54 @@ def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json
 
         args_list = [
             f"--lumi {lumi}",
-            f"--bin {bin_name}",
             f"--file {fpath}",
             *outputs,
         ]
-        # Add the (now single-line) fields only if they're non-empty
-        if cuts_flat:
-            args_list.append(f"--cuts {cuts_flat}")
-        if lep_cuts_flat:
-            args_list.append(f"--lep-cuts {lep_cuts_flat}")
-        if predef_flat:
-            args_list.append(f"--predefined-cuts {predef_flat}")
-        if user_flat:
-            args_list.append(f"--user-cuts {user_flat}")
-
+        if bins_yaml:
+            args_list.append(f"--bins-yaml {os.path.basename(bins_yaml)}")
+        else:
+            args_list.insert(1, f"--bin {bin_name}")
+        # Add the (now single-line) fields only if they're non-empty (cuts come from the YAML in single-pass mode)
+        if not bins_yaml:
+            if cuts_flat:
+                args_list.append(f"--cuts {cuts_flat}")
+            if lep_cuts_flat:
+                args_list.append(f"--lep-cuts {lep_cuts_flat}")
+            if predef_flat:
+                args_list.append(f"--predefined-cuts {predef_flat}")
+            if user_flat:
+                args_list.append(f"--user-cuts {user_flat}")
+
+        if cut_cache:
+            args_list.append(f"--cut-cache {os.path.basename(cut_cache.rstrip('/'))}")
+        if adaptive_order:
+            args_list.append(f"--adaptive-order {adaptive_order}")
+        if nminus1:
+            args_list.append("--nminus1")
+        # Skim, zone map and entry lists are per input file: each job is shipped its own (job_inputs)
+        if skim_dir:
+            skim = Path(skim_dir) / f"{Path(fpath).stem}.root"
+            if skim.is_file():
+                job.setdefault("job_inputs", []).append(str(skim))
+                args_list.append("--skim-dir .")
+            else:
+                print(f"[createJobs] No skim {skim}; job {base} reads the source")
+        if zone_maps:
+            zone_map = Path(zone_maps) / f"{Path(fpath).stem}.zonemap.json"
+            if zone_map.is_file():
+                job.setdefault("job_inputs", []).append(str(zone_map))
+                args_list.append("--zone-maps .")
+            else:
+                print(f"[createJobs] No zone map {zone_map}; job {base} reads every cluster")
+        if save_entry_lists:
+            args_list.append(f"--save-entry-lists {base}.bel")
+        if entry_lists:
+            entry_list = Path(entry_lists) / f"{base}.bel"
+            if entry_list.is_file():
+                job.setdefault("job_inputs", []).append(str(entry_list))
+                args_list.append(f"--entry-lists {entry_list.name}")
+            else:
+                print(f"[createJobs] No entry lists {entry_list}; job {base} reads every entry")
         if sig_type:
             args_list.append(f"--sig-type {sig_type}")
         if sms_filters:
@@ -294,18 +361,23 @@ def write_submit_file(bin_name, jobs, cpus="1", memory="1 GB", lumi=1, make_json
         job["args_str"] = args_str
         job["base"] = base
 
-    # Write transfer_input_files (global)
-    submit_lines.append("transfer_input_files = " + ", ".join(sorted(all_inputs)))
-
-    # Queue jobs
-    submit_lines.append("# Queue jobs with LogFile (used for log/out/err) and Args")
-    submit_lines.append("queue LogFile, Args from (")
-
-    for job in jobs:
-        # job["args_str"] is guaranteed to be a single line now
+    # Queue jobs: those with inputs of their own get their own transfer_input_files and queue
+    shared_jobs = [job for job in jobs if not job.get("job_inputs")]
+    own_jobs = [job for job in jobs if job.get("job_inputs")]
+    if shared_jobs:
+        # Write transfer_input_files (global)
+        submit_lines.append("transfer_input_files = " + ", ".join(sorted(all_inputs)))
+        submit_lines.append("# Queue jobs with LogFile (used for log/out/err) and Args")
+        submit_lines.append("queue LogFile, Args from (")
+        for job in shared_jobs:
+            # job["args_str"] is guaranteed to be a single line now
+            submit_lines.append(f'{job["base"]} "{job["args_str"]}"')
+        submit_lines.append(")")
+    for job in own_jobs:
+        submit_lines.append("transfer_input_files = " + ", ".join(sorted(all_inputs | set(job["job_inputs"]))))
+        submit_lines.append("queue LogFile, Args from (")
         submit_lines.append(f'{job["base"]} "{job["args_str"]}"')
-
-    submit_lines.append(")")
+        submit_lines.append(")")
 
     # Write file
     submit_content = "\n".join(submit_lines) + "\n"
@@ -377,9 +449,37 @@ def main():
                         help="Enable ROOT/histogram output")
     parser.add_argument("--hist-yaml", default="",
                         help="Path to histogram YAML config (used if --make-root)")
+    parser.add_argument("--bins-yaml", default="",
+                        help="Bins YAML evaluated in a single pass per file (--bin is then only the work-dir label)")
+    parser.add_argument("--cut-cache", default="",
+                        help="Directory of compiled cut expressions (fill once with BFI_condor.x --cut-cache DIR --cut-cache-build)")
+    parser.add_argument("--signal-index", default="",
+                        help="Signal metadata index from buildSignalIndex.x (default: signal_index.tsv if present)")
+    parser.add_argument("--yield-format", default="json", choices=["json", "binary", "both"],
+                        help="Per-job yield files: JSON, binary .byf (smaller, mmap-read by the mergers and BF.x) or both")
+    parser.add_argument("--bitmask", action="store_true",
+                        help="JSON yields of all --bins-yaml bins from one bitset of their distinct cuts per event")
+    parser.add_argument("--adaptive-order", type=int, default=0, metavar="N",
+                        help="Order each bin's filters by cost and pass rate measured on the first N events of each file")
+    parser.add_argument("--zone-maps", default="",
+                        help="BFI_skim.x output directory: each job gets the zone map of its file (<stem>.zonemap.json) and skips the clusters no bin can pass")
+    parser.add_argument("--skim-dir", default="",
+                        help="BFI_skim.x output directory: each job gets the skim of its file (<stem>.root) and reads it while its provenance matches")
+    parser.add_argument("--nminus1", action="store_true",
+                        help="Also write bin__proc__NMinus1 (yield with each cut removed) next to the CutFlow")
+    parser.add_argument("--save-entry-lists", action="store_true",
+                        help="Each job writes the entries passing every bin to condor/<bin>/bel/<job>.bel")
+    parser.add_argument("--entry-lists", default="",
+                        help="Directory of an earlier --save-entry-lists run (copied out of condor/<bin>); jobs only read those entries")
     parser.add_argument("--dryrun", "--dry-run", action="store_true")
     args = parser.parse_args()
 
+    if not args.signal_index and os.path.isfile("signal_index.tsv"):
+        args.signal_index = "signal_index.tsv"
+    if args.signal_index:
+        # read by BFTool before the first signal file is opened
+        os.environ["BFI_SIGNAL_INDEX"] = os.path.abspath(args.signal_index)
+
     tool = pySampleTool.SampleTool()
 
     # Load processes
@@ -417,7 +517,18 @@ def main():
         lumi=args.lumi,
         make_json=args.make_json,
         make_root=args.make_root,
-        dryrun=args.dryrun
+        dryrun=args.dryrun,
+        bins_yaml=args.bins_yaml or None,
+        cut_cache=args.cut_cache or None,
+        signal_index=args.signal_index or None,
+        yield_format=args.yield_format,
+        bitmask=args.bitmask,
+        adaptive_order=args.adaptive_order,
+        zone_maps=args.zone_maps or None,
+        save_entry_lists=args.save_entry_lists,
+        entry_lists=args.entry_lists or None,
+        skim_dir=args.skim_dir or None,
+        nminus1=args.nminus1
     )
 
 if __name__ == "__main__":
@@ -30,7 +30,7 @@ def write_flatten_script(bin_names, flatten_exe="./flattenJSONs.x", json_dir="js
     print(f"[createMergers] Generated flatten script: {script_path}")
     return script_path
 
-def write_master_hadd_script(bin_names, condor_dir="condor", master_root_dir="root"):
+def write_master_hadd_script(bin_names, condor_dir="condor", master_root_dir="root", incremental=False):
     os.makedirs(condor_dir, exist_ok=True)
     os.makedirs(master_root_dir, exist_ok=True)
     joined = join_bins(bin_names)
@@ -42,10 +42,13 @@ def write_master_hadd_script(bin_names, condor_dir="condor", master_root_dir="ro
         f.write("#!/usr/bin/env bash\n")
         f.write("# Auto-generated master hadd script\n\n")
 
-        # Call per-bin hadd scripts first
-        for bin_name in bin_names:
-            hadd_script = os.path.join(condor_dir, bin_name, "haddROOTs.sh")
-            f.write(f"bash {hadd_script}\n")
+        # Call per-bin hadd scripts first (per-bin ROOTs come from mergeDaemon.x when incremental)
+        if incremental:
+            f.write(f"{daemon_call(bin_names, condor_dir)}\n")
+        else:
+            for bin_name in bin_names:
+                hadd_script = os.path.join(condor_dir, bin_name, "haddROOTs.sh")
+                f.write(f"bash {hadd_script}\n")
 
         # Collect per-bin ROOT outputs
         per_bin_roots = [os.path.join(condor_dir, bin_name, f"{bin_name}.root") for bin_name in bin_names]
@@ -56,7 +59,7 @@ def write_master_hadd_script(bin_names, condor_dir="condor", master_root_dir="ro
 
         # Merge if at least one ROOT exists
         f.write("if [ ${#existing_roots[@]} -gt 0 ]; then\n")
-        f.write(f"  hadd -f {final_root} ${{existing_roots[@]}}\n")
+        f.write(f"  ./mergeHists.x --totals -o {final_root} \"${{existing_roots[@]}}\"\n")
         f.write(f"  echo 'Final hadded ROOT -> {final_root}'\n")
         f.write("else\n")
         f.write("  echo 'No per-bin ROOT files found to hadd.'\n")
@@ -66,6 +69,14 @@ def write_master_hadd_script(bin_names, condor_dir="condor", master_root_dir="ro
     print(f"[createMergers] Generated master hadd script: {master_script_path}")
     return master_script_path
 
+def daemon_call(bin_names, condor_dir="condor", daemon_exe="./mergeDaemon.x"):
+    """
+    Final mergeDaemon.x pass over the per-bin dirs: folds the outputs it has not merged yet
+    into condor/<bin>/<bin>.json and condor/<bin>/<bin>.root
+    """
+    bin_dirs = [os.path.join(condor_dir, bin_name) for bin_name in bin_names]
+    return f"{daemon_exe} --once {' '.join(bin_dirs)}"
+
 def setup_master_merge_script(
     bin_names,
     flatten_sh=None,
@@ -74,12 +85,13 @@ def setup_master_merge_script(
     root_dir="root",
     do_json=False,
     do_hadd=False,
-    condor_dir="condor"
+    condor_dir="condor",
+    incremental=False
 ):
     """
     Create master_merge_<joined_bins>.sh to run all mergers (JSON flattening + ROOT hadd).
     flatten_sh and hadd_sh should be script filenames (not full paths) living in condor_dir,
-    or None if not present.
+    or None if not present. With incremental, one mergeDaemon.x pass replaces the per-bin mergers.
     """
     os.makedirs(condor_dir, exist_ok=True)
     joined = join_bins(bin_names)
@@ -90,12 +102,17 @@ def setup_master_merge_script(
         f.write("#!/usr/bin/env bash\n")
         f.write("# Auto-generated master merge script\n\n")
 
+        # --- per-bin merging done incrementally ---
+        if incremental and (do_json or do_hadd):
+            f.write(f"{daemon_call(bin_names, condor_dir)}\n")
+
         # --- JSON merging ---
         if do_json:
             os.makedirs(json_dir, exist_ok=True)
-            for bin_name in bin_names:
-                merge_script = os.path.join(condor_dir, bin_name, "mergeJSONs.sh")
-                f.write(f"bash {merge_script}\n")
+            if not incremental:
+                for bin_name in bin_names:
+                    merge_script = os.path.join(condor_dir, bin_name, "mergeJSONs.sh")
+                    f.write(f"bash {merge_script}\n")
             if flatten_sh:
                 f.write(f"bash {os.path.join(condor_dir, flatten_sh)}\n")
             else:
@@ -106,9 +123,10 @@ def setup_master_merge_script(
         if do_hadd:
             os.makedirs(root_dir, exist_ok=True)
             # Call per-bin hadd scripts
-            for bin_name in bin_names:
-                hadd_script = os.path.join(condor_dir, bin_name, "haddROOTs.sh")
-                f.write(f"bash {hadd_script}\n")
+            if not incremental:
+                for bin_name in bin_names:
+                    hadd_script = os.path.join(condor_dir, bin_name, "haddROOTs.sh")
+                    f.write(f"bash {hadd_script}\n")
             # Call master hadd script
             if hadd_sh:
                 f.write(f"bash {os.path.join(condor_dir, hadd_sh)}\n")
@@ -145,6 +163,7 @@ def main():
     parser.add_argument("--do-json", action="store_true", help="Generate JSON merging (mergeJSONs + flatten script)")
     parser.add_argument("--do-hadd", action="store_true", help="Generate ROOT hadd scripts")
     parser.add_argument("--make-master", action="store_true", help="Also create master_merge script that calls everything")
+    parser.add_argument("--incremental", action="store_true", help="Per-bin merging by mergeDaemon.x (final pass) instead of mergeJSONs.sh / haddROOTs.sh")
     args = parser.parse_args()
 
     # Gather bin names
@@ -185,7 +204,7 @@ def main():
         flatten_path = write_flatten_script(bin_names, flatten_exe=args.flatten_exe, json_dir=args.json_dir, condor_dir=args.condor_dir)
 
     if args.do_hadd:
-        hadd_path = write_master_hadd_script(bin_names, condor_dir=args.condor_dir, master_root_dir=args.root_dir)
+        hadd_path = write_master_hadd_script(bin_names, condor_dir=args.condor_dir, master_root_dir=args.root_dir, incremental=args.incremental)
 
     # If user wants master, create it and ensure we pass the correct script basenames
     if args.make_master:
@@ -200,7 +219,8 @@ def main():
             root_dir=args.root_dir,
             do_json=args.do_json,
             do_hadd=args.do_hadd,
-            condor_dir=args.condor_dir
+            condor_dir=args.condor_dir,
+            incremental=args.incremental
         )
 
     print(f"[createMergers] Done. Generated scripts located under: {args.condor_dir}/")
@@ -73,7 +73,7 @@ def submit_jobs(config, processes, hist, make_json=False, make_root=False, lumi=
             cmd.append(hist)
     subprocess.run(cmd, check=True, stdout=sys.stdout, stderr=sys.stderr)
 
-def create_mergers(config, make_json=False, make_root=False):
+def create_mergers(config, make_json=False, make_root=False, incremental=False):
     """
     Runs createMergers.py to generate merger scripts.
     """
@@ -83,8 +83,34 @@ def create_mergers(config, make_json=False, make_root=False):
         cmd.append("--do-json")
     if make_root:
         cmd.append("--do-hadd")
+    if incremental:
+        cmd.append("--incremental")
     subprocess.run(cmd, check=True, stdout=sys.stdout, stderr=sys.stderr)
 
+def start_merge_daemon(work_dirs, interval=60):
+    """
+    Starts mergeDaemon.x in the background on condor/<bin> for every bin, folding job
+    outputs into the per-bin totals while jobs run. Stop it with stop_merge_daemon().
+    """
+    bin_dirs = [os.path.join("condor", d) for d in work_dirs]
+    cmd = ["./mergeDaemon.x", "--interval", str(interval)] + bin_dirs
+    print("[run_all] Starting incremental merger:", " ".join(cmd), flush=True)
+    return subprocess.Popen(cmd, stdout=sys.stdout, stderr=sys.stderr)
+
+def stop_merge_daemon(proc):
+    """
+    SIGTERM lets mergeDaemon.x finish its current pass and checkpoint before exiting.
+    """
+    if proc is None or proc.poll() is not None:
+        return
+    proc.terminate()
+    try:
+        proc.wait(timeout=600)
+    except subprocess.TimeoutExpired:
+        print("[run_all] mergeDaemon.x did not stop; killing it (its last checkpoint is kept)", file=sys.stderr, flush=True)
+        proc.kill()
+        proc.wait()
+
 def get_flattened_json_path(condor_dir="condor", json_dir="json"):
     """
     Return the path to the flattened JSON produced by the merge scripts.
@@ -301,6 +327,10 @@ def parse_args():
                    help="Generate ROOT outputs")
     p.add_argument("--lumi", dest="lumi", type=str, default="400.0",
                    help="Lumi to scale everything to (default is 400.0)")
+    p.add_argument("--incremental-merge", action="store_true",
+                   help="Merge job outputs with mergeDaemon.x while jobs run; the final merge only folds the rest")
+    p.add_argument("--fast-significance", action="store_true",
+                   help="Compute expected significances with FastSignificance.x instead of BF.x + combine")
     return p.parse_args()
 
 def main():
@@ -329,16 +359,20 @@ def main():
 
     # 3) Create merge scripts
     print("[run_all] Creating merger scripts...", flush=True)
-    create_mergers(config=bins_cfg, make_json=args.make_json, make_root=args.make_root)
+    create_mergers(config=bins_cfg, make_json=args.make_json, make_root=args.make_root, incremental=args.incremental_merge)
 
     condor_time_start = time.time()
-    # 4) Wait for jobs to finish
-    print("[run_all] Waiting for condor jobs to finish...", flush=True)
-    idle_time_seconds = wait_for_jobs(work_dirs=load_bins(args.bins_cfg))
-
-    # 5) Run checkJobs.py loop to find/resubmit failed jobs (if any)
-    print("[run_all] Checking for failed jobs and resubmitting if necessary...", flush=True)
-    ok = run_checkjobs_loop_parallel(work_dirs=load_bins(args.bins_cfg), no_resubmit=False, max_resubmits=args.max_resubmits, check_json=args.make_json, check_root=args.make_root)
+    merge_daemon = start_merge_daemon(load_bins(args.bins_cfg)) if args.incremental_merge else None
+    try:
+        # 4) Wait for jobs to finish
+        print("[run_all] Waiting for condor jobs to finish...", flush=True)
+        idle_time_seconds = wait_for_jobs(work_dirs=load_bins(args.bins_cfg))
+
+        # 5) Run checkJobs.py loop to find/resubmit failed jobs (if any)
+        print("[run_all] Checking for failed jobs and resubmitting if necessary...", flush=True)
+        ok = run_checkjobs_loop_parallel(work_dirs=load_bins(args.bins_cfg), no_resubmit=False, max_resubmits=args.max_resubmits, check_json=args.make_json, check_root=args.make_root)
+    finally:
+        stop_merge_daemon(merge_daemon)
     if not ok:
         print(f"[run_all] checkJobs step did not complete successfully. Aborting further steps.", file=sys.stderr)
         sys.exit(1)
@@ -375,20 +409,28 @@ def main():
         # 8) Run BF.x on the flattened JSON
         flattened_json = get_flattened_json_path(condor_dir="condor", json_dir="json")
         output_dir = get_output_dir(flattened_json=flattened_json)
-        print(f"[run_all] Running BF.x with input {flattened_json} & output {output_dir}", flush=True)
-        subprocess.run(["./BF.x", flattened_json, output_dir], check=True, stdout=sys.stdout, stderr=sys.stderr)
-
-        # 9) Run combine
-        print("[run_all] Launching combine jobs...", flush=True)
-        subprocess.run(["bash", "macro/launchCombine.sh", output_dir], check=True, stdout=sys.stdout, stderr=sys.stderr)
-
-        # 10) Print yields
-        print(f"[run_all] Yields for {args.bins_cfg}")
-        print_events(flattened_json)
-
-        # 11) Collect significances
-        print("[run_all] Collecting significances...", flush=True)
-        subprocess.run(["python3", "-u", "macro/CollectSignificance.py", output_dir], check=True, stdout=sys.stdout, stderr=sys.stderr)
+        if args.fast_significance:
+            # 9-11) Asymptotic expected significances straight from the yields, no datacards
+            sig_file = os.path.join("output", f"Significance_{os.path.basename(output_dir)}.txt")
+            print(f"[run_all] Running FastSignificance.x with input {flattened_json} & output {sig_file}", flush=True)
+            subprocess.run(["./FastSignificance.x", "-o", sig_file, flattened_json], check=True, stdout=sys.stdout, stderr=sys.stderr)
+            print(f"[run_all] Yields for {args.bins_cfg}")
+            print_events(flattened_json)
+        else:
+            print(f"[run_all] Running BF.x with input {flattened_json} & output {output_dir}", flush=True)
+            subprocess.run(["./BF.x", flattened_json, output_dir], check=True, stdout=sys.stdout, stderr=sys.stderr)
+
+            # 9) Run combine
+            print("[run_all] Launching combine jobs...", flush=True)
+            subprocess.run(["bash", "macro/launchCombine.sh", output_dir], check=True, stdout=sys.stdout, stderr=sys.stderr)
+
+            # 10) Print yields
+            print(f"[run_all] Yields for {args.bins_cfg}")
+            print_events(flattened_json)
+
+            # 11) Collect significances
+            print("[run_all] Collecting significances...", flush=True)
+            subprocess.run(["python3", "-u", "macro/CollectSignificance.py", output_dir], check=True, stdout=sys.stdout, stderr=sys.stderr)
 
         # 12) Plot significances
         plot_cmd = [
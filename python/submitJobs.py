@@ -33,20 +33,25 @@ def load_processes(cfg_path):
     sms_filters = cfg.get("sms_filters", [])
     return bkg, sig, sms_filters
 
-def build_command(bin_name, cfg, bkg_processes, sig_processes, sms_filters, make_json, make_root, hist_yaml, lumi):
+def build_command(bin_name, cfg, bkg_processes, sig_processes, sms_filters, make_json, make_root, hist_yaml, lumi, bins_yaml=None):
     cmd = [
         "python3", "python/createJobs.py",
         "--bkg_processes", *bkg_processes,
         "--sig_processes", *sig_processes,
         "--bin", bin_name,
-        "--cuts", cfg.get("cuts","").replace('\n',''),
-        "--lep-cuts", cfg.get("lep-cuts","").replace('\n',''),
-        "--predefined-cuts", cfg.get("predefined-cuts","").replace('\n',''),
-        "--user-cuts", cfg.get("user-cuts","").replace('\n',''),
         "--cpus", cpus,
         "--memory", memory,
         "--lumi", lumi
     ]
+    if bins_yaml:
+        cmd += ["--bins-yaml", bins_yaml]
+    else:
+        cmd += [
+            "--cuts", cfg.get("cuts","").replace('\n',''),
+            "--lep-cuts", cfg.get("lep-cuts","").replace('\n',''),
+            "--predefined-cuts", cfg.get("predefined-cuts","").replace('\n',''),
+            "--user-cuts", cfg.get("user-cuts","").replace('\n',''),
+        ]
     if sms_filters:
         cmd += ["--sms-filters", *sms_filters]
     if dryrun:
@@ -82,6 +87,8 @@ def main():
     parser.add_argument("--make-json", action="store_true", help="Pass --make-json to createJobs.py")
     parser.add_argument("--make-root", action="store_true", help="Pass --make-root to createJobs.py")
     parser.add_argument("--hist-yaml", type=str, default=None, help="YAML file for histogram configuration")
+    parser.add_argument("--single-pass", action="store_true",
+                        help="Submit one job per file that evaluates every bin of --bins-cfg in a single pass")
     args = parser.parse_args()
 
     # Default behavior: make JSON if neither specified
@@ -115,11 +122,19 @@ def main():
     jobs = []
     print("\n===== BEGIN BIN DEFINITIONS =====\n")
     for bin_name, cfg in bins.items():
-        cmd = build_command(bin_name, cfg, bkg_processes, sig_processes, sms_filters, make_json, make_root, args.hist_yaml, lumi)
-        jobs.append(cmd)
+        if not args.single_pass:
+            cmd = build_command(bin_name, cfg, bkg_processes, sig_processes, sms_filters, make_json, make_root, args.hist_yaml, lumi)
+            jobs.append(cmd)
         print(f"[BIN-DEF] bin={bin_name} cuts={cfg.get('cuts')} lep-cuts={cfg.get('lep-cuts')} predefined-cuts={cfg.get('predefined-cuts')} user-cuts={cfg.get('user-cuts')}")
     print("===== END BIN DEFINITIONS =====\n")
 
+    # Single-pass: one work dir (named after the YAML) holding every bin's outputs
+    if args.single_pass and bins:
+        label = "SP_" + re.sub(r"[^A-Za-z0-9_]", "_", bins_cfg_path.stem)
+        jobs.append(build_command(label, {}, bkg_processes, sig_processes, sms_filters, make_json, make_root, args.hist_yaml, lumi,
+                                  bins_yaml=str(bins_cfg_path)))
+        bins = {label: {}}
+
     if limit_submit is not None:
         jobs = jobs[:limit_submit]
 
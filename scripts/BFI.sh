@@ -21,6 +21,7 @@ chmod +x BFI_condor.x
 clean_arg() { echo "$1" | tr -d '\n' | tr -d '\r' | xargs; }
 
 BIN=""
+BINS_YAML=""
 ROOTFILE=""
 OUTPUT_JSON=""
 OUTPUT_HIST=""
@@ -34,22 +35,43 @@ LUMI=""
 SMS_FILTERS=""
 JSON_FLAG=""
 HIST_FLAG=""
+ALL_COLUMNS_FLAG=""
+BITMASK_FLAG=""
+CUT_CACHE=""
+YIELD_FORMAT=""
+ADAPTIVE_ORDER=""
+ZONE_MAPS=""
+SAVE_ENTRY_LISTS=""
+SKIM_DIR=""
+NMINUS1_FLAG=""
+ENTRY_LISTS=""
 
 # --- Parse arguments ---
 while [[ $# -gt 0 ]]; do
     key="$1"
     case $key in
         --bin) BIN=$(clean_arg "$2"); shift 2;;
+        --bins-yaml) BINS_YAML=$(clean_arg "$2"); shift 2;;
         --file) ROOTFILE=$(clean_arg "$2"); shift 2;;
 
         # Standalone flags
         --json) JSON_FLAG="--json"; shift;;
         --hist) HIST_FLAG="--hist"; shift;;
+        --all-columns) ALL_COLUMNS_FLAG="--all-columns"; shift;;
+        --bitmask) BITMASK_FLAG="--bitmask"; shift;;
+        --nminus1) NMINUS1_FLAG="--nminus1"; shift;;
 
         # Output filenames
         --json-output) OUTPUT_JSON=$(clean_arg "$2"); shift 2;;
         --root-output) OUTPUT_HIST=$(clean_arg "$2"); shift 2;;
         --hist-yaml) HIST_YAML=$(clean_arg "$2"); shift 2;;
+        --cut-cache) CUT_CACHE=$(clean_arg "$2"); shift 2;;
+        --yield-format) YIELD_FORMAT=$(clean_arg "$2"); shift 2;;
+        --adaptive-order) ADAPTIVE_ORDER=$(clean_arg "$2"); shift 2;;
+        --zone-maps) ZONE_MAPS=$(clean_arg "$2"); shift 2;;
+        --save-entry-lists) SAVE_ENTRY_LISTS=$(clean_arg "$2"); shift 2;;
+        --entry-lists) ENTRY_LISTS=$(clean_arg "$2"); shift 2;;
+        --skim-dir) SKIM_DIR=$(clean_arg "$2"); shift 2;;
 
         # Cuts
         --cuts) CUTS=$(clean_arg "$2"); shift 2;;
@@ -89,9 +111,15 @@ fi
 OUTPUT_JSON=$(basename "$OUTPUT_JSON")
 OUTPUT_HIST=$(basename "$OUTPUT_HIST")
 [[ -n "$HIST_YAML" ]] && HIST_YAML=$(basename "$HIST_YAML")
+[[ -n "$BINS_YAML" ]] && BINS_YAML=$(basename "$BINS_YAML")
+[[ -n "$CUT_CACHE" ]] && CUT_CACHE=$(basename "$CUT_CACHE")
+[[ -n "$SAVE_ENTRY_LISTS" ]] && SAVE_ENTRY_LISTS=$(basename "$SAVE_ENTRY_LISTS")
+[[ -n "$ENTRY_LISTS" ]] && ENTRY_LISTS=$(basename "$ENTRY_LISTS")
 
 # --- Build command as a single quoted string ---
-CMD="./BFI_condor.x --bin \"$BIN\" --file \"$ROOTFILE\""
+CMD="./BFI_condor.x --file \"$ROOTFILE\""
+[[ -n "$BIN" ]] && CMD="$CMD --bin \"$BIN\""
+[[ -n "$BINS_YAML" ]] && CMD="$CMD --bins-yaml \"$BINS_YAML\""
 
 [[ -n "$JSON_FLAG" ]] && CMD="$CMD $JSON_FLAG"
 [[ -n "$OUTPUT_JSON" ]] && CMD="$CMD --json-output \"$OUTPUT_JSON\""
@@ -108,6 +136,16 @@ CMD="./BFI_condor.x --bin \"$BIN\" --file \"$ROOTFILE\""
 [[ -n "$SIG_TYPE" ]] && CMD="$CMD --sig-type \"$SIG_TYPE\""
 [[ -n "$LUMI" ]] && CMD="$CMD --lumi \"$LUMI\""
 [[ -n "$SMS_FILTERS" ]] && CMD="$CMD --sms-filters \"$SMS_FILTERS\""
+[[ -n "$ALL_COLUMNS_FLAG" ]] && CMD="$CMD $ALL_COLUMNS_FLAG"
+[[ -n "$BITMASK_FLAG" ]] && CMD="$CMD $BITMASK_FLAG"
+[[ -n "$CUT_CACHE" ]] && CMD="$CMD --cut-cache \"$CUT_CACHE\""
+[[ -n "$YIELD_FORMAT" ]] && CMD="$CMD --yield-format \"$YIELD_FORMAT\""
+[[ -n "$ADAPTIVE_ORDER" ]] && CMD="$CMD --adaptive-order \"$ADAPTIVE_ORDER\""
+[[ -n "$ZONE_MAPS" ]] && CMD="$CMD --zone-maps \"$ZONE_MAPS\""
+[[ -n "$SAVE_ENTRY_LISTS" ]] && CMD="$CMD --save-entry-lists \"$SAVE_ENTRY_LISTS\""
+[[ -n "$ENTRY_LISTS" ]] && CMD="$CMD --entry-lists \"$ENTRY_LISTS\""
+[[ -n "$SKIM_DIR" ]] && CMD="$CMD --skim-dir \"$SKIM_DIR\""
+[[ -n "$NMINUS1_FLAG" ]] && CMD="$CMD $NMINUS1_FLAG"
 
 # --- Echo and run ---
 echo "Running BFI_condor.x with command:"
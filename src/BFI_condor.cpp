@@ -4,20 +4,47 @@
 #include "TROOT.h"
 
 #include "BFICondorTools.h"
+#include "SkimTools.h"
+#include "CutFlowTools.h"
+#include "HistNaming.h"
+#include "FilterTrie.h"
+#include "BinMaskEngine.h"
+#include "PredicateProfile.h"
+#include "ZoneMap.h"
+#include "EntryBitmap.h"
 
 // ----------------------
 // Helpers
 // ----------------------
 
+// Everything booked for one bin on the shared per-tree graph; read back after the event loop
+struct BinBooking {
+    ROOT::RDF::RNode node;
+    const BinSpec* bin = nullptr;
+    std::vector<DerivedVar> validUserCuts;
+    std::vector<std::string> cutLabels;
+    int nCuts = 0;
+    int nSkimSteps = 0; // leading cutflow steps taken from the skim provenance
+    ROOT::RDF::RResultPtr<CutFlowResult> cutflow;
+    ROOT::RDF::RResultPtr<ULong64_t> count;
+    ROOT::RDF::RResultPtr<double> sumW, sumW2;
+    ROOT::RDF::RResultPtr<EntryBitmap> entries; // --save-entry-lists
+    std::unique_ptr<HistBatch> histBatch;
+};
+
 static void usage(const char* me) {
     std::cerr << "Usage: " << me
               << " --bin BINNAME --file ROOTFILE [--json-output OUT.json] "
                  "[--root-output OUT.root] [--cuts CUT1;CUT2;...] [--lep-cuts LEPCUT1;LEPCUT2;...] "
-                 "[--predefined-cuts NAME1;NAME2;...] [--user-cuts NAME1;NAME2;...] [--hist] [--hist-yaml HISTS.yaml] [--json]\n\n";
+                 "[--predefined-cuts NAME1;NAME2;...] [--user-cuts NAME1;NAME2;...] [--hist] [--hist-yaml HISTS.yaml] [--json]\n";
+    std::cerr << "       " << me
+              << " --bins-yaml BINS.yaml [--bin NAME1,NAME2,...] --file ROOTFILE [...]\n\n";
     std::cerr << "Required arguments:\n";
     std::cerr << "  --bin           Name of the bin to process (e.g. TEST)\n";
     std::cerr << "  --file          Path to one ROOT file to process\n\n";
     std::cerr << "Optional arguments:\n";
+    std::cerr << "  --bins-yaml        Bins YAML (config/bin_cfgs format); all bins are evaluated in one pass.\n"
+                 "                     With --bin only the listed bins are kept\n";
     std::cerr << "  --json-output      Path to write partial JSON output\n";
     std::cerr << "  --root-output      Path to write ROOT/histogram output\n";
     std::cerr << "  --cuts             Semicolon-separated list of normal tree cuts "
@@ -28,6 +55,22 @@ static void usage(const char* me) {
     std::cerr << "  --hist             Fill histograms\n";
     std::cerr << "  --hist-yaml        YAML file defining histogram expressions\n";
     std::cerr << "  --json             Write JSON yields\n";
+    std::cerr << "  --yield-format FMT json (default), binary (.byf, see YieldBinary.h) or both\n";
+    std::cerr << "  --cut-cache DIR    Load compiled cut/derived-variable expressions from DIR instead of jitting them\n";
+    std::cerr << "  --cut-cache-build  Compile expressions missing from --cut-cache DIR into it\n";
+    std::cerr << "  --bitmask          JSON yields of all bins from one bitset of their (shared-prefix) predicates per event\n"
+                 "                     instead of one filter chain per bin (many bins sharing cuts)\n";
+    std::cerr << "  --adaptive-order N Order each bin's filters by cost and pass rate measured on the first N events\n"
+                 "                     (cut flows keep the configured order)\n";
+    std::cerr << "  --nminus1          Also write bin__proc__NMinus1 (yield with each cut removed) next to the CutFlow\n";
+    std::cerr << "  --skim-dir DIR     Read DIR/<file stem>.root written by BFI_skim.x when its provenance matches\n";
+    std::cerr << "  --zone-maps DIR    Only read the source clusters in which some bin may pass its scalar cuts, from the\n"
+                 "                     zone maps BFI_skim.x writes to DIR/<file stem>.zonemap.json (JSON yields only)\n";
+    std::cerr << "  --save-entry-lists FILE  Write the entries passing every bin, per input and tree, to FILE\n";
+    std::cerr << "  --entry-lists FILE Only read the entries FILE records for some bin of this input and tree\n"
+                 "                     (histograms and yields; cut flows need every event and are skipped)\n";
+    std::cerr << "  --all-columns      Define every per-side lepton column, not only those the cuts and\n"
+                 "                     histograms reference (needed if user code reads them)\n";
     std::cerr << "  --signal           Mark this process as signal\n";
     std::cerr << "  --sig-type TYPE    Specify signal type (sets --signal automatically)\n";
     std::cerr << "  --lumi VALUE       Integrated luminosity to scale yields\n";
@@ -43,12 +86,14 @@ int main(int argc, char** argv) {
     RegisterSafeHelpers();
     std::string binName, cutsStr, lepCutsStr, predefCutsStr, userCutsStr, rootFilePath, outputJsonPath, sampleName, histOutputPath;
     std::vector<std::string> smsFilters;
-    bool isSignal=false, doHist=false, doJSON=false;
-    std::string sigType, histYamlPath;
+    bool isSignal=false, doHist=false, doJSON=false, allColumns=false, buildCutCache=false, doNMinus1=false, useBitmask=false;
+    std::string sigType, histYamlPath, binsYamlPath, cutCacheDir, skimDir, zoneDir, saveEntryListsPath, entryListsPath, yieldFormat = "json";
     double Lumi=1.0;
+    unsigned adaptiveEvents=0;
 
     static struct option long_options[] = {
         {"bin", required_argument, 0, 'b'},
+        {"bins-yaml", required_argument, 0, 'B'},
         {"file", required_argument, 0, 'f'},
         {"json-output", required_argument, 0, 'o'},
         {"cuts", required_argument, 0, 'c'},
@@ -64,14 +109,26 @@ int main(int argc, char** argv) {
         {"hist-yaml", required_argument, 0, 'y'},
         {"json", no_argument, 0, 'J'},
         {"root-output", required_argument, 0, 'O'},
+        {"all-columns", no_argument, 0, 'a'},
+        {"cut-cache", required_argument, 0, 'C'},
+        {"cut-cache-build", no_argument, 0, 'W'},
+        {"skim-dir", required_argument, 0, 'S'},
+        {"nminus1", no_argument, 0, 'N'},
+        {"yield-format", required_argument, 0, 'Y'},
+        {"bitmask", no_argument, 0, 'K'},
+        {"adaptive-order", required_argument, 0, 'A'},
+        {"zone-maps", required_argument, 0, 'Z'},
+        {"save-entry-lists", required_argument, 0, 'E'},
+        {"entry-lists", required_argument, 0, 'R'},
         {"help", no_argument, 0, 'h'},
         {0,0,0,0}
     };
 
     int opt, opt_index=0;
-    while ((opt = getopt_long(argc, argv, "b:f:o:c:l:p:st:u:n:m:Hy:J", long_options, &opt_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "b:B:f:o:c:l:p:st:u:n:m:Hy:JaC:WS:NY:KA:Z:E:R:", long_options, &opt_index)) != -1) {
         switch(opt){
             case 'b': binName=optarg; break;
+            case 'B': binsYamlPath=optarg; break;
             case 'f': rootFilePath=optarg; break;
             case 'o': outputJsonPath=optarg; break;
             case 'c': cutsStr=optarg; break;
@@ -87,26 +144,119 @@ int main(int argc, char** argv) {
             case 'y': histYamlPath=optarg; break;
             case 'J': doJSON=true; break;
             case 'O': histOutputPath = optarg; break;
+            case 'a': allColumns = true; break;
+            case 'C': cutCacheDir = optarg; break;
+            case 'W': buildCutCache = true; break;
+            case 'S': skimDir = optarg; break;
+            case 'N': doNMinus1 = true; break;
+            case 'Y': yieldFormat = optarg; break;
+            case 'K': useBitmask = true; break;
+            case 'A': adaptiveEvents = std::strtoul(optarg, nullptr, 10); break;
+            case 'Z': zoneDir = optarg; break;
+            case 'E': saveEntryListsPath = optarg; break;
+            case 'R': entryListsPath = optarg; break;
             case 'h':
             default: usage(argv[0]); return 1;
         }
     }
 
     if (sampleName.empty()) sampleName = GetSampleNameFromKey(rootFilePath);
+    if ((binName.empty() && binsYamlPath.empty()) || rootFilePath.empty() || (!doHist && !doJSON)) { usage(argv[0]); return 1; }
+    if (yieldFormat != "json" && yieldFormat != "binary" && yieldFormat != "both") { usage(argv[0]); return 1; }
+
+    // --- Bins to evaluate: either the single bin from the command line or every bin of the YAML ---
+    std::vector<BinSpec> bins;
+    if (!binsYamlPath.empty()) {
+        try {
+            bins = loadBinsYAML(binsYamlPath, splitTopLevel(binName));
+        } catch (const std::exception &e) {
+            std::cerr << "[BFI_condor] ERROR reading bins YAML " << binsYamlPath << ": " << e.what() << "\n";
+            return 2;
+        }
+        if (bins.empty()) { std::cerr << "[BFI_condor] No bins selected from " << binsYamlPath << "\n"; return 2; }
+        if (binName.empty()) binName = fs::path(binsYamlPath).stem().string();
+    } else {
+        BinSpec b;
+        b.name = binName;
+        b.cuts = splitTopLevel(cutsStr);
+        b.lepCuts = splitTopLevel(lepCutsStr);
+        b.predefCuts = splitTopLevel(predefCutsStr);
+        b.userCuts = splitTopLevel(userCutsStr);
+        bins.push_back(b);
+    }
     if (outputJsonPath.empty()) outputJsonPath = binName + "_" + sampleName + ".json";
-    if (binName.empty() || rootFilePath.empty() || (!doHist && !doJSON)) { usage(argv[0]); return 1; }
 
     BuildFitInput* BFI=nullptr;
     try{BFI=new BuildFitInput();}catch(...){std::cerr<<"[BFI_condor] Failed to construct BuildFitInput\n";return 3;}
 
-    std::vector<std::string> cutsVec=splitTopLevel(cutsStr);
-    std::vector<std::string> lepCutsVec=splitTopLevel(lepCutsStr);
-    std::vector<std::string> predefCutsVec=splitTopLevel(predefCutsStr);
-    std::vector<std::string> userCutsVec=splitTopLevel(userCutsStr);
-    std::vector<std::string> finalCuts;
-    if(!buildCutsForBin(BFI,cutsVec,lepCutsVec,predefCutsVec,finalCuts)){std::cerr<<"[BFI_condor] Failed to build final cuts\n"; delete BFI; return 2;}
-    std::vector<std::string> finalCutsExpanded;
-    for(const auto &c : finalCuts) finalCutsExpanded.push_back(BFI->ExpandMacros(c));
+    for (auto &b : bins) {
+        std::vector<std::string> finalCuts;
+        if(!buildCutsForBin(BFI,b.cuts,b.lepCuts,b.predefCuts,finalCuts)){std::cerr<<"[BFI_condor] Failed to build final cuts for bin "<<b.name<<"\n"; delete BFI; return 2;}
+        for(const auto &c : finalCuts) b.finalCutsExpanded.push_back(BFI->ExpandMacros(c));
+    }
+
+    // --- Derived variables and histogram definitions from YAML (shared by every tree) ---
+    std::vector<DerivedVar> derivedVars;
+    std::vector<HistDef> yamlHistDefs;
+    if(doHist && !histYamlPath.empty()){
+        derivedVars = loadDerivedVariablesYAML(histYamlPath);
+        yamlHistDefs = loadHistogramsYAML(histYamlPath, BFI);
+    }
+
+    // --- Only materialise the lepton columns the cuts and histograms reference ---
+    // User cuts are defined in code on the loaded node, so their dependencies are not known up front
+    bool needUserCuts = false;
+    for (const auto &b : bins) needUserCuts = needUserCuts || !b.userCuts.empty();
+    for (const auto &h : yamlHistDefs) needUserCuts = needUserCuts || !h.userCuts.empty();
+    std::vector<std::string> exprs;
+    for (const auto &b : bins) exprs.insert(exprs.end(), b.finalCutsExpanded.begin(), b.finalCutsExpanded.end());
+    for (const auto &dv : derivedVars) exprs.push_back(dv.expr);
+    for (const auto &h : yamlHistDefs) {
+        exprs.push_back(h.expr);
+        exprs.push_back(h.yexpr);
+        exprs.insert(exprs.end(), h.cuts.begin(), h.cuts.end());
+        exprs.insert(exprs.end(), h.lepCuts.begin(), h.lepCuts.end());
+        exprs.insert(exprs.end(), h.predefCuts.begin(), h.predefCuts.end());
+    }
+    // Histograms defined in code (DefineUserHists.h) read the raw branches it lists
+    if (doHist && !histYamlPath.empty()) exprs.insert(exprs.end(), kUserHistBranches.begin(), kUserHistBranches.end());
+    if (!allColumns && !needUserCuts) BFI->RequireColumns(exprs);
+    else if (!allColumns) std::cout << "[BFI_condor] User cuts requested; defining every lepton column\n";
+
+    // --- Skims are only used when everything the configuration reads is known ---
+    std::set<std::string> neededIds;
+    for (const auto &e : exprs) {
+        auto ids = BuildFitInput::ExpressionIdentifiers(BFI->ExpandMacros(e));
+        neededIds.insert(ids.begin(), ids.end());
+    }
+    std::vector<std::vector<std::string>> binCuts, binAtoms;
+    for (const auto &b : bins) binCuts.push_back(b.finalCutsExpanded);
+    for (const auto &b : bins) binAtoms.push_back(FilterTrie::Atoms(b.finalCutsExpanded));
+    if (!zoneDir.empty() && doHist) {
+        std::cout << "[BFI_condor] Not using zone maps: the cut flows need every event\n";
+        zoneDir.clear();
+    }
+    // entry lists are only reused for the same bin cuts; user cuts are defined in code, so by name
+    std::vector<std::string> binCutsHash;
+    for (const auto &b : bins) {
+        std::string key;
+        for (const auto &c : b.finalCutsExpanded) key += c + "\n";
+        for (const auto &u : b.userCuts) key += "user:" + u + "\n";
+        binCutsHash.push_back(CutCache::Hash(key));
+    }
+    std::vector<EntryListRecord> entryLists, savedEntryLists;
+    if (!entryListsPath.empty() && !ReadEntryLists(entryListsPath, entryLists)) {
+        std::cerr << "[BFI_condor] WARNING: cannot read entry lists " << entryListsPath << "; reading every entry\n";
+        entryLists.clear();
+    }
+    if (!skimDir.empty() && needUserCuts) {
+        std::cout << "[BFI_condor] User cuts requested; reading the source ntuple instead of the skim\n";
+        skimDir.clear();
+    }
+
+    // --- Compiled expression cache (falls back to jitting per expression) ---
+    std::unique_ptr<CutCache> cutCache;
+    if (!cutCacheDir.empty()) cutCache.reset(new CutCache(cutCacheDir, buildCutCache));
 
     std::unique_ptr<TFile> histFile;
     if(doHist && !histOutputPath.empty()){
@@ -122,8 +272,7 @@ int main(int argc, char** argv) {
     if(isSignal && sigType.empty())
         sigType=(rootFilePath.find("SMS")!=std::string::npos)?"sms":"cascades";
 
-    std::map<std::string, std::map<std::string,std::array<double,3>>> fileResults;
-    std::map<std::string,std::array<double,3>> totals;
+    std::map<std::string, BinYields> binResults;
     std::string processName = "";
     if(isSignal && sigType == "cascades")
         processName = BFTool::GetSignalTokensCascades(rootFilePath);
@@ -134,205 +283,376 @@ int main(int argc, char** argv) {
 
     auto processTree=[&](const std::string &tree_name, const std::string &key){
         if(doHist) histFile->cd();
-        ROOT::RDataFrame df(tree_name, rootFilePath);
-    
-        // Scale weights
-        auto df_scaled = df.Define("weight_scaled",[Lumi](double w){return w*Lumi;},{"weight"})
-                           .Define("weight_sq_scaled", [Lumi](double w2){ return w2 * Lumi * Lumi; }, {"weight2"});
-    
-        // Lepton counts / kinematics
-        auto df_with_lep = BFI->DefineLeptonPairCounts(df_scaled,"");
-        df_with_lep = BFI->DefineLeptonPairCounts(df_with_lep,"A");
-        df_with_lep = BFI->DefineLeptonPairCounts(df_with_lep,"B");
-        df_with_lep = BFI->DefinePairKinematics(df_with_lep,"");
-        df_with_lep = BFI->DefinePairKinematics(df_with_lep,"A");
-        df_with_lep = BFI->DefinePairKinematics(df_with_lep,"B");
+
+        // --- Use the skim of this file/tree when it is valid for the current configuration ---
+        std::string inputPath = rootFilePath;
+        SkimInfo skim;
+        bool fromSkim = false;
+        if (!skimDir.empty()) {
+            const std::string skimPath = SkimPathFor(skimDir, rootFilePath);
+            std::string why = "no provenance for tree " + tree_name;
+            if (ReadSkimInfo(skimPath, tree_name, skim) && SkimUsable(skim, rootFilePath, neededIds, &binCuts, why)) {
+                inputPath = skimPath;
+                fromSkim = true;
+                std::cout << "[BFI_condor] Reading skim " << skimPath << " (" << skim.skimEntries << " / "
+                          << skim.entries << " entries) for " << tree_name << "\n";
+            } else {
+                std::cout << "[BFI_condor] Not using skim " << skimPath << ": " << why << "\n";
+            }
+        }
+        // --- Entry lists of an earlier run: only read the entries some bin passed ---
+        std::unique_ptr<EntryListTree> listed;
+        const int64_t treeEntries = (!entryLists.empty() || !saveEntryListsPath.empty()) ? TreeEntries(inputPath, tree_name) : -1;
+        if (!entryLists.empty()) {
+            EntryBitmap any;
+            size_t found = 0, stale = 0;
+            for (size_t ib = 0; ib < bins.size(); ++ib)
+                for (const auto &r : entryLists) {
+                    if (r.input != inputPath || r.tree != tree_name || r.bin != bins[ib].name) continue;
+                    if (r.cutsHash == binCutsHash[ib] && r.treeEntries == treeEntries && treeEntries >= 0) { any.Or(r.entries); ++found; }
+                    else ++stale;
+                    break;
+                }
+            if (found == bins.size()) {
+                std::cout << "[BFI_condor] Entry lists " << entryListsPath << ": reading " << any.Cardinality()
+                          << " entries of " << tree_name << "\n";
+                listed.reset(new EntryListTree(any, tree_name, inputPath));
+                if (doHist) std::cout << "[BFI_condor] Not writing cut flows: they need every event\n";
+            } else {
+                std::cout << "[BFI_condor] Entry lists " << entryListsPath << " cover " << found << " / " << bins.size()
+                          << " bins of " << inputPath << ":" << tree_name;
+                if (stale) std::cout << " (" << stale << " recorded with other cuts or tree entries)";
+                std::cout << "; reading every entry\n";
+            }
+        }
+        const bool cutFlows = doHist && !listed; // cut flows need every event
+        // --- Zone map: skip the source clusters in which no bin can pass its scalar cuts ---
+        std::unique_ptr<ZonePrunedTree> pruned;
+        if (!zoneDir.empty() && !fromSkim && !listed) {
+            const std::string zonePath = ZoneMapPathFor(zoneDir, rootFilePath);
+            ZoneMap zm;
+            std::string why;
+            if (!ReadZoneMap(zonePath, tree_name, zm)) {
+                std::cout << "[BFI_condor] No zone map of " << tree_name << " in " << zonePath << "\n";
+            } else if (!ZoneMapCurrent(zm, rootFilePath, tree_name, why)) {
+                std::cout << "[BFI_condor] Not using zone map " << zonePath << ": " << why << "\n";
+            } else {
+                const auto keep = zm.Keep(binAtoms);
+                const long long kept = zm.KeptEntries(keep);
+                std::cout << "[BFI_condor] Zone map " << zonePath << ": reading " << std::count(keep.begin(), keep.end(), 1)
+                          << " / " << zm.NClusters() << " clusters (" << kept << " / " << zm.entries << " entries)\n";
+                if (kept < zm.entries) pruned.reset(new ZonePrunedTree(zm, keep, tree_name, rootFilePath));
+            }
+        }
+        ROOT::RDataFrame df = listed ? ROOT::RDataFrame(*listed->chain)
+                            : pruned ? ROOT::RDataFrame(*pruned->chain) : ROOT::RDataFrame(tree_name, inputPath);
+
+        // --- Every column the cuts and histograms read: weights, leptons, derived variables, user cuts ---
+        auto defineColumns = [&](ROOT::RDF::RNode n, std::map<std::string, CutDef> &userCuts, bool validate) {
+            // Scale weights
+            n = n.Define("weight_scaled",[Lumi](double w){return w*Lumi;},{"weight"})
+                 .Define("weight_sq_scaled", [Lumi](double w2){ return w2 * Lumi * Lumi; }, {"weight2"});
+
+            // Lepton counts / kinematics
+            n = BFI->DefineLeptonColumns(n);
+
+            // --- Validate derived variables ---
+            if (validate) for (const auto &dv : derivedVars) ValidateDerivedVarNode(n, dv);
+
+            // --- Define derived variables ---
+            for(const auto &dv : derivedVars){
+                try{
+                    n = DefineExpr(n, dv.name, dv.expr, cutCache.get());
+                }catch(const std::exception &e){
+                    std::cerr << "[BFI_condor] WARNING: Failed to define derived variable '"
+                              << dv.name << "' Expression: " << dv.expr
+                              << " Exception: " << e.what() << "\n";
+                }
+            }
+
+            // --- Load all user cuts ---
+            return BuildFitInput::loadCutsUser(n, userCuts);
+        };
 
         // --- Define node to apply final event selection cuts ---
-        ROOT::RDF::RNode node = df_with_lep;
-        
-        // --- Define any other derived variables from YAML ---
-        std::vector<DerivedVar> derivedVars;
+        std::map<std::string, CutDef> allUserCuts;
+        ROOT::RDF::RNode node = defineColumns(df, allUserCuts, true);
+
+        // --- User histograms define their own columns; keep them on the shared node for every bin ---
+        std::vector<HistDef> histDefs;
         if(doHist && !histYamlPath.empty()){
-            derivedVars = loadDerivedVariablesYAML(histYamlPath);
+            auto userHists = loadHistogramsUser(node);
+            histDefs = yamlHistDefs;
+            histDefs.insert(histDefs.end(), userHists.begin(), userHists.end());
+        }
+
+        // --- Per-bin filtered nodes, all hanging off the same graph ---
+        std::vector<BinBooking> bookings;
+        for (const auto &b : bins) {
+            BinBooking bk{node};
+            bk.bin = &b;
+            // --- Select which user cuts to keep ---
+            for (const auto &cutName : b.userCuts) {
+                auto it = allUserCuts.find(cutName);
+                if (it == allUserCuts.end()) {
+                    std::cerr << "[BFI_condor] Requested cut not found: " << cutName << "\n";
+                    continue;
+                }
+                const auto &cut = it->second;
+                std::string expanded = BFI->ExpandMacros(cut.expression);
+                if (!expanded.empty())
+                    bk.validUserCuts.push_back({cutName, expanded});
+            }
+            bookings.push_back(std::move(bk));
         }
-        
-        // --- Validate derived variables ---
-        for (const auto &dv : derivedVars) {
-            ValidateDerivedVarNode(node, dv);
+        // --- Apply filters: one trie of atomic predicates, bins share the Filter nodes of common predicates ---
+        std::vector<std::vector<std::string>> binPredicates;
+        for (const auto &bk : bookings) {
+            std::vector<std::string> cuts = bk.bin->finalCutsExpanded;
+            for (const auto &vc : bk.validUserCuts) cuts.push_back(vc.expr);
+            binPredicates.push_back(FilterTrie::Atoms(cuts));
         }
-        
-        // --- Define derived variables ---
-        for(const auto &dv : derivedVars){
-            try{
-                node = node.Define(dv.name, dv.expr);
-            }catch(const std::exception &e){
-                std::cerr << "[BFI_condor] WARNING: Failed to define derived variable '"
-                          << dv.name << "' Expression: " << dv.expr
-                          << " Exception: " << e.what() << "\n";
+
+        // --- Bitmask mode: JSON yields come from one bitset per event, the filtered nodes only feed histograms ---
+        const bool maskYields = useBitmask && doJSON;
+        // --- Entry lists are the entries reaching each bin's filtered node, numbered in the full tree ---
+        const bool saveEntries = !saveEntryListsPath.empty() && !listed && !pruned;
+        if (!saveEntryListsPath.empty() && !saveEntries)
+            std::cout << "[BFI_condor] Not saving entry lists of " << tree_name << ": only part of the tree is read\n";
+        const bool filterNodes = !maskYields || doHist || saveEntries;
+
+        // --- Adaptive order: cost and pass rate of every movable predicate on the first events of this tree ---
+        // Range() needs a dataframe built without implicit MT, so the profile reads its own copy
+        std::map<std::string, double> predicateRanks;
+        std::vector<std::string> distinct;
+        if (adaptiveEvents > 0 && filterNodes) {
+            std::set<std::string> seen;
+            for (const auto &bp : binPredicates)
+                for (const auto &p : bp) if (FilterTrie::Movable(p) && seen.insert(p).second) distinct.push_back(p);
+        }
+        if (!distinct.empty()) {
+            const bool mt = ROOT::IsImplicitMTEnabled();
+            if (mt) ROOT::DisableImplicitMT();
+            {
+                ROOT::RDataFrame profileDf(tree_name, inputPath);
+                std::map<std::string, CutDef> profileUserCuts;
+                auto stats = ProfilePredicates(defineColumns(profileDf, profileUserCuts, false), distinct, adaptiveEvents);
+                predicateRanks = PredicateRanks(distinct, stats);
+                if (!stats.empty())
+                    std::cout << "[BFI_condor] Profiled " << distinct.size() << " predicates on " << stats[0].events
+                              << " events for the filter order\n";
             }
+            if (mt) ROOT::EnableImplicitMT();
         }
-        
-        // --- Load all user cuts ---
-        std::map<std::string, CutDef> allUserCuts;
-        node = BuildFitInput::loadCutsUser(node, allUserCuts);
-        // --- Select which user cuts to keep ---
-        std::vector<DerivedVar> validUserCuts;
-        for (const auto &cutName : userCutsVec) {
-            auto it = allUserCuts.find(cutName);
-            if (it == allUserCuts.end()) {
-                std::cerr << "[BFI_condor] Requested cut not found: " << cutName << "\n";
-                continue;
+
+        ROOT::RDF::RResultPtr<BinMaskResult> binMask;
+        if (maskYields) {
+            BinMaskEngine engine(binPredicates);
+            ROOT::RDF::RNode bitsNode = DefineExpr(node, "bin_predicate_bits", engine.Expr(), cutCache.get());
+            binMask = bitsNode.Book<ROOT::RVec<ULong64_t>, double, double>(BinMaskHelper(engine, bitsNode.GetNSlots()),
+                                                                           {"bin_predicate_bits", "weight_scaled", "weight_sq_scaled"});
+            std::cout << "[BFI_condor] " << engine.NBins() << " bins: bitmask over " << engine.NBits()
+                      << " predicates (" << engine.NGuarded() << " guarded by the predicates before them)\n";
+        }
+        if (filterNodes) {
+            if (!predicateRanks.empty()) FilterTrie::RankedOrder(binPredicates, predicateRanks);
+            FilterTrie filterTrie(node, cutCache.get());
+            size_t nPredicates = 0;
+            for (size_t ib = 0; ib < bookings.size(); ++ib) {
+                bookings[ib].node = filterTrie.Path(binPredicates[ib]);
+                nPredicates += binPredicates[ib].size();
             }
-            const auto &cut = it->second;
-            std::string expanded = BFI->ExpandMacros(cut.expression);
-            if (!expanded.empty())
-                validUserCuts.push_back({cutName, expanded});
+            if (bookings.size() > 1)
+                std::cout << "[BFI_condor] " << bookings.size() << " bins: " << filterTrie.NFilters() << " shared filters for "
+                          << nPredicates << " predicates\n";
         }
 
-        if(doHist){
-            // --- Build ordered cuts list ---
-            std::vector<std::string> cutsOrdered;
-            std::vector<std::string> cutLabels;
-            for (const auto &c : finalCutsExpanded) { if (!c.empty()) { cutsOrdered.push_back(c); } }
-            for (const auto &cl : cutsVec) { cutLabels.push_back(cl); }
-            for (const auto &cl : lepCutsVec) { cutLabels.push_back(cl); }
-            for (const auto &cl : predefCutsVec) { cutLabels.push_back(cl); }
-            for (const auto &uc : validUserCuts) { cutsOrdered.push_back(uc.expr); cutLabels.push_back(uc.name); }
-            const int Ncuts = static_cast<int>(cutsOrdered.size());
-            
-            // --- Book single CutFlow histogram (Ncuts+1 bins: 0..Ncuts) ---
-            std::string cfName = binName + "__" + processName + "__CutFlow";
-            auto hist_CutFlow = std::make_shared<TH1D>(cfName.c_str(), cfName.c_str(), Ncuts+1, 0.0, double(Ncuts+1));
-            hist_CutFlow->Sumw2();
-            
-            // --- Total events from NTUPLES ---
-            auto sumW_NoCuts = node.Sum<double>("weight_scaled");
-            auto sumW2_NoCuts = node.Sum<double>("weight_sq_scaled");
-            double sW_NoCuts = sumW_NoCuts.GetValue();
-            double sW2_NoCuts = sumW2_NoCuts.GetValue();
-            double err_NoCuts = (sW2_NoCuts>=0)?std::sqrt(sW2_NoCuts):0.0;
-            hist_CutFlow->SetBinContent(0, sW_NoCuts);
-            hist_CutFlow->SetBinError(0, err_NoCuts);
-            hist_CutFlow->SetBinContent(1, sW_NoCuts);
-            hist_CutFlow->SetBinError(1, err_NoCuts);
-            hist_CutFlow->GetXaxis()->SetBinLabel(1, "NTUPLES");
-            
-            // --- Only build cumulative CutFlow if there are cuts ---
-            if (Ncuts > 1) {
-                auto make_pass_name = [&](int i){ return processName + std::string("_pass_") + std::to_string(i+1); };
-            
-                ROOT::RDF::RNode defNode = node;
-                for (int i = 0; i < Ncuts; ++i) {
-                    std::string expr = (i == 0) ? ("(" + cutsOrdered[0] + ")")
-                                                : (make_pass_name(i-1) + " && (" + cutsOrdered[i] + ")");
-                    defNode = defNode.Define(make_pass_name(i), expr);
-                }
-            
-                // npassed = sum(pass_i ? 1 : 0)
-                std::string npassedExpr;
-                for (int i = 0; i < Ncuts; ++i) {
-                    if (i) npassedExpr += " + ";
-                    npassedExpr += "(" + make_pass_name(i) + " ? 1 : 0)";
+        // --- Histogram VALIDATION PASS (MT OFF), before anything is booked on the graph ---
+        size_t N = histDefs.size();
+        std::vector<std::vector<HistFilterPlan>> plans(bookings.size(), std::vector<HistFilterPlan>(N));
+        std::vector<std::vector<char>> keep(bookings.size(), std::vector<char>(N, 0));
+        if (N > 0) {
+            ROOT::EnableImplicitMT(0);
+            for (size_t b = 0; b < bookings.size(); ++b) {
+                for (size_t i = 0; i < N; ++i) {
+                    const auto &h = histDefs[i];
+                    plans[b][i] = BuildHistFilterPlan(h, BFI, allUserCuts);
+                
+                    // create a hnode copy for validation context (node must have been created with MT OFF)
+                    ROOT::RDF::RNode hnode = bookings[b].node;
+                
+                    bool ok = ValidateAndRecordAppliedUserCuts(hnode, plans[b][i], h, BFI);
+                    keep[b][i] = ok ? 1 : 0;
                 }
-                std::string npassed_col = processName + std::string("_npassed");
-                defNode = defNode.Define(npassed_col, npassedExpr);
-            
-                // Fill Histo1D once (use .c_str())
-                std::string histNameTmp = processName + std::string("_npassed_tmp");
-                auto r_h_npassed = defNode.Histo1D(
-                    { histNameTmp.c_str(), histNameTmp.c_str(), Ncuts, 0.0, double(Ncuts) },
-                    npassed_col.c_str(),
-                    "weight_scaled"
-                );
-            
-                // Execute once and get the TH1D by value (copy)
-                auto h_npassed = r_h_npassed.GetValue();
-            
-                // Fill classical CutFlow: bins 1..Ncuts = events surviving cut1..cutN
-                for (int i = 2; i <= Ncuts+1; ++i) {
-                    double surv = 0.0;
-                    double surv_err2 = 0.0;
-                    for (int k = i-1; k <= Ncuts; ++k) {
-                        // mapping: npassed == k is stored in histogram bin index (k + 1)
-                        int rootBin = k + 1;
-                        double c = h_npassed.GetBinContent(rootBin);
-                        double e = h_npassed.GetBinError(rootBin);
-                        surv += c;
-                        surv_err2 += e * e;
+            }
+        }
+
+        // --- Book the CutFlow, histograms (HistBatch) and JSON yields of every bin on the shared graph ---
+        // One event loop fills them all, when the first result is read below
+        ROOT::EnableImplicitMT(); // turn on multi-threading once
+        ROOT::RDF::RResultPtr<double> sumW_NoCuts, sumW2_NoCuts;
+        if(cutFlows && !fromSkim){
+            // --- Total events from NTUPLES (for a skim they come from its provenance) ---
+            sumW_NoCuts = node.Sum<double>("weight_scaled");
+            sumW2_NoCuts = node.Sum<double>("weight_sq_scaled");
+        }
+        for (size_t ib = 0; ib < bookings.size(); ++ib) {
+            auto &bk = bookings[ib];
+            const BinSpec &b = *bk.bin;
+            if(cutFlows){
+                // --- Build ordered cuts list ---
+                std::vector<std::string> cutsOrdered;
+                for (const auto &c : b.finalCutsExpanded) { if (!c.empty()) { cutsOrdered.push_back(c); } }
+                for (const auto &cl : b.cuts) { bk.cutLabels.push_back(cl); }
+                for (const auto &cl : b.lepCuts) { bk.cutLabels.push_back(cl); }
+                for (const auto &cl : b.predefCuts) { bk.cutLabels.push_back(cl); }
+                for (const auto &uc : bk.validUserCuts) { cutsOrdered.push_back(uc.expr); bk.cutLabels.push_back(uc.name); }
+                bk.nCuts = static_cast<int>(cutsOrdered.size());
+
+                // --- Skim: preselection cuts first, in skim order, so their steps come from the provenance ---
+                if (fromSkim && bk.nCuts > 1) {
+                    const bool labelsAligned = bk.cutLabels.size() == cutsOrdered.size();
+                    std::vector<std::string> cutsFront, labelsFront, cutsRest, labelsRest;
+                    std::vector<char> used(cutsOrdered.size(), 0);
+                    for (const auto &p : skim.preselection) {
+                        for (size_t k = 0; k < cutsOrdered.size(); ++k) {
+                            if (used[k] || SkimCutKey(cutsOrdered[k]) != SkimCutKey(p)) continue;
+                            used[k] = 1;
+                            cutsFront.push_back(cutsOrdered[k]);
+                            if (labelsAligned) labelsFront.push_back(bk.cutLabels[k]);
+                            break;
+                        }
+                    }
+                    for (size_t k = 0; k < cutsOrdered.size(); ++k) {
+                        if (used[k]) continue;
+                        cutsRest.push_back(cutsOrdered[k]);
+                        if (labelsAligned) labelsRest.push_back(bk.cutLabels[k]);
+                    }
+                    bk.nSkimSteps = static_cast<int>(cutsFront.size());
+                    cutsOrdered = cutsFront;
+                    cutsOrdered.insert(cutsOrdered.end(), cutsRest.begin(), cutsRest.end());
+                    if (labelsAligned) {
+                        bk.cutLabels = labelsFront;
+                        bk.cutLabels.insert(bk.cutLabels.end(), labelsRest.begin(), labelsRest.end());
                     }
-                    hist_CutFlow->SetBinContent(i, surv);
-                    hist_CutFlow->SetBinError(i, std::sqrt(surv_err2));
-            
-                    std::string lbl = (i - 2 < (int)cutLabels.size()) ? cutLabels[i - 2] : ("Cut_" + std::to_string(i-1));
-                    hist_CutFlow->GetXaxis()->SetBinLabel(i, lbl.c_str());
                 }
+
+                // --- CutFlow: one summary column per bin, cuts evaluated in order and short-circuited ---
+                if (bk.nCuts > 0) {
+                    // named by bin index: distinct bin names may sanitise to the same column name
+                    const std::string codeCol = "bin" + std::to_string(ib) + "_cutflow";
+                    ROOT::RDF::RNode cfNode = DefineExpr(node, codeCol, BuildCutFlowExpr(cutsOrdered, doNMinus1), cutCache.get());
+                    bk.cutflow = cfNode.Book<int, double, double>(CutFlowHelper(bk.nCuts, doNMinus1, cfNode.GetNSlots()),
+                                                                  {codeCol, "weight_scaled", "weight_sq_scaled"});
+                }
+            }
+            if (N > 0) {
+                bk.histBatch.reset(new HistBatch(bk.node, cutCache.get()));
+                for (size_t i = 0; i < N; ++i) {
+                    if (!keep[ib][i]) continue;
+                    const auto &h = histDefs[i];
+                    std::string hname = MakeHistName(bk.bin->name, processName, h.name);
+                    // Use the recorded plan; appliedUserCuts were stored in validation
+                    bk.histBatch->Book(plans[ib][i], h, hname);
+                }
+            }
+            if(doJSON && !maskYields){
+                bk.count = bk.node.Count();
+                bk.sumW = bk.node.Sum<double>("weight_scaled");
+                bk.sumW2 = bk.node.Sum<double>("weight_sq_scaled");
             }
-            // --- Write CutFlow ---
-            hist_CutFlow->Write();
+            if (saveEntries)
+                bk.entries = bk.node.Book<>(EntryBitmapHelper(bk.node.GetNSlots()));
         }
 
-        // --- Apply filters to node ---
-        for (const auto &c : finalCutsExpanded) if (!c.empty()) node = node.Filter(c);
-        for (const auto &vc : validUserCuts) node = node.Filter(vc.expr);
-    
-        // --- Histograms ---
-        if(doHist && !histYamlPath.empty()){
-            // --- prepare histDefs as before ---
-            auto userHists = loadHistogramsUser(node);
-            auto histDefs = loadHistogramsYAML(histYamlPath, BFI);
-            histDefs.insert(histDefs.end(), userHists.begin(), userHists.end());
-            
-            size_t N = histDefs.size();
-            std::vector<HistFilterPlan> plans(N);
-            std::vector<char> keep(N, 0);
-            
-            // --- VALIDATION PASS (MT OFF) ---
-            ROOT::EnableImplicitMT(0);
-            
-            for (size_t i = 0; i < N; ++i) {
-                const auto &h = histDefs[i];
-                plans[i] = BuildHistFilterPlan(h, BFI, allUserCuts);
-            
-                // create a hnode copy for validation context (node must have been created with MT OFF)
-                ROOT::RDF::RNode hnode = node;
-            
-                bool ok = ValidateAndRecordAppliedUserCuts(hnode, plans[i], h, BFI);
-                keep[i] = ok ? 1 : 0;
-            }
-            
-            // --- FILL PASS (MT ON) ---
-            ROOT::EnableImplicitMT(); // turn on multi-threading once
-            
+        // --- Histograms: the first write runs the single shared event loop ---
+        if (N > 0) {
             std::cout << "[BFI_condor] Filling histograms\n";
-            for (size_t i = 0; i < N; ++i) {
-                if (!keep[i]) continue;
-                const auto &h = histDefs[i];
-                std::string hname = binName + "__" + processName + "__" + h.name;
-            
-                // Use the recorded plan; appliedUserCuts were stored in validation
-                FillHistFromPlan(node, plans[i], h, hname);
+            for (auto &bk : bookings) if (bk.histBatch) bk.histBatch->WriteAll();
+        }
+
+        // --- CutFlow ---
+        if(cutFlows){
+            double sW_NoCuts = fromSkim ? skim.sumW * Lumi : sumW_NoCuts.GetValue();
+            double sW2_NoCuts = fromSkim ? skim.sumW2 * Lumi * Lumi : sumW2_NoCuts.GetValue();
+            double err_NoCuts = (sW2_NoCuts>=0)?std::sqrt(sW2_NoCuts):0.0;
+            for (auto &bk : bookings) {
+                // --- Single CutFlow histogram (Ncuts+1 bins: 0..Ncuts) ---
+                const int Ncuts = bk.nCuts;
+                std::string cfName = MakeHistName(bk.bin->name, processName, "CutFlow");
+                auto hist_CutFlow = std::make_shared<TH1D>(cfName.c_str(), cfName.c_str(), Ncuts+1, 0.0, double(Ncuts+1));
+                hist_CutFlow->Sumw2();
+                hist_CutFlow->SetBinContent(0, sW_NoCuts);
+                hist_CutFlow->SetBinError(0, err_NoCuts);
+                hist_CutFlow->SetBinContent(1, sW_NoCuts);
+                hist_CutFlow->SetBinError(1, err_NoCuts);
+                hist_CutFlow->GetXaxis()->SetBinLabel(1, "NTUPLES");
+
+                if (Ncuts > 0) {
+                    const CutFlowResult &cf = *bk.cutflow;
+                    // Fill classical CutFlow: bins 2..Ncuts+1 = events surviving cut1..cutN
+                    for (int i = 2; i <= Ncuts+1; ++i) {
+                        double surv = cf.sumw[i-2];
+                        double surv_err2 = cf.sumw2[i-2];
+                        if (i - 2 < bk.nSkimSteps) {
+                            // events failing the preselection are not in the skim
+                            surv = skim.preselectionSums[i-2].first * Lumi;
+                            surv_err2 = skim.preselectionSums[i-2].second * Lumi * Lumi;
+                        }
+                        hist_CutFlow->SetBinContent(i, surv);
+                        hist_CutFlow->SetBinError(i, std::sqrt(surv_err2));
+                
+                        std::string lbl = (i - 2 < (int)bk.cutLabels.size()) ? bk.cutLabels[i - 2] : ("Cut_" + std::to_string(i-1));
+                        hist_CutFlow->GetXaxis()->SetBinLabel(i, lbl.c_str());
+                    }
+
+                    // --- N-1: bin 1 = all cuts, bin k+2 = all cuts but cut k ---
+                    if (doNMinus1) {
+                        std::string nm1Name = MakeHistName(bk.bin->name, processName, "NMinus1");
+                        auto hist_NMinus1 = std::make_shared<TH1D>(nm1Name.c_str(), nm1Name.c_str(), Ncuts+1, 0.0, double(Ncuts+1));
+                        hist_NMinus1->Sumw2();
+                        hist_NMinus1->SetBinContent(1, cf.sumw[Ncuts-1]);
+                        hist_NMinus1->SetBinError(1, std::sqrt(cf.sumw2[Ncuts-1]));
+                        hist_NMinus1->GetXaxis()->SetBinLabel(1, "AllCuts");
+                        for (int k = 0; k < Ncuts; ++k) {
+                            std::string lbl = (k < (int)bk.cutLabels.size()) ? bk.cutLabels[k] : ("Cut_" + std::to_string(k+1));
+                            // dropping a preselection cut would need events the skim does not have
+                            if (k < bk.nSkimSteps) lbl += " (not in skim)";
+                            else {
+                                hist_NMinus1->SetBinContent(k+2, cf.nm1Sumw[k]);
+                                hist_NMinus1->SetBinError(k+2, std::sqrt(cf.nm1Sumw2[k]));
+                            }
+                            hist_NMinus1->GetXaxis()->SetBinLabel(k+2, ("no " + lbl).c_str());
+                        }
+                        hist_NMinus1->Write();
+                    }
+                }
+                // --- Write CutFlow ---
+                hist_CutFlow->Write();
             }
         }
     
         // --- JSON output ---
         if(doJSON){
             std::cout << "[BFI_condor] Filling json\n";
-            ROOT::EnableImplicitMT();
-            auto json_node = node;
-            auto cnt = json_node.Count();
-            auto sumW = json_node.Sum<double>("weight_scaled");
-            auto sumW2 = json_node.Sum<double>("weight_sq_scaled");
-            unsigned long long n_entries = cnt.GetValue();
-            double sW = sumW.GetValue();
-            double sW2Val = sumW2.GetValue();
-            double err = (sW2Val>=0)?std::sqrt(sW2Val):0.0;
-            fileResults[key][rootFilePath] = {(double)n_entries,sW,err};
-            auto &tot=totals[key];
-            tot[0]+= (double)n_entries;
-            tot[1]+= sW;
-            tot[2]+= err*err;
+            for (size_t ib = 0; ib < bookings.size(); ++ib) {
+                auto &bk = bookings[ib];
+                unsigned long long n_entries = maskYields ? binMask->count[ib] : bk.count.GetValue();
+                double sW = maskYields ? binMask->sumW[ib] : bk.sumW.GetValue();
+                double sW2Val = std::max(0.0, maskYields ? binMask->sumW2[ib] : bk.sumW2.GetValue());
+                auto &res = binResults[bk.bin->name];
+                res.fileResults[key][rootFilePath] = {(double)n_entries,sW,sW2Val};
+                auto &tot=res.totals[key];
+                tot[0]+= (double)n_entries;
+                tot[1]+= sW;
+                tot[2]+= sW2Val;
+            }
         }
+
+        if (saveEntries)
+            for (size_t ib = 0; ib < bookings.size(); ++ib)
+                savedEntryLists.push_back({inputPath, tree_name, bins[ib].name, binCutsHash[ib], treeEntries,
+                                           std::move(*bookings[ib].entries)});
     };
 
     if(!isSignal) processTree("KUAnalysis",sampleName);
@@ -342,14 +662,19 @@ int main(int argc, char** argv) {
             processTree(tree_name,processName);
     }else{std::cerr<<"[BFI_condor] Unknown sig-type: "<<sigType<<"\n"; delete BFI; return 4;}
 
-    for(auto &kv: totals) kv.second[2]=std::sqrt(kv.second[2]);
-
-    if(doJSON && !writePartialJSON(outputJsonPath,binName,fileResults,totals)){
+    if(doJSON && yieldFormat!="binary" && !writePartialJSON(outputJsonPath,binResults)){
         std::cerr<<"[BFI_condor] ERROR writing JSON to "<<outputJsonPath<<"\n"; delete BFI; return 5;
     }
+    if(doJSON && yieldFormat!="json" && !writePartialBinary(YieldPathFor(outputJsonPath,"binary"),binResults)){
+        std::cerr<<"[BFI_condor] ERROR writing binary yields for "<<outputJsonPath<<"\n"; delete BFI; return 5;
+    }
+    // written even without records: condor jobs transfer it back as an output
+    if(!saveEntryListsPath.empty() && !WriteEntryLists(saveEntryListsPath, savedEntryLists)){
+        std::cerr<<"[BFI_condor] ERROR writing entry lists to "<<saveEntryListsPath<<"\n"; delete BFI; return 5;
+    }
     if(histFile) histFile->Close();
 
+    if (cutCache) cutCache->PrintStats();
     delete BFI;
     return 0;
 }
-
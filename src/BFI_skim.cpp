@@ -0,0 +1,251 @@
+// src/BFI_skim.cpp
+// Writes a reduced copy of one ntuple for a bins YAML: only events passing the cuts shared
+// by every bin, and only the branches the bins / histograms reference (plus the raw lepton
+// branches and the per-side lepton columns they use). BFI_condor.x --skim-dir and
+// BuildFitInput::skimDir read it instead of the source while its provenance matches.
+// Next to it, <file stem>.zonemap.json holds a zone map of the source (per-cluster min/max of the
+// scalar branches the bins cut on most), with which BFI_condor.x --zone-maps skips source clusters
+// no bin can pass; jobs are shipped only that small file.
+#include <getopt.h>
+#include "TFile.h"
+#include "TROOT.h"
+
+#include "BFICondorTools.h"
+#include "SkimTools.h"
+#include "FilterTrie.h"
+#include "ZoneMap.h"
+
+// Raw lepton branches the per-side lepton kernel reads
+static const std::vector<std::string> kLeptonBranches = {
+    "PDGID_lep", "Charge_lep", "LepQual_lep", "PT_lep", "Eta_lep", "Phi_lep", "M_lep",
+    "index_lep_a_LEP", "index_lep_b_LEP"
+};
+
+// Branch types a zone map can summarise
+static const std::set<std::string> kScalarTypes = {
+    "Float_t", "Double_t", "Int_t", "UInt_t", "Short_t", "UShort_t", "Long64_t", "ULong64_t", "Bool_t",
+    "float", "double", "int", "unsigned int", "short", "unsigned short", "long long", "unsigned long long", "bool"
+};
+static const size_t kMaxZoneBranches = 8;
+
+static void usage(const char* me) {
+    std::cerr << "Usage: " << me << " --bins-yaml BINS.yaml --file ROOTFILE [--output-dir DIR] "
+                 "[--hist-yaml HISTS.yaml] [--keep BR1,BR2,...] [--zone-branches BR1,BR2,...|none]\n\n";
+    std::cerr << "  --bins-yaml   Bins YAML (config/bin_cfgs format); the cuts common to all bins are the preselection\n";
+    std::cerr << "  --file        Source ROOT file (all SMS trees are skimmed for X_SMS files)\n";
+    std::cerr << "  --output-dir  Directory for <file stem>.root and <file stem>.zonemap.json (default: skims)\n";
+    std::cerr << "  --hist-yaml   Histogram YAML whose expressions and derived variables must stay readable\n"
+                 "                (also keeps the branches of the code-defined user histograms)\n";
+    std::cerr << "  --keep        Extra branches to keep (e.g. ones read by user cuts)\n";
+    std::cerr << "  --zone-branches  Scalar branches of the source zone map (default: the " << kMaxZoneBranches
+              << " the bins compare to a number most often; none to skip it)\n";
+    std::cerr << "  --help        Display this help message\n";
+}
+
+int main(int argc, char** argv) {
+    RegisterSafeHelpers();
+    std::string binsYamlPath, rootFilePath, histYamlPath, outputDir = "skims";
+    std::vector<std::string> extraKeep, zoneBranches;
+    bool autoZoneBranches = true;
+
+    static struct option long_options[] = {
+        {"bins-yaml", required_argument, 0, 'B'},
+        {"file", required_argument, 0, 'f'},
+        {"output-dir", required_argument, 0, 'o'},
+        {"hist-yaml", required_argument, 0, 'y'},
+        {"keep", required_argument, 0, 'k'},
+        {"zone-branches", required_argument, 0, 'z'},
+        {"help", no_argument, 0, 'h'},
+        {0,0,0,0}
+    };
+
+    int opt, opt_index=0;
+    while ((opt = getopt_long(argc, argv, "B:f:o:y:k:z:h", long_options, &opt_index)) != -1) {
+        switch(opt){
+            case 'B': binsYamlPath = optarg; break;
+            case 'f': rootFilePath = optarg; break;
+            case 'o': outputDir = optarg; break;
+            case 'y': histYamlPath = optarg; break;
+            case 'k': extraKeep = splitTopLevel(optarg); break;
+            case 'z':
+                autoZoneBranches = false;
+                if (std::string(optarg) != "none") zoneBranches = splitTopLevel(optarg);
+                break;
+            case 'h':
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (binsYamlPath.empty() || rootFilePath.empty()) { usage(argv[0]); return 1; }
+
+    std::vector<BinSpec> bins;
+    try {
+        bins = loadBinsYAML(binsYamlPath);
+    } catch (const std::exception &e) {
+        std::cerr << "[BFI_skim] ERROR reading bins YAML " << binsYamlPath << ": " << e.what() << "\n";
+        return 2;
+    }
+    if (bins.empty()) { std::cerr << "[BFI_skim] No bins in " << binsYamlPath << "\n"; return 2; }
+
+    BuildFitInput BFI;
+    for (auto &b : bins) {
+        std::vector<std::string> finalCuts;
+        if (!buildCutsForBin(&BFI, b.cuts, b.lepCuts, b.predefCuts, finalCuts)) {
+            std::cerr << "[BFI_skim] Failed to build final cuts for bin " << b.name << "\n";
+            return 2;
+        }
+        for (const auto &c : finalCuts) if (!c.empty()) b.finalCutsExpanded.push_back(BFI.ExpandMacros(c));
+    }
+
+    // --- Preselection: cuts of the first bin that every other bin applies too ---
+    std::vector<std::string> preselection;
+    for (const auto &c : bins.front().finalCutsExpanded) {
+        bool common = true;
+        for (size_t i = 1; i < bins.size() && common; ++i) {
+            common = std::any_of(bins[i].finalCutsExpanded.begin(), bins[i].finalCutsExpanded.end(),
+                                 [&](const std::string &o){ return SkimCutKey(o) == SkimCutKey(c); });
+        }
+        if (common) preselection.push_back(c);
+    }
+
+    std::vector<std::vector<std::string>> binAtoms;
+    for (const auto &b : bins) binAtoms.push_back(FilterTrie::Atoms(b.finalCutsExpanded));
+
+    // --- Everything the configuration may read ---
+    std::vector<std::string> exprs;
+    for (const auto &b : bins) exprs.insert(exprs.end(), b.finalCutsExpanded.begin(), b.finalCutsExpanded.end());
+    if (!histYamlPath.empty()) {
+        for (const auto &dv : loadDerivedVariablesYAML(histYamlPath)) exprs.push_back(dv.expr);
+        for (const auto &h : loadHistogramsYAML(histYamlPath, &BFI)) {
+            exprs.push_back(h.expr);
+            exprs.push_back(h.yexpr);
+            exprs.insert(exprs.end(), h.cuts.begin(), h.cuts.end());
+            exprs.insert(exprs.end(), h.lepCuts.begin(), h.lepCuts.end());
+            exprs.insert(exprs.end(), h.predefCuts.begin(), h.predefCuts.end());
+        }
+        // BFI_condor.x --hist-yaml also runs loadHistogramsUser (DefineUserHists.h) on these
+        exprs.insert(exprs.end(), kUserHistBranches.begin(), kUserHistBranches.end());
+    }
+    exprs.insert(exprs.end(), extraKeep.begin(), extraKeep.end());
+    BFI.RequireColumns(exprs);
+    const std::set<std::string> &needed = BFI.RequiredColumns();
+
+    stringlist trees = {"KUAnalysis"};
+    if (rootFilePath.find("SMS") != std::string::npos) trees = BFTool::GetSignalTokensSMS(rootFilePath);
+
+    gSystem->mkdir(outputDir.c_str(), true);
+    const std::string outPath = SkimPathFor(outputDir, rootFilePath);
+    const std::string zonePath = ZoneMapPathFor(outputDir, rootFilePath);
+    std::vector<ZoneMap> zoneMaps;
+    ROOT::EnableImplicitMT(); // before the dataframes so the lepton kernel gets one buffer per slot
+
+    std::cout << "[BFI_skim] Preselection (" << preselection.size() << " cuts):\n";
+    for (const auto &c : preselection) std::cout << "  " << c << "\n";
+
+    for (size_t t = 0; t < trees.size(); ++t) {
+        const std::string &tree = trees[t];
+        ROOT::RDataFrame df(tree, rootFilePath);
+        const auto branches = df.GetColumnNames();
+        const std::set<std::string> branchSet(branches.begin(), branches.end());
+
+        ROOT::RDF::RNode node = df;
+        const std::string w2col = branchSet.count("weight2") ? "weight2" : "weight_sq_skim";
+        if (!branchSet.count("weight2")) node = node.Define(w2col, [](double w){ return w*w; }, {"weight"});
+        node = BFI.DefineLeptonColumns(node);
+
+        SkimInfo info;
+        info.source = rootFilePath;
+        info.tree = tree;
+        info.preselection = preselection;
+        auto count0 = node.Count();
+        auto sumW0 = node.Sum<double>("weight");
+        auto sumW20 = node.Sum<double>(w2col);
+        std::vector<ROOT::RDF::RResultPtr<double>> preW, preW2;
+        ROOT::RDF::RNode sel = node;
+        for (const auto &c : preselection) {
+            sel = sel.Filter(c);
+            preW.push_back(sel.Sum<double>("weight"));
+            preW2.push_back(sel.Sum<double>(w2col));
+        }
+        auto countSkim = sel.Count();
+
+        // --- Zone map of the source: min/max of the mapped branches in every cluster, in the same loop ---
+        ZoneMap zoneLayout;
+        ROOT::RDF::RResultPtr<ZoneMap> zoneMap;
+        std::vector<std::string> scalars;
+        for (const auto &br : branches)
+            if (kScalarTypes.count(df.GetColumnType(br))) scalars.push_back(br);
+        const std::set<std::string> scalarSet(scalars.begin(), scalars.end());
+        for (const auto &br : autoZoneBranches ? ZoneMapCandidates(binAtoms, scalarSet, kMaxZoneBranches) : zoneBranches) {
+            if (scalarSet.count(br)) zoneLayout.branches.push_back(br);
+            else std::cerr << "[BFI_skim] WARNING: " << br << " is not a scalar branch of " << tree << ", not zone-mapped\n";
+        }
+        if (!zoneLayout.branches.empty()) {
+            std::unique_ptr<TFile> src(TFile::Open(rootFilePath.c_str(), "READ"));
+            TTree *srcTree = src ? src->Get<TTree>(tree.c_str()) : nullptr;
+            if (srcTree) {
+                zoneLayout.source = rootFilePath;
+                zoneLayout.tree = tree;
+                zoneLayout.entries = srcTree->GetEntries();
+                zoneLayout.clusterStart = ClusterStarts(srcTree);
+                std::string values = "ROOT::RVec<double>{";
+                for (size_t b = 0; b < zoneLayout.branches.size(); ++b)
+                    values += (b ? ", double(" : "double(") + zoneLayout.branches[b] + ")";
+                auto zoneNode = node.Define("zone_map_values", values + "}");
+                zoneMap = zoneNode.Book<ROOT::RVec<double>>(ZoneMapHelper(zoneLayout, zoneNode.GetNSlots()),
+                                                            {"zone_map_values"});
+            } else {
+                std::cerr << "[BFI_skim] WARNING: cannot read the clusters of " << rootFilePath << ":" << tree
+                          << ", no zone map\n";
+            }
+        }
+
+        // --- Columns: referenced source branches, weights, raw leptons, and the per-side lepton columns in use ---
+        std::vector<std::string> keep;
+        for (const auto &br : branches) {
+            const bool lep = std::find(kLeptonBranches.begin(), kLeptonBranches.end(), br) != kLeptonBranches.end();
+            if (needed.count(br) || lep || br == "weight" || br == "weight2") keep.push_back(br);
+            else info.dropped.push_back(br);
+        }
+        for (const auto &col : sel.GetColumnNames()) {
+            if (branchSet.count(col) || !needed.count(col)) continue;
+            const std::string type = sel.GetColumnType(col);
+            if (type.find("pair<") != std::string::npos || type.find("CLING_UNKNOWN") != std::string::npos) continue;
+            keep.push_back(col);
+        }
+        info.columns = keep;
+
+        ROOT::RDF::RSnapshotOptions opts;
+        opts.fMode = (t == 0) ? "RECREATE" : "UPDATE";
+        opts.fCompressionAlgorithm = ROOT::RCompressionSetting::EAlgorithm::kZSTD;
+        opts.fCompressionLevel = 5;
+        std::cout << "[BFI_skim] " << rootFilePath << ":" << tree << " -> " << outPath << " (" << keep.size()
+                  << " of " << branches.size() << " branches)\n";
+        try {
+            sel.Snapshot(tree, outPath, keep, opts); // runs the loop for every action booked above
+        } catch (const std::exception &e) {
+            std::cerr << "[BFI_skim] ERROR writing " << outPath << ": " << e.what() << "\n";
+            return 3;
+        }
+
+        info.entries = *count0;
+        info.skimEntries = *countSkim;
+        info.sumW = *sumW0;
+        info.sumW2 = *sumW20;
+        for (size_t i = 0; i < preW.size(); ++i) info.preselectionSums.emplace_back(*preW[i], *preW2[i]);
+        if (!WriteSkimInfo(outPath, info)) return 4;
+        std::cout << "[BFI_skim] kept " << info.skimEntries << " / " << info.entries << " entries\n";
+        if (zoneMap) {
+            zoneMaps.push_back(*zoneMap);
+            std::cout << "[BFI_skim] zone map of " << zoneMap->NClusters() << " clusters over";
+            for (const auto &br : zoneMap->branches) std::cout << " " << br;
+            std::cout << "\n";
+        }
+    }
+    if (!zoneMaps.empty()) {
+        if (!WriteZoneMaps(zonePath, zoneMaps)) return 4;
+        std::cout << "[BFI_skim] zone maps -> " << zonePath << "\n";
+    } else {
+        gSystem->Unlink(zonePath.c_str()); // never leave the zone map of an older source behind
+    }
+    return 0;
+}
@@ -2,6 +2,15 @@
 #include <filesystem>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <algorithm>
+
+#include "TROOT.h"
 
 #include "JSONFactory.h"
 #include "BuildFit.h"
@@ -12,14 +21,23 @@ int main(int argc, char** argv) {
     // Default values
     std::string input_json = "./json/test_cascades.json";
     std::string datacard_dir = "datacards_cascades";
+    unsigned nThreads = 0; // all cores
 
-    // Override defaults if arguments are provided
-    if (argc > 1) input_json = argv[1];
-    if (argc > 2) datacard_dir = argv[2];
+    // Override defaults if arguments are provided: [input_json] [datacard_dir] [-j N]
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if ((a == "-j" || a == "--threads") && i + 1 < argc) nThreads = std::atoi(argv[++i]);
+        else positional.push_back(a);
+    }
+    if (positional.size() > 0) input_json = positional[0];
+    if (positional.size() > 1) datacard_dir = positional[1];
+    if (nThreads == 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
 
     std::cout << "Using input JSON: " << input_json << "\n";
     std::cout << "Using datacard directory: " << datacard_dir << "\n";
 
+    ROOT::EnableThreadSafety();
     JSONFactory* j = new JSONFactory(input_json);
 
     std::vector<std::string> signals = j->GetSigProcs();
@@ -27,14 +45,56 @@ int main(int argc, char** argv) {
     // regenerate datacard directories
     fs::path dir_path = datacard_dir;
     fs::remove_all(dir_path);
+    for (const auto& s : signals) fs::create_directories(datacard_dir + "/" + s);
+
+    // bins, Asimov observation, background list and rates: once for all signal points
+    std::cout << "Building fit inputs\n";
+    const FitInputs inputs = BuildFit().PrepareInputs(j);
+
+    // one harvester per signal point on a worker pool; logs are printed in signal order
+    nThreads = std::min<unsigned>(nThreads, std::max<size_t>(1, signals.size()));
+    std::cout << "Writing " << signals.size() << " datacards on " << nThreads << " threads\n";
+    std::vector<std::string> logs(signals.size());
+    std::vector<char> done(signals.size(), 0);
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::mutex m;
+    std::condition_variable cv;
+
+    auto worker = [&]() {
+        for (size_t i = next++; i < signals.size(); i = next++) {
+            std::ostringstream log;
+            try {
+                BuildFit BF;
+                BF.BuildAsimovFit(inputs, signals[i], datacard_dir, log);
+            } catch (const std::exception& e) {
+                log << "[BF] ERROR for " << signals[i] << ": " << e.what() << "\n";
+                failed = true;
+            } catch (...) {
+                // anything else too: the ordered writer waits for every slot
+                log << "[BF] ERROR for " << signals[i] << ": unknown exception\n";
+                failed = true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(m);
+                logs[i] = log.str();
+                done[i] = 1;
+            }
+            cv.notify_one();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < nThreads; ++t) pool.emplace_back(worker);
 
-    for (long unsigned int i = 0; i < signals.size(); i++) {
-        BuildFit* BF = new BuildFit();
-        fs::create_directories(datacard_dir + "/" + signals[i]);
-        BF->BuildAsimovFit(j, signals[i], datacard_dir);
-	delete BF;
+    // ordered writer
+    for (size_t i = 0; i < signals.size(); ++i) {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&] { return done[i] != 0; });
+        std::cout << logs[i];
+        logs[i].clear();
     }
+    for (auto& t : pool) t.join();
 
     delete j; // clean up
-    return 0;
+    return failed ? 1 : 0;
 }
@@ -39,6 +39,7 @@ std::map<std::string, float> BuildFit::BuildAsimovData(JSONFactory* j){
 }
 std::vector<std::string> BuildFit::GetBkgProcs(JSONFactory* j){
 	std::vector<std::string> bkgprocs{};
+	std::set<std::string> seen{}; //listed once per bin, keep the first occurrence
 
 	for (json::iterator it = j->j.begin(); it != j->j.end(); ++it){
                 //inner loop process iterator
@@ -48,7 +49,7 @@ std::vector<std::string> BuildFit::GetBkgProcs(JSONFactory* j){
                         if( BFTool::ContainsAnySubstring( it2.key(), sigkeys)){
                                 continue;
                         }
-                        else{
+                        else if( seen.insert(it2.key()).second ){
 				bkgprocs.push_back(it2.key());
 			}
 		}
@@ -80,32 +81,53 @@ std::vector<std::string> BuildFit::GetBinSet( JSONFactory* j){
 
 }
 
+FitInputs BuildFit::PrepareInputs(JSONFactory* j){
+	FitInputs in(j->j);
+	const YieldTable& t = in.table;
+	for( uint32_t b = 0; b < t.NBins(); b++ ){
+		in.cats.push_back( {int(b), t.Bin(b)} );
+		in.binset.push_back( t.Bin(b) );
+		//Asimov data: total background, summed in JSON order
+		float totalBkg = 0;
+		for( uint32_t p : t.ProcsIn(b) ){
+			if( !BFTool::ContainsAnySubstring( t.Proc(p), sigkeys) ) totalBkg += t.Rate(b, p);
+		}
+		in.obs.push_back( float(int(totalBkg)) );
+	}
+	for( uint32_t p = 0; p < t.NProcs(); p++ ){
+		if( !BFTool::ContainsAnySubstring( t.Proc(p), sigkeys) ) in.bkgprocs.push_back( t.Proc(p) );
+	}
+	return in;
+}
+
 void BuildFit::BuildAsimovFit(JSONFactory* j, std::string signalPoint, std::string datacard_dir){
-	ch::Categories cats = BuildCats(j);
-	std::cout<<"building obs rates \n";
-	std::map<std::string, float> obs_rates = BuildAsimovData(j);
-	std::cout<<"Getting process list\n";
-	std::vector<std::string> bkgprocs = GetBkgProcs(j);
-	std::cout<<"Parse Signal point\n";
+	BuildAsimovFit(PrepareInputs(j), signalPoint, datacard_dir);
+}
+
+void BuildFit::BuildAsimovFit(const FitInputs& in, const std::string& signalPoint, const std::string& datacard_dir, std::ostream& log){
+	log<<"Parse Signal point "<<signalPoint<<"\n";
 	std::vector<std::string> signalDetails = ExtractSignalDetails( signalPoint);
-	std::cout<<"Build cb objects\n";
+	log<<"Build cb objects\n";
 	//cb.SetVerbosity(3);
-	cb.AddObservations({"*"}, {signalDetails[0]}, {"13.6TeV"}, {signalDetails[1]}, cats);
-	cb.AddProcesses(   {"*"}, {signalDetails[0]}, {"13.6TeV"}, {signalDetails[1]}, bkgprocs, cats, false);
-	cb.AddProcesses(   {signalDetails[2]}, {signalDetails[0]}, {"13.6Tev"}, {signalDetails[1]}, {signalPoint}, cats, true);
+	cb.AddObservations({"*"}, {signalDetails[0]}, {"13.6TeV"}, {signalDetails[1]}, in.cats);
+	cb.AddProcesses(   {"*"}, {signalDetails[0]}, {"13.6TeV"}, {signalDetails[1]}, in.bkgprocs, in.cats, false);
+	cb.AddProcesses(   {signalDetails[2]}, {signalDetails[0]}, {"13.6Tev"}, {signalDetails[1]}, {signalPoint}, in.cats, true);
+	//bin_id is the table's bin index (see PrepareInputs)
 	cb.ForEachObs([&](ch::Observation *x){
-		x->set_rate(obs_rates[x->bin()]);
+		x->set_rate(size_t(x->bin_id()) < in.obs.size() ? in.obs[x->bin_id()] : 0.f);
 	});
-	cb.ForEachProc([&j](ch::Process *x) {
-	    //std::cout<<x->bin()<<" "<<x->process()<<"\n";
-	    json json_array = j->j[x->bin()][x->process()];
-	    x->set_rate(json_array[1].get<float>());
+	cb.ForEachProc([&](ch::Process *x) {
+		const uint32_t p = in.table.ProcIndex(x->process());
+		if( in.table.Has(x->bin_id(), p) ) x->set_rate(in.table.Rate(x->bin_id(), p));
+		else{
+			log<<"[BF] WARNING: no yield for "<<x->process()<<" in bin "<<x->bin()<<", using 0\n";
+			x->set_rate(0.f);
+		}
 	});
 
-	std::vector<std::string> binset = GetBinSet(j);
-	cb.cp().bin(binset).AddSyst(cb, "DummySys", "lnN", SystMap<>::init(1.10));
+	cb.cp().bin(in.binset).AddSyst(cb, "DummySys", "lnN", SystMap<>::init(1.10));
       
 	//cb.PrintAll();
 	cb.WriteDatacard(datacard_dir+"/"+signalPoint+"/"+signalPoint+".txt");
-
-}	
+	log<<"Wrote "<<datacard_dir<<"/"<<signalPoint<<"/"<<signalPoint<<".txt\n";
+}
@@ -1,4 +1,11 @@
 #include "BuildFitInput.h"
+#include "LeptonPairKernel.h"
+#include "CutCache.h"
+#include "FilterTrie.h"
+#include "PredicateProfile.h"
+#include "ZoneMap.h"
+#include "SkimTools.h"
+#include <stdexcept>
 
 BuildFitInput::BuildFitInput(){
 }
@@ -7,7 +14,7 @@ void BuildFitInput::LoadBkg_KeyValue(const std::string& key, const stringlist& b
     for (unsigned int i = 0; i < bkglist.size(); i++) {
         std::string subkey = key + "_" + std::to_string(i);
 
-        ROOT::RDataFrame df("KUAnalysis", bkglist[i]);
+        ROOT::RDataFrame df = OpenSample(bkglist[i], "KUAnalysis", subkey);
 
         // Define scaled weight (w * Lumi) and squared weight
         auto df_scaled = df
@@ -15,15 +22,8 @@ void BuildFitInput::LoadBkg_KeyValue(const std::string& key, const stringlist& b
             .Define("weight_sq_scaled", [Lumi](double w2){ return w2 * Lumi * Lumi; }, {"weight2"});
 
 
-        // Define lepton pair counts for all sides
-        //auto df_with_lep = df_scaled;  // debug temp
-        auto df_with_lep = DefineLeptonPairCounts(df_scaled, "");  // all
-        df_with_lep = DefineLeptonPairCounts(df_with_lep, "A");    // side A
-        df_with_lep = DefineLeptonPairCounts(df_with_lep, "B");    // side B
-
-        df_with_lep = DefinePairKinematics(df_with_lep, "");
-        df_with_lep = DefinePairKinematics(df_with_lep, "A");
-        df_with_lep = DefinePairKinematics(df_with_lep, "B");
+        // Define lepton pair columns for all sides (only the required ones after RequireColumns)
+        auto df_with_lep = DefineLeptonColumns(df_scaled);
 
         _base_rdf_BkgDict[subkey] = std::make_unique<RNode>(df_with_lep);
         rdf_BkgDict[subkey]       = std::make_unique<RNode>(df_with_lep);
@@ -46,7 +46,7 @@ void BuildFitInput::LoadSig_KeyValue(const std::string& key, const stringlist& s
         for (const auto& subkey : subkeys) {
             if (isSMS) tree_name = subkey;
 
-            ROOT::RDataFrame df(tree_name, siglist[i]);
+            ROOT::RDataFrame df = OpenSample(siglist[i], tree_name, subkey);
 
             // Define scaled weights
             auto df_scaled = df
@@ -54,15 +54,8 @@ void BuildFitInput::LoadSig_KeyValue(const std::string& key, const stringlist& s
                 .Define("weight_sq_scaled", [Lumi](double w){ return (w*Lumi)*(w*Lumi); }, {"weight"});
                 //.Define("weight_sq_scaled", [Lumi](double w2){ return w2 * Lumi * Lumi; }, {"weight2"});
 
-            // Define lepton pair counts for all sides
-            //auto df_with_lep = df_scaled;  // debug temp
-            auto df_with_lep = DefineLeptonPairCounts(df_scaled, "");  // all
-            df_with_lep = DefineLeptonPairCounts(df_with_lep, "A");    // side A
-            df_with_lep = DefineLeptonPairCounts(df_with_lep, "B");    // side B
-
-            df_with_lep = DefinePairKinematics(df_with_lep, "");
-            df_with_lep = DefinePairKinematics(df_with_lep, "A");
-            df_with_lep = DefinePairKinematics(df_with_lep, "B");
+            // Define lepton pair columns for all sides (only the required ones after RequireColumns)
+            auto df_with_lep = DefineLeptonColumns(df_scaled);
 
             _base_rdf_SigDict[subkey] = std::make_unique<RNode>(df_with_lep);
             rdf_SigDict[subkey]       = std::make_unique<RNode>(df_with_lep);
@@ -70,6 +63,56 @@ void BuildFitInput::LoadSig_KeyValue(const std::string& key, const stringlist& s
     }
 }
 
+// Path to read for `source`: its skim in skimDir when valid for the registered columns
+std::string BuildFitInput::ResolveSkim(const std::string& source, const std::string& tree, const std::string& subkey) {
+    if (skimDir.empty()) return source;
+    const std::string skimPath = SkimPathFor(skimDir, source);
+    SkimInfo info;
+    std::string why = "no provenance for tree " + tree;
+    if (!lazyColumns_) why = "columns in use unknown (call RequireColumns before loading)";
+    else if (ReadSkimInfo(skimPath, tree, info) && SkimUsable(info, source, requiredColumns_, nullptr, why)) {
+        std::cout << "[BuildFitInput] Reading skim " << skimPath << " for " << subkey << "\n";
+        skimPreselection_[subkey] = info.preselection;
+        return skimPath;
+    }
+    std::cout << "[BuildFitInput] Not using skim " << skimPath << ": " << why << "\n";
+    return source;
+}
+
+void BuildFitInput::PruneClustersFor(const std::vector<stringlist>& binCuts) {
+    zoneBins_.clear();
+    for (const auto& cuts : binCuts) {
+        stringlist expanded;
+        for (const auto& c : cuts) expanded.push_back(ExpandMacros(c));
+        zoneBins_.push_back(FilterTrie::Atoms(expanded));
+    }
+}
+
+// Dataframe of `tree` in `source`: its skim when valid, otherwise the source restricted to the
+// clusters in which some PruneClustersFor bin may pass
+ROOT::RDataFrame BuildFitInput::OpenSample(const std::string& source, const std::string& tree, const std::string& subkey) {
+    const std::string path = ResolveSkim(source, tree, subkey);
+    if (profileSource_.second.empty()) profileSource_ = {tree, path};
+    ZoneMap zm;
+    std::string why;
+    if (path == source && !zoneBins_.empty() && !skimDir.empty() &&
+        ReadZoneMap(ZoneMapPathFor(skimDir, source), tree, zm)) {
+        if (!ZoneMapCurrent(zm, source, tree, why)) {
+            std::cout << "[BuildFitInput] Not using the zone map of " << subkey << ": " << why << "\n";
+            return ROOT::RDataFrame(tree, path);
+        }
+        const auto keep = zm.Keep(zoneBins_);
+        const long long kept = zm.KeptEntries(keep);
+        std::cout << "[BuildFitInput] Zone map: reading " << kept << " / " << zm.entries << " entries of " << subkey << "\n";
+        if (kept < zm.entries) {
+            auto pruned = std::make_shared<ZonePrunedTree>(zm, keep, tree, source);
+            zonePruned_[subkey] = pruned;
+            return ROOT::RDataFrame(*pruned->chain);
+        }
+    }
+    return ROOT::RDataFrame(tree, path);
+}
+
 void BuildFitInput::LoadBkg_byMap( map< std::string, stringlist>& BkgDict, const double& Lumi){
     
     for (const auto& pair : BkgDict) {
@@ -93,143 +136,224 @@ inline bool ColumnExists(ROOT::RDF::RNode rdf, const std::string& name) {
 }
 
 // -----------------------------------------------------------------------------
-// DefinePairKinematics: create side-specific kinematic vectors and per-pair
-// Mass_... and DeltaR_... RVecs for each pair-vector produced by DefineLeptonPairCounts.
+// Lepton pair columns. One fused kernel per side (LepPairs_All / LepPairs_A /
+// LepPairs_B) scans the leptons once per event and fills a per-slot
+// LepPairSummary (see LeptonPairKernel.h); every per-side column below is a
+// zero-copy view into it.
 // -----------------------------------------------------------------------------
-ROOT::RDF::RNode BuildFitInput::DefinePairKinematics(ROOT::RDF::RNode rdf, const std::string& side) {
-    // Determine side-specific index branch
-    std::string indexBranch;
-    if (side == "A")      indexBranch = "index_lep_a_LEP"; // LEP only RJR tree
-    else if (side == "B") indexBranch = "index_lep_b_LEP"; // LEP only RJR tree
+struct LepSideNames {
+    std::string indexBranch; // "" => all leptons
+    std::string suffix;      // _All, _A, _B
+    std::string pairPrefix;  // All_, A_, B_
+    std::string kernelCol;
+};
+
+static LepSideNames GetLepSideNames(const std::string& side) {
+    LepSideNames n;
+    if (side == "A")      { n.indexBranch = "index_lep_a_LEP"; n.suffix = "_A";   n.pairPrefix = "A_"; } // LEP only RJR tree
+    else if (side == "B") { n.indexBranch = "index_lep_b_LEP"; n.suffix = "_B";   n.pairPrefix = "B_"; } // LEP only RJR tree
+    else                  { n.indexBranch = "";                n.suffix = "_All"; n.pairPrefix = "All_"; }
+    n.kernelCol = "LepPairs" + n.suffix;
+    return n;
+}
 
-    std::string sideSuffix = "";
-    std::string pairPrefix = "";
-    if (side == "A")      { sideSuffix = "_A"; pairPrefix = "A_"; }
-    else if (side == "B") { sideSuffix = "_B"; pairPrefix = "B_"; }
-    else                  { sideSuffix = "";    pairPrefix = "All_"; }
-
-    // 1) Define kinematic arrays
-    if (!indexBranch.empty()) {
-        if (!ColumnExists(rdf, "PT_lep" + sideSuffix))
-            rdf = rdf.Define("PT_lep" + sideSuffix,
-                             [=](const std::vector<double>& pt_all, const std::vector<int>& idx) {
-                                 ROOT::RVec<double> out(idx.size());
-                                 for (size_t i = 0; i < idx.size(); ++i) out[i] = pt_all[idx[i]];
-                                 return out;
-                             }, {"PT_lep", indexBranch});
-
-        if (!ColumnExists(rdf, "Eta_lep" + sideSuffix))
-            rdf = rdf.Define("Eta_lep" + sideSuffix,
-                             [=](const std::vector<double>& eta_all, const std::vector<int>& idx) {
-                                 ROOT::RVec<double> out(idx.size());
-                                 for (size_t i = 0; i < idx.size(); ++i) out[i] = eta_all[idx[i]];
-                                 return out;
-                             }, {"Eta_lep", indexBranch});
-
-        if (!ColumnExists(rdf, "Phi_lep" + sideSuffix))
-            rdf = rdf.Define("Phi_lep" + sideSuffix,
-                             [=](const std::vector<double>& phi_all, const std::vector<int>& idx) {
-                                 ROOT::RVec<double> out(idx.size());
-                                 for (size_t i = 0; i < idx.size(); ++i) out[i] = phi_all[idx[i]];
-                                 return out;
-                             }, {"Phi_lep", indexBranch});
-
-        if (!ColumnExists(rdf, "M_lep" + sideSuffix))
-            rdf = rdf.Define("M_lep" + sideSuffix,
-                             [=](const std::vector<double>& m_all, const std::vector<int>& idx) {
-                                 ROOT::RVec<double> out(idx.size());
-                                 for (size_t i = 0; i < idx.size(); ++i) out[i] = m_all[idx[i]];
-                                 return out;
-                             }, {"M_lep", indexBranch});
-    } else {
-        // Only define _All branches if they don't exist yet
-        if (!ColumnExists(rdf, "PT_lep_All"))
-            rdf = rdf.Define("PT_lep_All",
-                             [](const std::vector<double>& v) { return ROOT::RVec<double>(v.begin(), v.end()); },
-                             {"PT_lep"});
-
-        if (!ColumnExists(rdf, "Eta_lep_All"))
-            rdf = rdf.Define("Eta_lep_All",
-                             [](const std::vector<double>& v) { return ROOT::RVec<double>(v.begin(), v.end()); },
-                             {"Eta_lep"});
-
-        if (!ColumnExists(rdf, "Phi_lep_All"))
-            rdf = rdf.Define("Phi_lep_All",
-                             [](const std::vector<double>& v) { return ROOT::RVec<double>(v.begin(), v.end()); },
-                             {"Phi_lep"});
-
-        if (!ColumnExists(rdf, "M_lep_All"))
-            rdf = rdf.Define("M_lep_All",
-                             [](const std::vector<double>& v) { return ROOT::RVec<double>(v.begin(), v.end()); },
-                             {"M_lep"});
+// Parts of the kernel a set of per-side columns depends on. Without kinematics the
+// PT/Eta/Phi/M_lep branches are not read at all; without pairs the i<j loop is skipped.
+struct LepKernelMode {
+    bool pairs = true;
+    bool kinematics = true;
+};
+
+static ROOT::RDF::RNode DefineLepPairKernel(ROOT::RDF::RNode rdf, const LepSideNames& n, LepKernelMode mode = {}) {
+    if (ColumnExists(rdf, n.kernelCol)) return rdf;
+    // one summary per slot; the column value points into it
+    auto store = std::make_shared<std::vector<LepPairSummary>>(rdf.GetNSlots());
+    const bool pairs = mode.pairs;
+    stringlist cols = {"PDGID_lep", "Charge_lep", "LepQual_lep"};
+    if (mode.kinematics) {
+        cols.insert(cols.end(), {"PT_lep", "Eta_lep", "Phi_lep", "M_lep"});
+        if (n.indexBranch.empty()) {
+            return rdf.DefineSlot(n.kernelCol,
+                [store, pairs](unsigned int slot, const std::vector<int>& pdgid, const std::vector<int>& charge, const std::vector<int>& qual,
+                               const std::vector<double>& pt, const std::vector<double>& eta, const std::vector<double>& phi,
+                               const std::vector<double>& m) -> const LepPairSummary* {
+                    LepPairSummary& s = (*store)[slot];
+                    FillLepPairSummary(s, pdgid, charge, qual, &pt, &eta, &phi, &m, nullptr, pairs);
+                    return &s;
+                }, cols);
+        }
+        cols.push_back(n.indexBranch);
+        return rdf.DefineSlot(n.kernelCol,
+            [store, pairs](unsigned int slot, const std::vector<int>& pdgid, const std::vector<int>& charge, const std::vector<int>& qual,
+                           const std::vector<double>& pt, const std::vector<double>& eta, const std::vector<double>& phi,
+                           const std::vector<double>& m, const std::vector<int>& idx) -> const LepPairSummary* {
+                LepPairSummary& s = (*store)[slot];
+                FillLepPairSummary(s, pdgid, charge, qual, &pt, &eta, &phi, &m, &idx, pairs);
+                return &s;
+            }, cols);
     }
+    if (n.indexBranch.empty()) {
+        return rdf.DefineSlot(n.kernelCol,
+            [store, pairs](unsigned int slot, const std::vector<int>& pdgid, const std::vector<int>& charge,
+                           const std::vector<int>& qual) -> const LepPairSummary* {
+                LepPairSummary& s = (*store)[slot];
+                FillLepPairSummary(s, pdgid, charge, qual, nullptr, nullptr, nullptr, nullptr, nullptr, pairs);
+                return &s;
+            }, cols);
+    }
+    cols.push_back(n.indexBranch);
+    return rdf.DefineSlot(n.kernelCol,
+        [store, pairs](unsigned int slot, const std::vector<int>& pdgid, const std::vector<int>& charge,
+                       const std::vector<int>& qual, const std::vector<int>& idx) -> const LepPairSummary* {
+            LepPairSummary& s = (*store)[slot];
+            FillLepPairSummary(s, pdgid, charge, qual, nullptr, nullptr, nullptr, nullptr, &idx, pairs);
+            return &s;
+        }, cols);
+}
+
+// Define `name` as a view of the RVec returned by get(summary), unless it already exists
+template <typename T, typename Getter>
+static ROOT::RDF::RNode DefineLepView(ROOT::RDF::RNode rdf, const std::string& name, const std::string& kernelCol, Getter get) {
+    if (ColumnExists(rdf, name)) return rdf;
+    return rdf.Define(name, [get](const LepPairSummary* s) -> ROOT::RVec<T> { return LepPairView<T>(get(*s)); }, {kernelCol});
+}
 
-    // 2) For each pair-vector, define Mass and DeltaR
-    auto makeMassDeltaDefs = [](ROOT::RDF::RNode r,
-                                const std::string& pairVar,
-                                const std::string& ptVar,
-                                const std::string& etaVar,
-                                const std::string& phiVar,
-                                const std::string& mVar) -> ROOT::RDF::RNode {
-        if (!ColumnExists(r, "Mass_" + pairVar))
-            r = r.Define("Mass_" + pairVar,
-                         [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                             const ROOT::RVec<double>& pt,
-                             const ROOT::RVec<double>& eta,
-                             const ROOT::RVec<double>& phi,
-                             const ROOT::RVec<double>& m) {
-                             ROOT::RVec<double> out; out.reserve(pairs.size());
-                             for (size_t k = 0; k < pairs.size(); ++k) {
-                                 size_t i = pairs[k].first;
-                                 size_t j = pairs[k].second;
-                                 if (i >= pt.size() || j >= pt.size()) { out.push_back(0.0); continue; }
-                                 double px_i = pt[i]*std::cos(phi[i]);
-                                 double py_i = pt[i]*std::sin(phi[i]);
-                                 double pz_i = pt[i]*std::sinh(eta[i]);
-                                 double Ei   = std::sqrt(px_i*px_i + py_i*py_i + pz_i*pz_i + m[i]*m[i]);
-                                 double px_j = pt[j]*std::cos(phi[j]);
-                                 double py_j = pt[j]*std::sin(phi[j]);
-                                 double pz_j = pt[j]*std::sinh(eta[j]);
-                                 double Ej   = std::sqrt(px_j*px_j + py_j*py_j + pz_j*pz_j + m[j]*m[j]);
-                                 double E = Ei + Ej, px = px_i + px_j, py = py_i + py_j, pz = pz_i + pz_j;
-                                 double mass2 = E*E - (px*px + py*py + pz*pz);
-                                 out.push_back(mass2>0 ? std::sqrt(mass2) : 0.0);
-                             }
-                             return out;
-                         }, {pairVar, ptVar, etaVar, phiVar, mVar});
-
-        if (!ColumnExists(r, "DeltaR_" + pairVar))
-            r = r.Define("DeltaR_" + pairVar,
-                         [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                             const ROOT::RVec<double>& eta,
-                             const ROOT::RVec<double>& phi) {
-                             ROOT::RVec<double> out; out.reserve(pairs.size());
-                             for (size_t k = 0; k < pairs.size(); ++k) {
-                                 size_t i = pairs[k].first;
-                                 size_t j = pairs[k].second;
-                                 if (i >= eta.size() || j >= eta.size()) { out.push_back(0.0); continue; }
-                                 double deta = eta[i] - eta[j];
-                                 double dphi = phi[i] - phi[j];
-                                 while (dphi > M_PI) dphi -= 2.0*M_PI;
-                                 while (dphi <= -M_PI) dphi += 2.0*M_PI;
-                                 out.push_back(std::sqrt(deta*deta + dphi*dphi));
-                             }
-                             return out;
-                         }, {pairVar, etaVar, phiVar});
-
-        return r;
+// One per-side column: what it needs from the kernel, which of the two public
+// Define* calls provides it, and how to define it
+struct LepColumnSpec {
+    std::string name;
+    LepKernelMode needs;
+    bool inPairCounts;
+    bool inPairKinematics;
+    std::function<ROOT::RDF::RNode(ROOT::RDF::RNode)> define;
+};
+
+static std::vector<LepColumnSpec> GetLepColumnSpecs(const LepSideNames& n) {
+    typedef const ROOT::RVec<int>& (*IntGet)(const LepPairSummary&);
+    typedef const ROOT::RVec<double>& (*DblGet)(const LepPairSummary&);
+    const std::string k = n.kernelCol;
+    std::vector<LepColumnSpec> specs;
+    auto intView = [&](const std::string& name, IntGet get) {
+        specs.push_back({name, {false, false}, true, false,
+                         [=](ROOT::RDF::RNode rdf){ return DefineLepView<int>(rdf, name, k, get); }});
+    };
+    auto kinView = [&](const std::string& name, DblGet get) {
+        specs.push_back({name, {false, true}, true, true,
+                         [=](ROOT::RDF::RNode rdf){ return DefineLepView<double>(rdf, name, k, get); }});
     };
 
-    std::vector<std::string> pairTypes = {"OSSFPairs", "OSOFPairs", "SSSFPairs", "SSOFPairs"};
-    for (const auto &ptype : pairTypes) {
-        std::string pairVar = pairPrefix + ptype;
-        std::string ptVar   = "PT_lep" + sideSuffix;
-        std::string etaVar  = "Eta_lep" + sideSuffix;
-        std::string phiVar  = "Phi_lep" + sideSuffix;
-        std::string mVar    = "M_lep" + sideSuffix;
-        rdf = makeMassDeltaDefs(rdf, pairVar, ptVar, etaVar, phiVar, mVar);
+    // --- side-specific flattened vectors (flavour, charge, quality) and kinematics
+    intView("Flavor_lep"  + n.suffix, [](const LepPairSummary& s) -> const ROOT::RVec<int>& { return s.flavor; });
+    intView("Charge_lep"  + n.suffix, [](const LepPairSummary& s) -> const ROOT::RVec<int>& { return s.charge; });
+    intView("LepQual_lep" + n.suffix, [](const LepPairSummary& s) -> const ROOT::RVec<int>& { return s.qual; });
+    kinView("PT_lep"  + n.suffix, [](const LepPairSummary& s) -> const ROOT::RVec<double>& { return s.pt; });
+    kinView("Eta_lep" + n.suffix, [](const LepPairSummary& s) -> const ROOT::RVec<double>& { return s.eta; });
+    kinView("Phi_lep" + n.suffix, [](const LepPairSummary& s) -> const ROOT::RVec<double>& { return s.phi; });
+    kinView("M_lep"   + n.suffix, [](const LepPairSummary& s) -> const ROOT::RVec<double>& { return s.m; });
+
+    // --- index pairs (i<j), their counts, masses and deltaR for each pair class
+    for (int c = 0; c < kNLepPairClasses; ++c) {
+        const std::string cls = LepPairClassName(c);
+        const std::string pairVar = n.pairPrefix + cls + "Pairs";
+        const std::string numVar  = n.pairPrefix + "Num" + cls + "Pairs";
+        auto massGet = [c](const LepPairSummary& s) -> const ROOT::RVec<double>& { return s.mass[c]; };
+        auto dRGet   = [c](const LepPairSummary& s) -> const ROOT::RVec<double>& { return s.dR[c]; };
+
+        specs.push_back({pairVar, {true, false}, true, false, [=](ROOT::RDF::RNode rdf){
+            return DefineLepView<std::pair<int,int>>(rdf, pairVar, k,
+                       [c](const LepPairSummary& s) -> const ROOT::RVec<std::pair<int,int>>& { return s.pairs[c]; }); }});
+        specs.push_back({numVar, {true, false}, true, false, [=](ROOT::RDF::RNode rdf) -> ROOT::RDF::RNode {
+            if (ColumnExists(rdf, numVar)) return rdf;
+            return rdf.Define(numVar, [c](const LepPairSummary* s){ return s->count[c]; }, {k}); }});
+        specs.push_back({n.pairPrefix + cls + "PairMasses", {true, true}, true, false, [=](ROOT::RDF::RNode rdf){
+            return DefineLepView<double>(rdf, n.pairPrefix + cls + "PairMasses", k, massGet); }});
+        specs.push_back({n.pairPrefix + cls + "PairDR", {true, true}, true, false, [=](ROOT::RDF::RNode rdf){
+            return DefineLepView<double>(rdf, n.pairPrefix + cls + "PairDR", k, dRGet); }});
+        specs.push_back({"Mass_" + pairVar, {true, true}, false, true, [=](ROOT::RDF::RNode rdf){
+            return DefineLepView<double>(rdf, "Mass_" + pairVar, k, massGet); }});
+        specs.push_back({"DeltaR_" + pairVar, {true, true}, false, true, [=](ROOT::RDF::RNode rdf){
+            return DefineLepView<double>(rdf, "DeltaR_" + pairVar, k, dRGet); }});
     }
+    return specs;
+}
 
+// -----------------------------------------------------------------------------
+// DefinePairKinematics: side-specific kinematic vectors and per-pair
+// Mass_... and DeltaR_... RVecs for each pair class.
+// -----------------------------------------------------------------------------
+ROOT::RDF::RNode BuildFitInput::DefinePairKinematics(ROOT::RDF::RNode rdf, const std::string& side) {
+    const LepSideNames n = GetLepSideNames(side);
+    rdf = DefineLepPairKernel(rdf, n);
+    for (const auto& spec : GetLepColumnSpecs(n))
+        if (spec.inPairKinematics) rdf = spec.define(rdf);
+    return rdf;
+}
+
+// Identifiers in an expression that could name a column (string literals, member
+// accesses and numeric literals are skipped)
+std::set<std::string> BuildFitInput::ExpressionIdentifiers(const std::string& expr) {
+    std::set<std::string> ids;
+    size_t i = 0;
+    while (i < expr.size()) {
+        const char c = expr[i];
+        if (c == '"' || c == '\'') {
+            size_t j = i + 1;
+            while (j < expr.size() && expr[j] != c) j += (expr[j] == '\\') ? 2 : 1;
+            i = j + 1;
+        } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            size_t j = i;
+            while (j < expr.size() && (std::isalnum(static_cast<unsigned char>(expr[j])) || expr[j] == '_')) ++j;
+            if (i == 0 || expr[i-1] != '.') ids.insert(expr.substr(i, j - i));
+            i = j;
+        } else if (std::isdigit(static_cast<unsigned char>(c))) {
+            while (i < expr.size() && (std::isalnum(static_cast<unsigned char>(expr[i])) || expr[i] == '.' || expr[i] == '_')) ++i;
+        } else {
+            ++i;
+        }
+    }
+    return ids;
+}
+
+void BuildFitInput::RequireColumns(const stringlist& exprs) {
+    for (const auto& e : exprs) {
+        auto ids = ExpressionIdentifiers(ExpandMacros(e));
+        requiredColumns_.insert(ids.begin(), ids.end());
+    }
+    lazyColumns_ = true;
+}
+
+void BuildFitInput::RequireAllColumns() {
+    lazyColumns_ = false;
+    requiredColumns_.clear();
+}
+
+// -----------------------------------------------------------------------------
+// DefineLeptonColumns: per-side lepton columns for a freshly loaded dataframe.
+// After RequireColumns() only the columns named in the registered expressions
+// are defined, and a side's kernel is only booked (with just the stages those
+// columns use) when at least one of its columns is needed.
+// -----------------------------------------------------------------------------
+ROOT::RDF::RNode BuildFitInput::DefineLeptonColumns(ROOT::RDF::RNode rdf) {
+    const stringlist sides = {"", "A", "B"};
+    if (!lazyColumns_) {
+        for (const auto& side : sides) rdf = DefineLeptonPairCounts(rdf, side);
+        for (const auto& side : sides) rdf = DefinePairKinematics(rdf, side);
+        return rdf;
+    }
+    for (const auto& side : sides) {
+        const LepSideNames n = GetLepSideNames(side);
+        std::vector<LepColumnSpec> needed;
+        LepKernelMode mode{false, false};
+        for (auto& spec : GetLepColumnSpecs(n)) {
+            if (!requiredColumns_.count(spec.name)) continue;
+            mode.pairs      = mode.pairs      || spec.needs.pairs;
+            mode.kinematics = mode.kinematics || spec.needs.kinematics;
+            needed.push_back(std::move(spec));
+        }
+        if (needed.empty()) continue;
+        rdf = DefineLepPairKernel(rdf, n, mode);
+        for (const auto& spec : needed) rdf = spec.define(rdf);
+    }
     return rdf;
 }
 
@@ -437,355 +561,82 @@ std::string BuildFitInput::BuildLeptonCut(const std::string& shorthand_in, const
 }
 
 ROOT::RDF::RNode BuildFitInput::DefineLeptonPairCounts(ROOT::RDF::RNode rdf, const std::string& side) {
-    std::string indexBranch;
-    if (side == "A")      indexBranch = "index_lep_a_LEP"; // LEP only RJR tree
-    else if (side == "B") indexBranch = "index_lep_b_LEP"; // LEP only RJR tree
-    // else "" => all leptons
-
-    // --- define side-specific flattened vectors (flavour, charge, quality)
-    if (!indexBranch.empty()) {
-        rdf = rdf.Define("Flavor_lep_" + side, [=](const std::vector<int>& pdgids, const std::vector<int>& idx){
-            ROOT::RVec<int> flavor(idx.size());
-            for (size_t ii = 0; ii < idx.size(); ++ii) flavor[ii] = (std::abs(pdgids[idx[ii]]) == 11 ? 0 : 1);
-            return flavor;
-        }, {"PDGID_lep", indexBranch});
-
-        rdf = rdf.Define("Charge_lep_" + side, [=](const std::vector<int>& charges, const std::vector<int>& idx){
-            ROOT::RVec<int> charge(idx.size());
-            for (size_t ii = 0; ii < idx.size(); ++ii) charge[ii] = charges[idx[ii]];
-            return charge;
-        }, {"Charge_lep", indexBranch});
-
-        rdf = rdf.Define("LepQual_lep_" + side, [=](const std::vector<int>& quals, const std::vector<int>& idx){
-            ROOT::RVec<int> qual(idx.size());
-            for (size_t ii = 0; ii < idx.size(); ++ii) qual[ii] = quals[idx[ii]];
-            return qual;
-        }, {"LepQual_lep", indexBranch});
-
-        // also expose kinematics for the side (needed to compute pair masses / dR)
-        rdf = rdf.Define("PT_lep_" + side, [=](const std::vector<double>& PT, const std::vector<int>& idx){
-            ROOT::RVec<double> v(idx.size());
-            for (size_t ii = 0; ii < idx.size(); ++ii) v[ii] = PT[idx[ii]];
-            return v;
-        }, {"PT_lep", indexBranch});
-
-        rdf = rdf.Define("Eta_lep_" + side, [=](const std::vector<double>& Eta, const std::vector<int>& idx){
-            ROOT::RVec<double> v(idx.size());
-            for (size_t ii = 0; ii < idx.size(); ++ii) v[ii] = Eta[idx[ii]];
-            return v;
-        }, {"Eta_lep", indexBranch});
-
-        rdf = rdf.Define("Phi_lep_" + side, [=](const std::vector<double>& Phi, const std::vector<int>& idx){
-            ROOT::RVec<double> v(idx.size());
-            for (size_t ii = 0; ii < idx.size(); ++ii) v[ii] = Phi[idx[ii]];
-            return v;
-        }, {"Phi_lep", indexBranch});
-
-        rdf = rdf.Define("M_lep_" + side, [=](const std::vector<double>& M, const std::vector<int>& idx){
-            ROOT::RVec<double> v(idx.size());
-            for (size_t ii = 0; ii < idx.size(); ++ii) v[ii] = M[idx[ii]];
-            return v;
-        }, {"M_lep", indexBranch});
-    }
-    else {
-        // alias existing branches to RVec types for consistency
-        rdf = rdf.Define("Flavor_lep_All", [](const std::vector<int>& pdgids){
-            ROOT::RVec<int> flavor(pdgids.size());
-            for (size_t i=0;i<pdgids.size();++i) flavor[i] = (std::abs(pdgids[i])==11 ? 0 : 1);
-            return flavor;
-        }, {"PDGID_lep"});
-
-        rdf = rdf.Define("Charge_lep_All", [](const std::vector<int>& charges){
-            return ROOT::RVec<int>(charges.begin(), charges.end());
-        }, {"Charge_lep"});
-
-        rdf = rdf.Define("LepQual_lep_All", [](const std::vector<int>& quals){
-            return ROOT::RVec<int>(quals.begin(), quals.end());
-        }, {"LepQual_lep"});
-
-        rdf = rdf.Define("PT_lep_All", [](const std::vector<double>& v){ return ROOT::RVec<double>(v.begin(), v.end()); }, {"PT_lep"});
-        rdf = rdf.Define("Eta_lep_All", [](const std::vector<double>& v){ return ROOT::RVec<double>(v.begin(), v.end()); }, {"Eta_lep"});
-        rdf = rdf.Define("Phi_lep_All", [](const std::vector<double>& v){ return ROOT::RVec<double>(v.begin(), v.end()); }, {"Phi_lep"});
-        rdf = rdf.Define("M_lep_All", [](const std::vector<double>& v){ return ROOT::RVec<double>(v.begin(), v.end()); }, {"M_lep"});
-    }
-
-    // --- helper: define pairs, pair masses and pair dR
-    auto definePairs = [&](ROOT::RDF::RNode rdf,
-                           const std::string& flavorVar,
-                           const std::string& chargeVar,
-                           const std::string& ptVar,
-                           const std::string& etaVar,
-                           const std::string& phiVar,
-                           const std::string& mVar,
-                           const std::string& prefix) {
-
-        // returns vector of index pairs (i,j) (i<j) satisfying predicate
-        auto pairLambda = [](const ROOT::RVec<int>& f, const ROOT::RVec<int>& c, auto pred){
-            ROOT::RVec<std::pair<int,int>> pairs;
-            if (f.size() < 2) return pairs;
-            for (size_t i=0;i<f.size();++i)
-                for (size_t j=i+1;j<f.size();++j)
-                    if (pred(f[i], f[j], c[i], c[j]))
-                        pairs.emplace_back((int)i,(int)j);
-            return pairs;
-        };
-
-        // define the index-pairs columns
-        rdf = rdf.Define(prefix + "OSSFPairs", [=](const ROOT::RVec<int>& f, const ROOT::RVec<int>& c){
-            return pairLambda(f,c,[](int fi,int fj,int ci,int cj){ return fi==fj && ci!=cj; });
-        }, {flavorVar, chargeVar});
-
-        rdf = rdf.Define(prefix + "OSOFPairs", [=](const ROOT::RVec<int>& f, const ROOT::RVec<int>& c){
-            return pairLambda(f,c,[](int fi,int fj,int ci,int cj){ return fi!=fj && ci!=cj; });
-        }, {flavorVar, chargeVar});
-
-        rdf = rdf.Define(prefix + "SSSFPairs", [=](const ROOT::RVec<int>& f, const ROOT::RVec<int>& c){
-            return pairLambda(f,c,[](int fi,int fj,int ci,int cj){ return fi==fj && ci==cj; });
-        }, {flavorVar, chargeVar});
-
-        rdf = rdf.Define(prefix + "SSOFPairs", [=](const ROOT::RVec<int>& f, const ROOT::RVec<int>& c){
-            return pairLambda(f,c,[](int fi,int fj,int ci,int cj){ return fi!=fj && ci==cj; });
-        }, {flavorVar, chargeVar});
-
-        rdf = rdf.Define(prefix + "NumOSSFPairs", [=](const ROOT::RVec<std::pair<int,int>>& pairs){ return (int)pairs.size(); }, {prefix + "OSSFPairs"});
-        rdf = rdf.Define(prefix + "NumOSOFPairs", [=](const ROOT::RVec<std::pair<int,int>>& pairs){ return (int)pairs.size(); }, {prefix + "OSOFPairs"});
-        rdf = rdf.Define(prefix + "NumSSSFPairs", [=](const ROOT::RVec<std::pair<int,int>>& pairs){ return (int)pairs.size(); }, {prefix + "SSSFPairs"});
-        rdf = rdf.Define(prefix + "NumSSOFPairs", [=](const ROOT::RVec<std::pair<int,int>>& pairs){ return (int)pairs.size(); }, {prefix + "SSOFPairs"});
-
-        // --- define pair masses and deltaR for each pair index list
-        // Mass calculation using (E,p) from (pt,eta,phi,m)
-        rdf = rdf.Define(prefix + "OSSFPairMasses", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                       const ROOT::RVec<double>& pt,
-                                                       const ROOT::RVec<double>& eta,
-                                                       const ROOT::RVec<double>& phi,
-                                                       const ROOT::RVec<double>& mass) {
-            ROOT::RVec<double> masses; masses.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i = pr.first, j = pr.second;
-                // build 4-vectors (E, px, py, pz)
-                auto e = [&](double pt_, double eta_, double m_){
-                    double pz = pt_ * std::sinh(eta_);
-                    double p = std::sqrt(pt_*pt_ + pz*pz);
-                    return std::sqrt(p*p + m_*m_);
-                };
-                double Ei = e(pt[i], eta[i], mass[i]);
-                double Ej = e(pt[j], eta[j], mass[j]);
-                double pix = pt[i]*std::cos(phi[i]);
-                double piy = pt[i]*std::sin(phi[i]);
-                double piz = pt[i]*std::sinh(eta[i]);
-                double pjx = pt[j]*std::cos(phi[j]);
-                double pjy = pt[j]*std::sin(phi[j]);
-                double pjz = pt[j]*std::sinh(eta[j]);
-                double px = pix + pjx;
-                double py = piy + pjy;
-                double pz = piz + pjz;
-                double E = Ei + Ej;
-                double invm2 = E*E - (px*px + py*py + pz*pz);
-                masses.push_back(invm2 > 0. ? std::sqrt(invm2) : 0.);
-            }
-            return masses;
-        }, {prefix + "OSSFPairs", ptVar, etaVar, phiVar, mVar});
-
-        // deltaR
-        rdf = rdf.Define(prefix + "OSSFPairDR", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                   const ROOT::RVec<double>& eta,
-                                                   const ROOT::RVec<double>& phi){
-            ROOT::RVec<double> drs; drs.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i=pr.first, j=pr.second;
-                double dphi = std::abs(phi[i]-phi[j]);
-                if (dphi > M_PI) dphi = 2*M_PI - dphi;
-                double deta = eta[i] - eta[j];
-                drs.push_back(std::sqrt(deta*deta + dphi*dphi));
-            }
-            return drs;
-        }, {prefix + "OSSFPairs", etaVar, phiVar});
-
-        rdf = rdf.Define(prefix + "OSOFPairMasses", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                       const ROOT::RVec<double>& pt,
-                                                       const ROOT::RVec<double>& eta,
-                                                       const ROOT::RVec<double>& phi,
-                                                       const ROOT::RVec<double>& mass) {
-            ROOT::RVec<double> masses; masses.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i = pr.first, j = pr.second;
-                // build 4-vectors (E, px, py, pz)
-                auto e = [&](double pt_, double eta_, double m_){
-                    double pz = pt_ * std::sinh(eta_);
-                    double p = std::sqrt(pt_*pt_ + pz*pz);
-                    return std::sqrt(p*p + m_*m_);
-                };
-                double Ei = e(pt[i], eta[i], mass[i]);
-                double Ej = e(pt[j], eta[j], mass[j]);
-                double pix = pt[i]*std::cos(phi[i]);
-                double piy = pt[i]*std::sin(phi[i]);
-                double piz = pt[i]*std::sinh(eta[i]);
-                double pjx = pt[j]*std::cos(phi[j]);
-                double pjy = pt[j]*std::sin(phi[j]);
-                double pjz = pt[j]*std::sinh(eta[j]);
-                double px = pix + pjx;
-                double py = piy + pjy;
-                double pz = piz + pjz;
-                double E = Ei + Ej;
-                double invm2 = E*E - (px*px + py*py + pz*pz);
-                masses.push_back(invm2 > 0. ? std::sqrt(invm2) : 0.);
-            }
-            return masses;
-        }, {prefix + "OSOFPairs", ptVar, etaVar, phiVar, mVar});
-
-        // deltaR
-        rdf = rdf.Define(prefix + "OSOFPairDR", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                   const ROOT::RVec<double>& eta,
-                                                   const ROOT::RVec<double>& phi){
-            ROOT::RVec<double> drs; drs.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i=pr.first, j=pr.second;
-                double dphi = std::abs(phi[i]-phi[j]);
-                if (dphi > M_PI) dphi = 2*M_PI - dphi;
-                double deta = eta[i] - eta[j];
-                drs.push_back(std::sqrt(deta*deta + dphi*dphi));
-            }
-            return drs;
-        }, {prefix + "OSOFPairs", etaVar, phiVar});
-
-        rdf = rdf.Define(prefix + "SSOFPairMasses", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                       const ROOT::RVec<double>& pt,
-                                                       const ROOT::RVec<double>& eta,
-                                                       const ROOT::RVec<double>& phi,
-                                                       const ROOT::RVec<double>& mass) {
-            ROOT::RVec<double> masses; masses.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i = pr.first, j = pr.second;
-                // build 4-vectors (E, px, py, pz)
-                auto e = [&](double pt_, double eta_, double m_){
-                    double pz = pt_ * std::sinh(eta_);
-                    double p = std::sqrt(pt_*pt_ + pz*pz);
-                    return std::sqrt(p*p + m_*m_);
-                };
-                double Ei = e(pt[i], eta[i], mass[i]);
-                double Ej = e(pt[j], eta[j], mass[j]);
-                double pix = pt[i]*std::cos(phi[i]);
-                double piy = pt[i]*std::sin(phi[i]);
-                double piz = pt[i]*std::sinh(eta[i]);
-                double pjx = pt[j]*std::cos(phi[j]);
-                double pjy = pt[j]*std::sin(phi[j]);
-                double pjz = pt[j]*std::sinh(eta[j]);
-                double px = pix + pjx;
-                double py = piy + pjy;
-                double pz = piz + pjz;
-                double E = Ei + Ej;
-                double invm2 = E*E - (px*px + py*py + pz*pz);
-                masses.push_back(invm2 > 0. ? std::sqrt(invm2) : 0.);
-            }
-            return masses;
-        }, {prefix + "SSOFPairs", ptVar, etaVar, phiVar, mVar});
-
-        // deltaR
-        rdf = rdf.Define(prefix + "SSOFPairDR", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                   const ROOT::RVec<double>& eta,
-                                                   const ROOT::RVec<double>& phi){
-            ROOT::RVec<double> drs; drs.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i=pr.first, j=pr.second;
-                double dphi = std::abs(phi[i]-phi[j]);
-                if (dphi > M_PI) dphi = 2*M_PI - dphi;
-                double deta = eta[i] - eta[j];
-                drs.push_back(std::sqrt(deta*deta + dphi*dphi));
-            }
-            return drs;
-        }, {prefix + "SSOFPairs", etaVar, phiVar});
-
-        rdf = rdf.Define(prefix + "SSSFPairMasses", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                       const ROOT::RVec<double>& pt,
-                                                       const ROOT::RVec<double>& eta,
-                                                       const ROOT::RVec<double>& phi,
-                                                       const ROOT::RVec<double>& mass) {
-            ROOT::RVec<double> masses; masses.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i = pr.first, j = pr.second;
-                // build 4-vectors (E, px, py, pz)
-                auto e = [&](double pt_, double eta_, double m_){
-                    double pz = pt_ * std::sinh(eta_);
-                    double p = std::sqrt(pt_*pt_ + pz*pz);
-                    return std::sqrt(p*p + m_*m_);
-                };
-                double Ei = e(pt[i], eta[i], mass[i]);
-                double Ej = e(pt[j], eta[j], mass[j]);
-                double pix = pt[i]*std::cos(phi[i]);
-                double piy = pt[i]*std::sin(phi[i]);
-                double piz = pt[i]*std::sinh(eta[i]);
-                double pjx = pt[j]*std::cos(phi[j]);
-                double pjy = pt[j]*std::sin(phi[j]);
-                double pjz = pt[j]*std::sinh(eta[j]);
-                double px = pix + pjx;
-                double py = piy + pjy;
-                double pz = piz + pjz;
-                double E = Ei + Ej;
-                double invm2 = E*E - (px*px + py*py + pz*pz);
-                masses.push_back(invm2 > 0. ? std::sqrt(invm2) : 0.);
-            }
-            return masses;
-        }, {prefix + "SSSFPairs", ptVar, etaVar, phiVar, mVar});
-
-        // deltaR
-        rdf = rdf.Define(prefix + "SSSFPairDR", [=](const ROOT::RVec<std::pair<int,int>>& pairs,
-                                                   const ROOT::RVec<double>& eta,
-                                                   const ROOT::RVec<double>& phi){
-            ROOT::RVec<double> drs; drs.reserve(pairs.size());
-            for (const auto &pr : pairs) {
-                int i=pr.first, j=pr.second;
-                double dphi = std::abs(phi[i]-phi[j]);
-                if (dphi > M_PI) dphi = 2*M_PI - dphi;
-                double deta = eta[i] - eta[j];
-                drs.push_back(std::sqrt(deta*deta + dphi*dphi));
-            }
-            return drs;
-        }, {prefix + "SSSFPairs", etaVar, phiVar});
-
-        return rdf;
-    };
-
-    // invoke definePairs for either side-specific or All_
-    if (!indexBranch.empty()) {
-        rdf = definePairs(rdf,
-                          std::string("Flavor_lep_") + side,
-                          std::string("Charge_lep_") + side,
-                          std::string("PT_lep_") + side,
-                          std::string("Eta_lep_") + side,
-                          std::string("Phi_lep_") + side,
-                          std::string("M_lep_") + side,
-                          std::string(side + std::string("_")));
-    } else {
-        rdf = definePairs(rdf,
-                          "Flavor_lep_All",
-                          "Charge_lep_All",
-                          "PT_lep_All",
-                          "Eta_lep_All",
-                          "Phi_lep_All",
-                          "M_lep_All",
-                          "All_");
-    }
-
+    const LepSideNames n = GetLepSideNames(side);
+    rdf = DefineLepPairKernel(rdf, n);
+    for (const auto& spec : GetLepColumnSpecs(n))
+        if (spec.inPairCounts) rdf = spec.define(rdf);
     return rdf;
 }
 
 void BuildFitInput::FilterRegions(const std::string& filterName, const stringlist& filterCuts) {
-    std::string combinedCuts;
-    for (size_t i = 0; i < filterCuts.size(); ++i) {
-        if (i > 0) combinedCuts += " && ";
-        combinedCuts += filterCuts[i];
+    // one Filter per atomic predicate, shared with earlier bins of the same sample that start alike
+    stringlist expanded;
+    for (const auto& c : filterCuts) expanded.push_back(ExpandMacros(c));
+    stringlist predicates = FilterTrie::Atoms(expanded);
+    if (adaptiveOrderEvents > 0) RankPredicates(predicates);
+
+    // samples read from a skim only hold events passing its preselection
+    std::set<std::string> cutKeys;
+    for (const auto& c : filterCuts) cutKeys.insert(SkimCutKey(ExpandMacros(c)));
+    for (const auto& sp : skimPreselection_) {
+        for (const auto& p : sp.second) {
+            if (cutKeys.count(SkimCutKey(p))) continue;
+            std::cerr << "[BuildFitInput] WARNING: bin " << filterName << " does not apply the skim preselection \""
+                      << p << "\" of " << sp.first << "; its yields are incomplete\n";
+        }
     }
-    std::string fullCuts = ExpandMacros(combinedCuts);
 
+    // samples read through a zone map only hold the clusters the PruneClustersFor bins may pass
+    if (!zonePruned_.empty()) {
+        const std::set<std::string> have(predicates.begin(), predicates.end());
+        const bool covered = std::any_of(zoneBins_.begin(), zoneBins_.end(), [&](const stringlist& zb) {
+            return std::all_of(zb.begin(), zb.end(), [&](const std::string& p) { return have.count(p) > 0; });
+        });
+        if (!covered) {
+            std::cerr << "[BuildFitInput] ERROR: bin " << filterName << " does not apply all cuts of any PruneClustersFor bin; "
+                      << "its yields from the " << zonePruned_.size() << " zone-pruned samples would be incomplete\n";
+            throw std::runtime_error("FilterRegions: bin " + filterName + " is not covered by PruneClustersFor");
+        }
+    }
+
+    auto trieFor = [&](const std::string& key, RNode& base) -> FilterTrie& {
+        auto& trie = filterTries_[key];
+        if (!trie) trie = std::make_shared<FilterTrie>(base, cutCache, true);
+        return *trie;
+    };
     for (const auto& it : rdf_BkgDict) {
         bkg_filtered_dataframes[ std::make_pair(it.first, filterName) ] =
-            std::make_unique<RN>(it.second->Filter(fullCuts, filterName));
+            std::make_unique<RN>(trieFor("bkg:" + it.first, *it.second).Path(predicates));
     }
 
     for (const auto& it : rdf_SigDict) {
         sig_filtered_dataframes[ std::make_pair(it.first, filterName) ] =
-            std::make_unique<RN>(it.second->Filter(fullCuts, filterName));
+            std::make_unique<RN>(trieFor("sig:" + it.first, *it.second).Path(predicates));
+    }
+}
+
+// Sorts predicates cheapest-per-rejected-event first (FilterTrie::RankedOrder), profiling the movable
+// ones not seen yet on the first events of profileSource_; the ranks are kept so every bin and
+// sample uses the same order
+void BuildFitInput::RankPredicates(stringlist& predicates) {
+    stringlist unseen;
+    for (const auto& p : predicates) if (FilterTrie::Movable(p) && !predicateRanks_.count(p)) unseen.push_back(p);
+    if (!unseen.empty() && !profileSource_.second.empty()) {
+        // Range() needs a dataframe built without implicit MT
+        const bool mt = ROOT::IsImplicitMTEnabled();
+        if (mt) ROOT::DisableImplicitMT();
+        {
+            ROOT::RDataFrame df(profileSource_.first, profileSource_.second);
+            const auto ranks = PredicateRanks(unseen, ProfilePredicates(DefineLeptonColumns(df), unseen, adaptiveOrderEvents));
+            predicateRanks_.insert(ranks.begin(), ranks.end());
+            // not profiled (failed): keep the given order, without profiling again
+            for (const auto& p : unseen) predicateRanks_.emplace(p, std::numeric_limits<double>::max());
+        }
+        if (mt) ROOT::EnableImplicitMT();
     }
+    std::vector<stringlist> bin{predicates};
+    FilterTrie::RankedOrder(bin, predicateRanks_);
+    predicates = bin[0];
 }
 
 void BuildFitInput::RegisterMacro(const std::string& name, const std::string& expansion) {
@@ -804,13 +655,13 @@ std::string BuildFitInput::ExpandMacros(const std::string& expr) {
 void BuildFitInput::ReportRegions(int verbosity,
                                   countmap &countResults,
                                   summap &sumResults,
-                                  errormap &errorResults,
+                                  sumw2map &sumW2Results,
                   bool DoSig)
 {
 
     countResults.clear();
     sumResults.clear();
-    errorResults.clear();
+    sumW2Results.clear();
 
     auto processNodes = [&](auto& nodes){
         for (const auto& it : nodes){
@@ -824,7 +675,7 @@ void BuildFitInput::ReportRegions(int verbosity,
             // Extract values
             double count_val = static_cast<double>(*count_r);
             double sum_val   = sum_r.GetValue();
-            double error_val = std::sqrt(sumw2_r.GetValue());
+            double sumw2_val = sumw2_r.GetValue();
     
             // Convert string key to proc_cut_pair
             std::string strkey = it.first;
@@ -836,13 +687,13 @@ void BuildFitInput::ReportRegions(int verbosity,
             // Fill maps
             countResults[key] = count_val;
             sumResults[key]   = sum_val;
-            errorResults[key] = error_val;
+            sumW2Results[key] = sumw2_val;
     
             if (verbosity > 0){
                 std::cout << strkey << ":\n"
                           << "Count: " << count_val
                           << ", Sum: " << sum_val
-                          << ", Error: " << error_val << "\n\n";
+                          << ", Error: " << std::sqrt(sumw2_val) << "\n\n";
             }
         }
     };
@@ -856,6 +707,87 @@ void BuildFitInput::ReportRegions(int verbosity,
     }
 }
 
+void BuildFitInput::ReportRegionsBatched(int verbosity,
+                                         countmap &countResults, summap &sumResults, sumw2map &sumW2Results,
+                                         countmap &countResults_S, summap &sumResults_S, sumw2map &sumW2Results_S)
+{
+    countResults.clear();   sumResults.clear();   sumW2Results.clear();
+    countResults_S.clear(); sumResults_S.clear(); sumW2Results_S.clear();
+
+    struct Booked {
+        proc_cut_pair key;
+        bool isSig;
+        ROOT::RDF::RResultPtr<long long unsigned int> count;
+        ROOT::RDF::RResultPtr<double> sum, sumw2;
+    };
+    std::vector<Booked> booked;
+    std::vector<ROOT::RDF::RResultHandle> handles;
+
+    // Book everything first: each sample's bins hang off one graph, so one loop per file
+    auto bookNodes = [&](nodemap& nodes, bool isSig){
+        for (auto& it : nodes){
+            RNode& node = *(it.second);
+            Booked b{it.first, isSig, node.Count(), node.Sum<double>("weight_scaled"), node.Sum<double>("weight_sq_scaled")};
+            handles.emplace_back(b.count);
+            handles.emplace_back(b.sum);
+            handles.emplace_back(b.sumw2);
+            booked.push_back(std::move(b));
+        }
+    };
+    bookNodes(bkg_filtered_dataframes, false);
+    bookNodes(sig_filtered_dataframes, true);
+
+    std::cout << "Running " << booked.size() << " (process, bin) nodes ...\n";
+    // Runs the per-sample graphs concurrently when implicit MT is enabled
+    ROOT::RDF::RunGraphs(handles);
+
+    for (auto& b : booked){
+        double count_val = static_cast<double>(*b.count);
+        double sum_val   = *b.sum;
+        double sumw2_val = *b.sumw2;
+        (b.isSig ? countResults_S : countResults)[b.key] = count_val;
+        (b.isSig ? sumResults_S   : sumResults)[b.key]   = sum_val;
+        (b.isSig ? sumW2Results_S : sumW2Results)[b.key] = sumw2_val;
+
+        if (verbosity > 0){
+            std::cout << b.key.first << " " << b.key.second << ":\n"
+                      << "Count: " << count_val
+                      << ", Sum: " << sum_val
+                      << ", Error: " << std::sqrt(sumw2_val) << "\n\n";
+        }
+    }
+}
+
+void BuildFitInput::FillYieldCubes(const std::vector<CubeAxis>& axes, const stringlist& preselection,
+                                   std::map<std::string, YieldCube>& bkgCubes, std::map<std::string, YieldCube>& sigCubes){
+    // all axis values of an event in one column, so one action fills the whole cube
+    std::string valuesExpr = "ROOT::RVec<double>{";
+    for (size_t d = 0; d < axes.size(); ++d)
+        valuesExpr += (d ? ", " : "") + std::string("static_cast<double>(") + ExpandMacros(axes[d].expr) + ")";
+    valuesExpr += "}";
+
+    std::vector<std::pair<std::string, ROOT::RDF::RResultPtr<YieldCube>>> bkgBooked, sigBooked;
+    std::vector<ROOT::RDF::RResultHandle> handles;
+    auto book = [&](map< std::string, std::unique_ptr<RNode> >& dict, std::vector<std::pair<std::string, ROOT::RDF::RResultPtr<YieldCube>>>& out){
+        for (auto& it : dict){
+            RNode node = *(it.second);
+            for (const auto& cut : preselection) node = FilterExpr(node, ExpandMacros(cut), cutCache);
+            node = node.Define("yield_cube_values", valuesExpr);
+            auto cube = node.Book<ROOT::RVec<double>, double, double>(YieldCubeHelper(axes, node.GetNSlots()),
+                                                                    {"yield_cube_values", "weight_scaled", "weight_sq_scaled"});
+            handles.emplace_back(cube);
+            out.emplace_back(it.first, cube);
+        }
+    };
+    book(rdf_BkgDict, bkgBooked);
+    book(rdf_SigDict, sigBooked);
+
+    std::cout << "Filling " << handles.size() << " yield cubes over " << axes.size() << " axes ...\n";
+    ROOT::RDF::RunGraphs(handles);
+    for (auto& b : bkgBooked) bkgCubes[b.first] = *b.second;
+    for (auto& b : sigBooked) sigCubes[b.first] = *b.second;
+}
+
 void BuildFitInput::ReportRegions(int verbosity){
     std::cout<<"Reporting bkg nodes ...  \n";
     for (const auto& it : _base_rdf_BkgDict){
@@ -899,7 +831,7 @@ void BuildFitInput::PrintSumReports(const summap& sumResults) {
 
 void BuildFitInput::FullReport(const countmap& countResults,
                                const summap& sumResults,
-                               const errormap& errorResults) {
+                               const sumw2map& sumW2Results) {
 
     std::cout << "BkgKey RawEvt WtEvt Err\n";
 
@@ -908,7 +840,7 @@ void BuildFitInput::FullReport(const countmap& countResults,
         // Values are already double, no RResultPtr
         double count = it.second;          // countResults now stores double
         double sum   = sumResults.at(key); // sumResults stores double
-        double err   = errorResults.at(key);
+        double err   = std::sqrt(sumW2Results.at(key));
 
         std::cout << key.first << " " << key.second
                   << " " << count << " " << sum << " " << err
@@ -934,9 +866,6 @@ std::map<std::string, Process*> BuildFitInput::CombineBkgs( std::map<std::string
         combinedBkgProcs[procname]->Add(bkgProcs[it.first]);
         
     }
-    for( const auto& it: combinedBkgProcs){//loop back through and sqrt the errors
-        combinedBkgProcs[it.first]->FixError();
-    }
     return combinedBkgProcs;
 }
 
@@ -954,7 +883,7 @@ void BuildFitInput::CreateBin(const std::string& binName, const std::vector<std:
 
 void BuildFitInput::ConstructBkgBinObjects(countmap countResults,
                                            summap sumResults,
-                                           errormap errorResults)
+                                           sumw2map sumW2Results)
 {
     for (const auto& it : countResults) {
         proc_cut_pair cutpairkey = it.first;
@@ -964,7 +893,7 @@ void BuildFitInput::ConstructBkgBinObjects(countmap countResults,
         Process* thisproc = new Process(procname,
                                         countResults[cutpairkey],
                                         sumResults[cutpairkey],
-                                        errorResults[cutpairkey]);
+                                        sumW2Results[cutpairkey]);
         analysisbins[binname]->bkgProcs.insert({procname, thisproc});
     }
 
@@ -975,7 +904,7 @@ void BuildFitInput::ConstructBkgBinObjects(countmap countResults,
 
 void BuildFitInput::AddSigToBinObjects(countmap countResults,
                                        summap sumResults,
-                                       errormap errorResults,
+                                       sumw2map sumW2Results,
                                        std::map<std::string, Bin*>& analysisbins)
 {
     for (const auto& it : analysisbins) {
@@ -988,7 +917,7 @@ void BuildFitInput::AddSigToBinObjects(countmap countResults,
             Process* thisproc = new Process(procname,
                                             countResults[cutpairkey],
                                             sumResults[cutpairkey],
-                                            errorResults[cutpairkey]);
+                                            sumW2Results[cutpairkey]);
             analysisbins[binname]->signals.insert({procname, thisproc});
         }
     }
@@ -1000,17 +929,17 @@ void BuildFitInput::PrintBins(int verbosity){
         //loop over raw bkg procs
         if(verbosity >= 3){
             for(const auto& it2: it.second->bkgProcs ){
-                std::cout<<"   "<<it2.second->procname<<" "<< it2.second->nevents <<" "<<it2.second->wnevents<<" "<<it2.second->staterror<<"\n";
+                std::cout<<"   "<<it2.second->procname<<" "<< it2.second->nevents <<" "<<it2.second->wnevents<<" "<<it2.second->StatError()<<"\n";
             }
         }
         if(verbosity > 0){
             for(const auto& it2: it.second->combinedProcs){
-                std::cout<<"   "<< it2.second->procname<<" "<<it2.second->nevents <<" "<<it2.second->wnevents<<" "<<it2.second->staterror<<"\n";
+                std::cout<<"   "<< it2.second->procname<<" "<<it2.second->nevents <<" "<<it2.second->wnevents<<" "<<it2.second->StatError()<<"\n";
             }    
         }
         if(verbosity >= 1){
             for(const auto& it2: it.second->signals){
-                std::cout<<"   "<< it2.second->procname<<" "<<it2.second->nevents <<" "<<it2.second->wnevents<<" "<<it2.second->staterror<<"\n";
+                std::cout<<"   "<< it2.second->procname<<" "<<it2.second->nevents <<" "<<it2.second->wnevents<<" "<<it2.second->StatError()<<"\n";
             }    
         }
     }
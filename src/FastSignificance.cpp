@@ -0,0 +1,120 @@
+// src/FastSignificance.cpp
+// Expected significance (and optionally limits) for every signal point straight from the merged
+// yields, without writing datacards or running combine (see SignificanceTools.h for the model).
+// The output has the format of macro/CollectSignificance.py, so PlotSignificances.x reads it as is.
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+
+#include "JSONFactory.h"
+#include "YieldTable.h"
+#include "SignificanceTools.h"
+
+namespace fs = std::filesystem;
+
+static void usage(const char *me) {
+    std::cerr << "Usage: " << me << " [-o OUTPUT] [-j N] [--kappa K] [--per-bin FILE] [--limits FILE] INPUT\n";
+    std::cerr << "  INPUT          flattened yields (.json or .byf)\n";
+    std::cerr << "  -o, --output   '<signal> <Z>' lines (default: output/Significance_datacards_<input stem>.txt)\n";
+    std::cerr << "  -j, --threads  Threads over signal points (default: all cores)\n";
+    std::cerr << "  --kappa K      lnN on every process, as BF.x's DummySys (default 1.10)\n";
+    std::cerr << "  --per-bin FILE Also write '<signal> <bin> <Z>' for each bin on its own\n";
+    std::cerr << "  --limits FILE  Also write '<signal> <expected 95% CL limit on mu>'\n";
+}
+
+int main(int argc, char **argv) {
+    std::string input, output, perBinFile, limitsFile;
+    unsigned nThreads = 0;
+    double kappa = 1.10;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto next = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (a == "-o" || a == "--output") output = next();
+        else if (a == "-j" || a == "--threads") nThreads = std::atoi(next().c_str());
+        else if (a == "--kappa") kappa = std::atof(next().c_str());
+        else if (a == "--per-bin") perBinFile = next();
+        else if (a == "--limits") limitsFile = next();
+        else if (!a.empty() && a[0] == '-') { usage(argv[0]); return 1; }
+        else input = a;
+    }
+    if (input.empty() || kappa <= 0.) { usage(argv[0]); return 1; }
+    if (!fs::exists(input)) { std::cerr << "[FastSignificance] No such file " << input << "\n"; return 1; }
+    if (output.empty()) {
+        // same name CollectSignificance.py gives the datacards run_combine.py derives from the input
+        std::string stem = fs::path(input).stem().string();
+        if (stem.rfind("flattened_", 0) == 0) stem = stem.substr(10);
+        output = "output/Significance_datacards_" + stem + ".txt";
+    }
+
+    JSONFactory *j = new JSONFactory(input);
+    const YieldTable table(j->j);
+    const size_t nBins = table.NBins();
+
+    // dense signal x bin and bin arrays; background is everything not matching the signal keys
+    std::vector<uint32_t> sigIdx;
+    for (uint32_t p = 0; p < table.NProcs(); ++p)
+        if (BFTool::ContainsAnySubstring(table.Proc(p), j->sigkeys)) sigIdx.push_back(p);
+    std::vector<double> bkg(nBins, 0.), sig(sigIdx.size() * nBins, 0.);
+    for (uint32_t b = 0; b < nBins; ++b)
+        for (uint32_t p : table.ProcsIn(b))
+            if (!BFTool::ContainsAnySubstring(table.Proc(p), j->sigkeys)) bkg[b] += table.Rate(b, p);
+    for (size_t s = 0; s < sigIdx.size(); ++s)
+        for (uint32_t b = 0; b < nBins; ++b)
+            sig[s * nBins + b] = table.Has(b, sigIdx[s]) ? table.Rate(b, sigIdx[s]) : 0.;
+    delete j;
+    if (sigIdx.empty()) { std::cerr << "[FastSignificance] No signal processes in " << input << "\n"; return 2; }
+
+    const bool perBin = !perBinFile.empty(), limits = !limitsFile.empty();
+    std::vector<double> Z(sigIdx.size()), ZBin(perBin ? sig.size() : 0), mu(limits ? sigIdx.size() : 0);
+    if (nThreads == 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min<unsigned>(nThreads, sigIdx.size());
+    std::atomic<size_t> nextSig{0};
+    auto worker = [&]() {
+        for (size_t s = nextSig++; s < sigIdx.size(); s = nextSig++) {
+            const double *row = &sig[s * nBins];
+            Z[s] = SigTools::ExpectedZ(row, bkg.data(), nBins, kappa);
+            if (limits) mu[s] = SigTools::ExpectedLimit(row, bkg.data(), nBins, kappa);
+            if (perBin)
+                for (size_t b = 0; b < nBins; ++b)
+                    ZBin[s * nBins + b] = SigTools::ExpectedZ(row + b, bkg.data() + b, 1, kappa);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < nThreads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto &th : pool) th.join();
+
+    auto openOut = [](const std::string &path, std::ofstream &ofs) {
+        const fs::path parent = fs::path(path).parent_path();
+        if (!parent.empty()) fs::create_directories(parent);
+        ofs.open(path);
+        if (!ofs) std::cerr << "[FastSignificance] Cannot write " << path << "\n";
+        return bool(ofs);
+    };
+    std::ofstream ofs;
+    if (!openOut(output, ofs)) return 3;
+    for (size_t s = 0; s < sigIdx.size(); ++s) {
+        ofs << table.Proc(sigIdx[s]) << " " << Z[s] << "\n";
+        std::cout << table.Proc(sigIdx[s]) << " " << Z[s] << "\n";
+    }
+    if (perBin) {
+        std::ofstream pb;
+        if (!openOut(perBinFile, pb)) return 3;
+        for (size_t s = 0; s < sigIdx.size(); ++s)
+            for (uint32_t b = 0; b < nBins; ++b)
+                pb << table.Proc(sigIdx[s]) << " " << table.Bin(b) << " " << ZBin[s * nBins + b] << "\n";
+    }
+    if (limits) {
+        std::ofstream lim;
+        if (!openOut(limitsFile, lim)) return 3;
+        for (size_t s = 0; s < sigIdx.size(); ++s) lim << table.Proc(sigIdx[s]) << " " << mu[s] << "\n";
+    }
+    std::cout << "[FastSignificance] " << sigIdx.size() << " signal points x " << nBins << " bins -> " << output << "\n";
+    return 0;
+}
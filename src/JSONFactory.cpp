@@ -9,16 +9,27 @@ JSONFactory::JSONFactory(std::map<std::string, Bin*> analysisbins){
 		std::map<std::string, Process* > signals = it.second->signals;
 		for(const auto& it2: combinedprocs ){
 			std::string procname = it2.first;
-			j[binname][procname] = { it2.second->nevents, it2.second->wnevents, it2.second->staterror };
+			j[binname][procname] = { it2.second->nevents, it2.second->wnevents, it2.second->StatError(), it2.second->sumw2 };
 		}
 		for(const auto& it2: signals){
 			std::string procname = it2.first;
-			j[binname][procname] = { it2.second->nevents, it2.second->wnevents, it2.second->staterror };
+			j[binname][procname] = { it2.second->nevents, it2.second->wnevents, it2.second->StatError(), it2.second->sumw2 };
 		}
 	}
 }
 
 JSONFactory::JSONFactory(std::string filename){
+	// binary yields (.byf) are read through mmap, JSON is parsed
+	if( YieldBinary::IsBinary(filename) ){
+		YieldBinary yb;
+		if( !yb.Open(filename) ){
+			// like a JSON parse error: an empty table would give empty datacards
+			std::cerr << "[JSONFactory] ERROR: cannot read binary yields " << filename << std::endl;
+			throw std::runtime_error("cannot read binary yields " + filename);
+		}
+		j = yb.ToFlatJSON();
+		return;
+	}
 	std::ifstream ifs(filename);
 	j = json::parse(ifs);
 
@@ -26,13 +37,14 @@ JSONFactory::JSONFactory(std::string filename){
 
 std::vector<std::string> JSONFactory::GetSigProcs(){
         std::vector<std::string> sigprocs{};
+        std::set<std::string> seen{}; //a signal appears once per bin, keep its first occurrence
 
         for (json::iterator it = j.begin(); it != j.end(); ++it){
                 //inner loop process iterator
                 std::string binname = it.key();
                 for (json::iterator it2 = it.value().begin(); it2 != it.value().end(); ++it2){
                 //      std::cout<< it2.key()<<"\n";
-                        if( BFTool::ContainsAnySubstring( it2.key(), sigkeys)){
+                        if( BFTool::ContainsAnySubstring( it2.key(), sigkeys) && seen.insert(it2.key()).second ){
                                 sigprocs.push_back(it2.key());
                         }
                 }
@@ -42,6 +54,12 @@ std::vector<std::string> JSONFactory::GetSigProcs(){
 
 void JSONFactory::WriteJSON(std::string filename){
 	std::cout<<"Writing json "<<filename<<" ... \n";
+	if( filename.size() > 4 && filename.compare(filename.size()-4, 4, ".byf") == 0 ){
+		YieldBinary yb;
+		yb.FromFlatJSON(j);
+		if( !yb.Write(filename) ) std::cerr << "Error: Could not open file for writing." << std::endl;
+		return;
+	}
 	std::ofstream outputFile(filename);
 	if (outputFile.is_open()) {
     	outputFile << j.dump(4); // Writes with 4-space indentation
@@ -30,6 +30,18 @@ int main(int argc, char* argv[]) {
     vector<TH1*> all_clones;
     set<string> uniqueBinNames;
 
+    // background sums per group from mergeHists.x --totals
+    map<string,TH1*> bkgTotals;
+    if(TDirectory* totalsDir = inFile->GetDirectory("totals")){
+        TIter nextTotal(totalsDir->GetListOfKeys());
+        while(TKey* tkey=(TKey*)nextTotal()){
+            TH1* h = dynamic_cast<TH1*>(tkey->ReadObj());
+            if(!h) continue;
+            h->SetDirectory(0);
+            bkgTotals[tkey->GetName()] = h;
+        }
+    }
+
     TIter next(inFile->GetListOfKeys());
     TKey* key;
     while((key=(TKey*)next())){
@@ -117,6 +129,7 @@ int main(int argc, char* argv[]) {
         vector<TH1*> bkgHists, sigHists;
         vector<string> bkgProcs, sigProcs;
         TH1* dataHist = nullptr;
+        const SampleCatalog &catalog = SampleCatalog::Instance();
         
         for(auto &pp : procmap){
             TH1* h = pp.second;
@@ -124,12 +137,11 @@ int main(int argc, char* argv[]) {
             const string& proc = pp.first;
         
             if(proc=="data"||proc=="Data") { dataHist = h; continue; }
-            if(tool.BkgDict.count(proc)) {
+            if(catalog.IsBackground(proc)) {
                 bkgHists.push_back(h); 
                 bkgProcs.push_back(proc); 
             }
-            else if(find(tool.SignalKeys.begin(), tool.SignalKeys.end(), proc) != tool.SignalKeys.end() 
-                || proc.find("SMS") != std::string::npos || proc.find("Cascades") != std::string::npos) {
+            else if(catalog.IsSignal(proc)) {
               sigHists.push_back(h); sigProcs.push_back(proc); 
             }
         }
@@ -159,14 +171,14 @@ int main(int argc, char* argv[]) {
             if(!bkgHists.empty() || !sigHists.empty() || dataHist){
                 if(groupKey.find("num__")!=string::npos || groupKey.find("den__")!=string::npos) continue; // don't stack efficiency inputs
                 if(bkgHists[0]->InheritsFrom(TH2::Class())) continue; // don't stack TH2s
-                Plot_Stack(groupKey, bkgHists, sigHists, dataHist, 1.0);
+                Plot_Stack(groupKey, bkgHists, sigHists, dataHist, 1.0, bkgTotals.count(groupKey) ? bkgTotals[groupKey] : nullptr);
             }
         
         } else {
             // Sort backgrounds by last-bin before calling Plot_CutFlow
             SortCutFlowsByLastBin(bkgHists, bkgProcs);
             if(!bkgHists.empty() || !sigHists.empty() || dataHist)
-                Plot_CutFlow(groupKey, bkgHists, sigHists, dataHist, 1.0);
+                Plot_CutFlow(groupKey, bkgHists, sigHists, dataHist, 1.0, bkgTotals.count(groupKey) ? bkgTotals[groupKey] : nullptr);
         }
     }
 
@@ -1,4 +1,5 @@
 #include "SampleTool.h"
+#include "SampleCatalog.h"
 
 SampleTool::SampleTool(){
 
@@ -213,8 +214,7 @@ void SampleTool::LoadAllFromMaster() {
     for (const auto &kv : MasterDict) {
         const std::string &group = kv.first;
         const stringlist &files = kv.second;
-        // Rule: treat "Cascades" or anything containing "SMS" as signal
-        if (group == "Cascades" || group.find("SMS") != std::string::npos) {
+        if (SampleCatalog::IsSignalGroup(group)) {
             SigDict[group] = files;
         } else {
             BkgDict[group] = files;
@@ -0,0 +1,76 @@
+// src/buildSignalIndex.cpp
+// Scans signal ntuples once and writes the signal metadata index (SignalIndex.h) that
+// BFTool::GetSignalTokensCascades / GetSignalTokensSMS consult before opening a file.
+#include <getopt.h>
+#include <set>
+
+#include "SampleTool.h"
+
+static void usage(const char* me) {
+    std::cerr << "Usage: " << me << " [--output FILE] [--file ROOTFILE ...] [GROUP ...]\n\n";
+    std::cerr << "  --output  Index to write (default: $BFI_SIGNAL_INDEX or signal_index.tsv)\n";
+    std::cerr << "  --file    Signal file to index (repeatable)\n";
+    std::cerr << "  GROUP     SampleTool signal groups to index (default: every X_Cascades / X_SMS file)\n";
+    std::cerr << "  --help    Display this help message\n";
+}
+
+static bool IsSignalFile(const std::string& f) {
+    return f.find("X_Cascades") != std::string::npos || f.find("X_SMS") != std::string::npos;
+}
+
+int main(int argc, char** argv) {
+    std::string output = SignalIndex::DefaultPath();
+    stringlist files;
+
+    static struct option long_options[] = {
+        {"output", required_argument, 0, 'o'},
+        {"file", required_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {0,0,0,0}
+    };
+
+    int opt, opt_index=0;
+    while ((opt = getopt_long(argc, argv, "o:f:h", long_options, &opt_index)) != -1) {
+        switch(opt){
+            case 'o': output = optarg; break;
+            case 'f': files.push_back(optarg); break;
+            case 'h':
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    SampleTool ST;
+    stringlist groups(argv + optind, argv + argc);
+    if (groups.empty() && files.empty())
+        for (const auto& kv : ST.MasterDict) groups.push_back(kv.first);
+    for (const auto& g : groups) {
+        if (!ST.MasterDict.count(g)) { std::cerr << "[buildSignalIndex] Group " << g << " not found ... skipping ...\n"; continue; }
+        for (const auto& f : ST.MasterDict[g]) if (IsSignalFile(f)) files.push_back(f);
+    }
+
+    std::set<std::string> seen;
+    std::vector<std::pair<std::string, SignalIndex::Entry>> rows;
+    for (const auto& f : files) {
+        if (!seen.insert(f).second) continue;
+        SignalIndex::Entry e;
+        if (f.find("X_SMS") != std::string::npos) {
+            e.token = "-";
+            e.smsTrees = BFTool::ReadSignalTreesSMS(f, &e.entries);
+        } else {
+            e.token = BFTool::ReadSignalTokensCascades(f, &e.entries);
+        }
+        // unreadable files stay out of the index, so lookups fall back to opening them
+        if (e.token.empty() || (e.token == "-" && e.smsTrees.empty())) {
+            std::cerr << "[buildSignalIndex] Cannot read " << f << " ... not indexed ...\n";
+            continue;
+        }
+        std::cout << "[buildSignalIndex] " << f << ": " << e.token << ", " << e.smsTrees.size()
+                  << " SMS trees, " << e.entries << " entries\n";
+        rows.emplace_back(f, std::move(e));
+    }
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
+
+    if (!SignalIndex::Write(output, rows)) return 2;
+    std::cout << "[buildSignalIndex] Wrote " << rows.size() << " files to " << output << "\n";
+    return 0;
+}
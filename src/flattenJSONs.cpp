@@ -2,7 +2,11 @@
 #include <fstream>
 #include <filesystem>
 #include <vector>
+#include <map>
+#include <array>
+#include <cmath>
 #include <nlohmann/json.hpp>
+#include "YieldBinary.h"
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
@@ -14,6 +18,8 @@ int main(int argc, char** argv) {
     }
 
     json mergedFlattened;
+    // merged[bin][sample] -> { count, sumW, sumW2 }
+    std::map<std::string, std::map<std::string, std::array<double,3>>> merged;
 
     // last argument is output file
     fs::path outputFile = argv[argc-1];
@@ -26,21 +32,37 @@ int main(int argc, char** argv) {
             continue;
         }
 
+        // one file per stem, preferring binary yields (.byf) when both formats were written
+        std::map<fs::path, fs::path> byStem;
         for (const auto &entry : fs::directory_iterator(inputDir)) {
-            if (entry.path().extension() != ".json") continue;
-
-            std::ifstream in(entry.path());
-            if (!in.is_open()) {
-                std::cerr << "Failed to open JSON file: " << entry.path() << "\n";
-                continue;
-            }
+            const fs::path ext = entry.path().extension();
+            if (ext != ".json" && ext != ".byf") continue;
+            auto &slot = byStem[fs::path(entry.path()).replace_extension()];
+            if (slot.empty() || ext == ".byf") slot = entry.path();
+        }
 
+        for (const auto &stemPair : byStem) {
+            const fs::path &path = stemPair.second;
             json j;
-            try {
-                in >> j;
-            } catch (json::parse_error &e) {
-                std::cerr << "JSON parse error in file " << entry.path() << ": " << e.what() << "\n";
-                continue;
+            if (path.extension() == ".byf") {
+                YieldBinary yb;
+                if (!yb.Open(path.string())) {
+                    std::cerr << "Failed to open binary yield file: " << path << "\n";
+                    continue;
+                }
+                j = yb.ToFlatJSON();
+            } else {
+                std::ifstream in(path);
+                if (!in.is_open()) {
+                    std::cerr << "Failed to open JSON file: " << path << "\n";
+                    continue;
+                }
+                try {
+                    in >> j;
+                } catch (json::parse_error &e) {
+                    std::cerr << "JSON parse error in file " << path << ": " << e.what() << "\n";
+                    continue;
+                }
             }
 
             // --- merge logic ---
@@ -50,35 +72,34 @@ int main(int argc, char** argv) {
                     const std::string &sampleName = samplePair.key();
                     const auto &arr = samplePair.value();
 
-                    for (size_t i = 0; i < 3; ++i) {
-                        double oldVal = 0.0;
-                        if (mergedFlattened.contains(binName) &&
-                            mergedFlattened[binName].contains(sampleName) &&
-                            !mergedFlattened[binName][sampleName][i].is_null())
-                        {
-                            oldVal = mergedFlattened[binName][sampleName][i].get<double>();
-                        }
+                    // count and sumW add up, and so does sumW2 (err^2 for older 3-element arrays)
+                    auto at = [&arr](size_t i) { return (i < arr.size() && !arr[i].is_null()) ? arr[i].get<double>() : 0.0; };
+                    const double sumW2 = arr.size() > 3 ? at(3) : at(2) * at(2);
 
-                        double newVal = arr[i].is_null() ? 0.0 : arr[i].get<double>();
-
-                        if (!mergedFlattened.contains(binName))
-                            mergedFlattened[binName] = json::object();
-                        if (!mergedFlattened[binName].contains(sampleName))
-                            mergedFlattened[binName][sampleName] = json::array({0.0, 0.0, 0.0});
-
-                        if (i == 2)
-                            mergedFlattened[binName][sampleName][i] = std::sqrt(oldVal*oldVal + newVal*newVal);
-                        else
-                            mergedFlattened[binName][sampleName][i] = oldVal + newVal;
-                    }
+                    auto &acc = merged[binName][sampleName];
+                    acc[0] += at(0);
+                    acc[1] += at(1);
+                    acc[2] += sumW2;
                 }
             }
         }
     }
 
-    // write merged json
-    std::ofstream out(outputFile);
-    out << mergedFlattened.dump(4);
+    for (const auto &binPair : merged)
+        for (const auto &samplePair : binPair.second) {
+            const auto &y = samplePair.second;
+            mergedFlattened[binPair.first][samplePair.first] = json::array({y[0], y[1], std::sqrt(y[2]), y[2]});
+        }
+
+    // write merged json (binary yields for a .byf output)
+    if (outputFile.extension() == ".byf") {
+        YieldBinary yb;
+        yb.FromFlatJSON(mergedFlattened);
+        if (!yb.Write(outputFile.string())) return 1;
+    } else {
+        std::ofstream out(outputFile);
+        out << mergedFlattened.dump(4);
+    }
     std::cout << "Merged flattened JSON written to " << outputFile << "\n";
     return 0;
 }
@@ -6,6 +6,8 @@
 int main() {
  	auto start = std::chrono::high_resolution_clock::now();
 	double Lumi= 400.;
+	// enable before the dataframes are built so RunGraphs can run the samples concurrently
+	ROOT::EnableImplicitMT();
 	SampleTool* ST = new SampleTool();
 	
 	stringlist bkglist = {"ttbar", "ST", "DY", "ZInv", "DBTB", "QCD", "Wjets"};
@@ -22,8 +24,6 @@ int main() {
 	ST->PrintKeys(ST->SignalKeys);
 	
 	BuildFitInput* BFI = new BuildFitInput();
-	BFI->LoadBkg_byMap(ST->BkgDict, Lumi);
-	BFI->LoadSig_byMap(ST->SigDict, Lumi);
         // Register custom macros if needed
 	BFI->RegisterMacro("AVG", "ROOT::VecOps::Mean");
 	
@@ -51,24 +51,38 @@ int main() {
         std::string ge1OSSF_a = BFI->BuildLeptonCut(">=1OSSF_a"); 
 	
 	// Initial region
-	BFI->CreateBin("TEST", {lep, met, RISR, RISR_Upper, PTISR, BVeto, jet, Mperp, maxSIP3D, CleaningCut});
-	BFI->CreateBin("TEST_Zstar", {lep, met, RISR, RISR_Upper, PTISR, BVeto, jet, Mperp, maxSIP3D, CleaningCut, ZstarCut});
+	stringlist cuts_TEST = {lep, met, RISR, RISR_Upper, PTISR, BVeto, jet, Mperp, maxSIP3D, CleaningCut};
+	stringlist cuts_TEST_Zstar = {lep, met, RISR, RISR_Upper, PTISR, BVeto, jet, Mperp, maxSIP3D, CleaningCut, ZstarCut};
+
+	// Only the lepton columns referenced by the bin cuts are defined when loading
+	BFI->RequireColumns(cuts_TEST);
+	BFI->RequireColumns(cuts_TEST_Zstar);
+	//BFI->skimDir = "skims"; // read BFI_skim.x outputs where they are valid
+	//BFI->adaptiveOrderEvents = 10000; // order each bin's filters by cost and pass rate on the first events
+	//BFI->PruneClustersFor({cuts_TEST, cuts_TEST_Zstar}); // with skimDir: skip source clusters no bin can pass
+	BFI->LoadBkg_byMap(ST->BkgDict, Lumi);
+	BFI->LoadSig_byMap(ST->SigDict, Lumi);
+
+	BFI->CreateBin("TEST", cuts_TEST);
+	BFI->CreateBin("TEST_Zstar", cuts_TEST_Zstar);
         std::cout << "Created Bins \n";
 
 	// Declare maps for bkg and signal
 	countmap countResults, countResults_S;
 	summap sumResults, sumResults_S;
-	errormap errorResults, errorResults_S;
+	sumw2map sumW2Results, sumW2Results_S;
 	
 	// Compute counts, sums, errors for background and signal
-	BFI->ReportRegions(0, countResults, sumResults, errorResults, false);
-	BFI->ReportRegions(0, countResults_S, sumResults_S, errorResults_S, true);
+	// (all bkg and sig nodes are booked first, then every sample is read once); the maps hold the
+	// filtered (process, bin) yields, not the per-sample totals ReportRegions(..., DoSig) gave
+	BFI->ReportRegionsBatched(0, countResults, sumResults, sumW2Results,
+	                          countResults_S, sumResults_S, sumW2Results_S);
 	
 	// Construct bins
-	BFI->ConstructBkgBinObjects(countResults, sumResults, errorResults);
-	BFI->AddSigToBinObjects(countResults_S, sumResults_S, errorResults_S, BFI->analysisbins);
+	BFI->ConstructBkgBinObjects(countResults, sumResults, sumW2Results);
+	BFI->AddSigToBinObjects(countResults_S, sumResults_S, sumW2Results_S, BFI->analysisbins);
 
-	//BFI->FullReport( countResults, sumResults, errorResults );
+	//BFI->FullReport( countResults, sumResults, sumW2Results );
 	BFI->PrintBins(1);
 	
         std::cout << "Making json... \n";
@@ -0,0 +1,383 @@
+// src/mergeDaemon.cpp
+// Incremental merger for condor bin directories (condor/<bin>/{json,root}): every new job
+// output is folded into a persistent running total as soon as it is complete, so the final
+// merge only has to pick up the last few files and partial results can be looked at while
+// jobs still run. Writes the same outputs as mergeJSONs.sh / haddROOTs.sh:
+//   condor/<bin>/<bin>.json (.byf)   yields, [count, sumW, err, sumW2]
+//   condor/<bin>/<bin>.root          hadded histograms
+// State (condor/<bin>/merge_state/) is checkpointed after every pass:
+//   state            generation, published generation, then one "yields|hists <TAB> input <TAB> mtime"
+//                    line per folded input
+//   yields_<gen>.byf running yield total (YieldBinary.h)
+//   hists_<gen>.root running histogram total
+// A new generation is written next to the old one and the state file is renamed over last,
+// so a killed daemon restarts from the last complete pass and never folds an input twice; outputs
+// of a generation that was checkpointed but not published are published on the next pass.
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <memory>
+
+#include "TFile.h"
+#include "TFileMerger.h"
+
+#include "SampleCatalog.h"
+#include "MergeTools.h"
+
+namespace fs = std::filesystem;
+
+static volatile std::sig_atomic_t g_stop = 0;
+static void onSignal(int) { g_stop = 1; }
+
+// Group of the first catalog file whose basename prefix starts the key (as in mergeJSONs)
+static std::string resolveGroup(const std::string &jsonKey) {
+    const std::string *group = SampleCatalog::Instance().GroupOfPrefix(jsonKey);
+    return group ? *group : jsonKey; // fallback
+}
+
+static long long mtimeOf(const fs::path &p) {
+    std::error_code ec;
+    auto t = fs::last_write_time(p, ec);
+    if (ec) return -1;
+    return std::chrono::duration_cast<std::chrono::seconds>(t.time_since_epoch()).count();
+}
+
+static long long nowInFileClock() {
+    return std::chrono::duration_cast<std::chrono::seconds>(fs::file_time_type::clock::now().time_since_epoch()).count();
+}
+
+struct DaemonOptions {
+    bool perFile = false;
+    std::string yieldFormat = "json";
+    long long settle = 30; // seconds an output must be left untouched before it is folded
+};
+
+class BinMerger {
+public:
+    BinMerger(const fs::path &binDir, const DaemonOptions &opt)
+        : dir_(binDir), opt_(opt), stateDir_(binDir / "merge_state") {
+        bin_ = binDir.filename().string();
+        if (bin_.empty()) bin_ = binDir.parent_path().filename().string();
+        out_ = dir_ / bin_;
+    }
+
+    const std::string &Name() const { return bin_; }
+
+    // Reads the checkpoint, if any; false when it exists but cannot be used
+    bool Load() {
+        fs::create_directories(stateDir_);
+        std::ifstream in(stateDir_ / "state");
+        if (!in) return true; // fresh start
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            if (line.rfind("generation ", 0) == 0) { gen_ = std::atol(line.c_str() + 11); continue; }
+            if (line.rfind("published ", 0) == 0) { published_ = std::atol(line.c_str() + 10); continue; }
+            const size_t t1 = line.find('\t'), t2 = line.rfind('\t');
+            if (t1 == std::string::npos || t2 == t1) continue;
+            Input in{line.substr(t1 + 1, t2 - t1 - 1), std::atoll(line.c_str() + t2 + 1)};
+            (line.compare(0, t1, "yields") == 0 ? yieldsDone_ : histsDone_).emplace(Key(in.path), in);
+        }
+        if (gen_ > 0) {
+            YieldBinary yb;
+            if (!yb.Open(YieldsPath(gen_).string())) return false;
+            FoldYieldBinary(yb, acc_, opt_.perFile, nullptr); // keys are groups already
+        }
+        std::cout << "[mergeDaemon] " << bin_ << ": resuming at generation " << gen_ << " ("
+                  << yieldsDone_.size() << " yield, " << histsDone_.size() << " histogram inputs merged)\n";
+        return true;
+    }
+
+    // One pass: folds every complete new input and checkpoints. Returns the number of inputs folded,
+    // or -1 on failure (including an unreadable input in the final pass).
+    // `final` ignores the settle time (all jobs are done) and merges everything again when an input
+    // changed after it was merged (e.g. a resubmitted job), since its old content cannot be taken out.
+    int Pass(bool final) {
+        const long long now = nowInFileClock();
+        changed_.clear();
+        std::vector<Input> newYields = Pending(dir_ / "json", {".json", ".byf"}, yieldsDone_, now, final);
+        std::vector<Input> newHists = Pending(dir_ / "root", {".root"}, histsDone_, now, final);
+        if (final && !changed_.empty()) {
+            std::cout << "[mergeDaemon] " << bin_ << ": " << changed_.size()
+                      << " inputs changed after they were merged; merging everything again\n";
+            Reset();
+            newYields = Pending(dir_ / "json", {".json", ".byf"}, yieldsDone_, now, final);
+            newHists = Pending(dir_ / "root", {".root"}, histsDone_, now, final);
+        }
+
+        // yields: each input on its own, so one unreadable file only delays itself
+        MergeAccumulator added;
+        std::vector<Input> foldedYields;
+        std::vector<std::string> unreadable; // retried next pass; the final pass fails on them
+        for (const auto &in : newYields) {
+            MergeAccumulator one;
+            if (!MergePartialJSONs({in.path}, one, opt_.perFile, resolveGroup, 1)) { unreadable.push_back(in.path); continue; }
+            added.Add(one);
+            foldedYields.push_back(in);
+        }
+
+        std::vector<Input> foldedHists;
+        for (const auto &in : newHists) {
+            if (Readable(in.path)) foldedHists.push_back(in);
+            else unreadable.push_back(in.path);
+        }
+
+        // the final pass replaces hadd / mergeJSONs.sh, which fail on any unreadable input
+        const bool incomplete = final && !unreadable.empty();
+        if (incomplete) {
+            for (const auto &path : unreadable)
+                std::cerr << "[mergeDaemon] " << bin_ << ": cannot read " << path << "\n";
+            std::cerr << "[mergeDaemon] " << bin_ << ": " << unreadable.size()
+                      << " inputs unreadable in the final pass; the merged outputs are incomplete\n";
+        }
+
+        if (foldedYields.empty() && foldedHists.empty()) {
+            // checkpoint not published (killed or failed before), or outputs removed by hand: republish it
+            if (gen_ > 0 && (published_ != gen_ || !fs::exists(OutputPath(opt_.yieldFormat == "binary" ? "byf" : "json"))))
+                return PublishCurrent(fs::exists(HistsPath(gen_))) && !incomplete ? 0 : -1;
+            return incomplete ? -1 : 0;
+        }
+
+        const long long next = gen_ + 1;
+        MergeAccumulator total = acc_;
+        total.Add(added);
+        if (!WriteYieldBinary(YieldsPath(next).string(), total, opt_.perFile)) {
+            std::cerr << "[mergeDaemon] " << bin_ << ": cannot write " << YieldsPath(next) << "\n";
+            return -1;
+        }
+        const bool haveHists = !foldedHists.empty() || fs::exists(HistsPath(gen_));
+        if (haveHists && !MergeHists(foldedHists, HistsPath(next))) {
+            fs::remove(YieldsPath(next));
+            return -1;
+        }
+
+        // commit: state first, then drop the previous generation and publish
+        for (const auto &in : foldedYields) yieldsDone_.emplace(Key(in.path), in);
+        for (const auto &in : foldedHists) histsDone_.emplace(Key(in.path), in);
+        if (!WriteState(next)) {
+            for (const auto &in : foldedYields) yieldsDone_.erase(Key(in.path));
+            for (const auto &in : foldedHists) histsDone_.erase(Key(in.path));
+            fs::remove(YieldsPath(next));
+            fs::remove(HistsPath(next));
+            return -1;
+        }
+        std::error_code ec;
+        fs::remove(YieldsPath(gen_), ec);
+        fs::remove(HistsPath(gen_), ec);
+        gen_ = next;
+        acc_ = std::move(total);
+        const bool published = PublishCurrent(haveHists);
+
+        std::cout << "[mergeDaemon] " << bin_ << ": +" << foldedYields.size() << " yield, +" << foldedHists.size()
+                  << " histogram inputs (" << yieldsDone_.size() << " / " << histsDone_.size() << " merged)\n";
+        return published && !incomplete ? int(foldedYields.size() + foldedHists.size()) : -1;
+    }
+
+private:
+    struct Input {
+        std::string path;
+        long long mtime;
+    };
+
+    // One key per job output: <stem> without the extension, so .json and .byf of a job count once
+    static std::string Key(const std::string &path) { return fs::path(path).replace_extension().string(); }
+
+    fs::path YieldsPath(long long g) const { return stateDir_ / ("yields_" + std::to_string(g) + ".byf"); }
+    fs::path HistsPath(long long g) const { return stateDir_ / ("hists_" + std::to_string(g) + ".root"); }
+    fs::path OutputPath(const std::string &ext) const { return fs::path(out_.string() + "." + ext); }
+
+    // New inputs of `dir` left untouched for opt_.settle seconds (all of them in the final pass).
+    // When a job wrote both formats the binary yields are used.
+    std::vector<Input> Pending(const fs::path &dir, const std::set<std::string> &exts,
+                               const std::map<std::string, Input> &done, long long now, bool final) {
+        std::map<std::string, Input> byKey;
+        std::error_code ec;
+        if (!fs::is_directory(dir, ec)) return {};
+        for (const auto &entry : fs::directory_iterator(dir, ec)) {
+            const std::string ext = entry.path().extension().string();
+            if (!entry.is_regular_file() || !exts.count(ext)) continue;
+            const std::string path = fs::weakly_canonical(entry.path()).string();
+            const long long mtime = mtimeOf(entry.path());
+            auto d = done.find(Key(path));
+            if (d != done.end()) {
+                if (d->second.path == path && d->second.mtime != mtime) {
+                    changed_.insert(path);
+                    if (!final && warned_.insert(path).second)
+                        std::cerr << "[mergeDaemon] " << bin_ << ": " << path
+                                  << " changed after it was merged; the final --once pass merges everything again\n";
+                }
+                continue;
+            }
+            if (!final && now - mtime < opt_.settle) continue;
+            auto &slot = byKey[Key(path)];
+            if (slot.path.empty() || ext == ".byf") slot = Input{path, mtime};
+        }
+        std::vector<Input> out;
+        for (auto &kv : byKey) out.push_back(std::move(kv.second));
+        return out;
+    }
+
+    // Complete, closed ROOT file (not still being transferred)
+    static bool Readable(const std::string &path) {
+        std::unique_ptr<TFile> f(TFile::Open(path.c_str(), "READ"));
+        return f && !f->IsZombie() && !f->TestBit(TFile::kRecovered);
+    }
+
+    // Previous histogram total plus `inputs` into `out`
+    bool MergeHists(const std::vector<Input> &inputs, const fs::path &out) {
+        TFileMerger merger(false, false);
+        merger.SetPrintLevel(0);
+        if (!merger.OutputFile(out.string().c_str(), "RECREATE")) {
+            std::cerr << "[mergeDaemon] " << bin_ << ": cannot create " << out << "\n";
+            return false;
+        }
+        if (fs::exists(HistsPath(gen_))) merger.AddFile(HistsPath(gen_).string().c_str(), false);
+        for (const auto &in : inputs) merger.AddFile(in.path.c_str(), false);
+        if (!merger.Merge()) {
+            std::cerr << "[mergeDaemon] " << bin_ << ": histogram merge into " << out << " failed\n";
+            return false;
+        }
+        return true;
+    }
+
+    bool WriteState(long long g) {
+        const fs::path path = stateDir_ / "state";
+        const fs::path tmp = stateDir_ / "state.tmp";
+        {
+            std::ofstream out(tmp);
+            if (!out) return false;
+            out << "# mergeDaemon state for " << bin_ << "\n";
+            out << "generation " << g << "\n";
+            out << "published " << published_ << "\n";
+            for (const auto &kv : yieldsDone_) out << "yields\t" << kv.second.path << "\t" << kv.second.mtime << "\n";
+            for (const auto &kv : histsDone_) out << "hists\t" << kv.second.path << "\t" << kv.second.mtime << "\n";
+            if (!out) return false;
+        }
+        std::error_code ec;
+        fs::rename(tmp, path, ec);
+        if (ec) std::cerr << "[mergeDaemon] " << bin_ << ": cannot write " << path << ": " << ec.message() << "\n";
+        return !ec;
+    }
+
+    // Drops the checkpoint: the next pass merges every input from scratch
+    void Reset() {
+        std::error_code ec;
+        fs::remove_all(stateDir_, ec);
+        fs::create_directories(stateDir_, ec);
+        gen_ = published_ = 0;
+        acc_ = MergeAccumulator();
+        yieldsDone_.clear();
+        histsDone_.clear();
+        warned_.clear();
+        changed_.clear();
+    }
+
+    // Publishes generation gen_ and records it in the state, so an unpublished one is retried
+    bool PublishCurrent(bool haveHists) {
+        if (!Publish(haveHists)) return false;
+        const long long before = published_;
+        published_ = gen_;
+        if (WriteState(gen_)) return true;
+        published_ = before;
+        return false;
+    }
+
+    // Outputs at the paths the merge scripts use; the ROOT total is hard-linked (copied across filesystems)
+    bool Publish(bool haveHists) {
+        bool ok = true;
+        if (opt_.yieldFormat != "binary" &&
+            !WriteYieldJSON(OutputPath("json").string(), acc_, opt_.perFile ? out_.string() + "_files.json" : "")) {
+            std::cerr << "[mergeDaemon] " << bin_ << ": cannot write " << OutputPath("json") << "\n";
+            ok = false;
+        }
+        if (opt_.yieldFormat != "json" && !WriteYieldBinary(OutputPath("byf").string(), acc_, opt_.perFile)) {
+            std::cerr << "[mergeDaemon] " << bin_ << ": cannot write " << OutputPath("byf") << "\n";
+            ok = false;
+        }
+        if (!haveHists) return ok;
+
+        const fs::path tmp = OutputPath("root.tmp");
+        std::error_code ec;
+        fs::remove(tmp, ec);
+        fs::create_hard_link(HistsPath(gen_), tmp, ec);
+        if (ec) fs::copy_file(HistsPath(gen_), tmp, fs::copy_options::overwrite_existing, ec);
+        if (!ec) fs::rename(tmp, OutputPath("root"), ec);
+        if (ec) std::cerr << "[mergeDaemon] " << bin_ << ": cannot publish " << OutputPath("root") << ": " << ec.message() << "\n";
+        return ok && !ec;
+    }
+
+    fs::path dir_, out_;
+    std::string bin_;
+    DaemonOptions opt_;
+    fs::path stateDir_;
+    long long gen_ = 0, published_ = 0;
+    MergeAccumulator acc_;
+    std::map<std::string, Input> yieldsDone_, histsDone_; // by Key()
+    std::set<std::string> warned_, changed_; // changed_: merged inputs rewritten since, this pass
+};
+
+static void usage(const char *me) {
+    std::cerr << "Usage: " << me << " [--once] [--interval S] [--settle S] [--per_file] [--yield-format json|binary|both]"
+                 " [--rebuild] BIN_DIR [BIN_DIR ...]\n";
+    std::cerr << "  BIN_DIR        condor/<bin>: merges <bin>/json/* and <bin>/root/* into <bin>/<bin>.json and <bin>/<bin>.root\n";
+    std::cerr << "  --once         Single pass over everything present, then exit (final merge)\n";
+    std::cerr << "  --interval     Seconds between passes (default: 60); SIGINT/SIGTERM exit after the current pass\n";
+    std::cerr << "  --settle       Seconds an output must be unchanged before it is merged (default: 30)\n";
+    std::cerr << "  --per_file     Also keep and write the per-file breakdown (<bin>_files.json)\n";
+    std::cerr << "  --yield-format Output <bin>.json (default), <bin>.byf or both\n";
+    std::cerr << "  --rebuild      Drop the saved state and merge everything again\n";
+}
+
+int main(int argc, char **argv) {
+    DaemonOptions opt;
+    bool once = false, rebuild = false;
+    long long interval = 60;
+    std::vector<std::string> binDirs;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto next = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (a == "--once") once = true;
+        else if (a == "--interval") interval = std::atoll(next().c_str());
+        else if (a == "--settle") opt.settle = std::atoll(next().c_str());
+        else if (a == "--per_file") opt.perFile = true;
+        else if (a == "--yield-format") opt.yieldFormat = next();
+        else if (a == "--rebuild") rebuild = true;
+        else if (!a.empty() && a[0] == '-') { usage(argv[0]); return 1; }
+        else binDirs.push_back(a);
+    }
+    if (binDirs.empty() || interval <= 0 ||
+        (opt.yieldFormat != "json" && opt.yieldFormat != "binary" && opt.yieldFormat != "both")) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::unique_ptr<BinMerger>> mergers;
+    for (const auto &d : binDirs) {
+        if (!fs::is_directory(d)) { std::cerr << "[mergeDaemon] Not a directory: " << d << "\n"; return 2; }
+        if (rebuild) fs::remove_all(fs::path(d) / "merge_state");
+        mergers.emplace_back(new BinMerger(fs::path(d), opt));
+        if (!mergers.back()->Load()) {
+            std::cerr << "[mergeDaemon] " << mergers.back()->Name() << ": unreadable state, rerun with --rebuild\n";
+            return 3;
+        }
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    int status = 0;
+    while (true) {
+        for (auto &m : mergers) if (m->Pass(once) < 0) status = 4;
+        if (once || g_stop) break;
+        for (long long s = 0; s < interval && !g_stop; ++s) std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    return status;
+}
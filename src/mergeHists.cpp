@@ -0,0 +1,189 @@
+// src/mergeHists.cpp
+// Merges BFI_condor histogram outputs (<bin>__<proc>__<var>, see HistNaming.h) in place of hadd.
+// Inputs are read one file at a time on each thread, in name order so the jobs of one process
+// land on the same thread; the per-thread sums are then reduced in parallel across histogram
+// names. With --totals the summed background of every <bin>__<var> group is also written to
+// totals/<bin>__<var>, which PlotHistograms.x uses instead of adding the processes up again.
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "TROOT.h"
+#include "TFile.h"
+#include "TKey.h"
+#include "TClass.h"
+#include "TH1.h"
+#include "TList.h"
+#include "TDirectory.h"
+
+#include "HistNaming.h"
+#include "SampleCatalog.h"
+
+namespace fs = std::filesystem;
+
+typedef std::map<std::string, std::unique_ptr<TH1>> HistSums;
+
+// Adds `h` into sums[name]; labelled axes (CutFlow, NMinus1) are merged by label, as hadd does
+static void fold(HistSums &sums, const std::string &name, std::unique_ptr<TH1> h) {
+    auto it = sums.find(name);
+    if (it == sums.end()) { sums.emplace(name, std::move(h)); return; }
+    TList list;
+    list.Add(h.get());
+    it->second->Merge(&list);
+}
+
+// Every histogram of `path` folded into `sums`; false if the file cannot be read
+static bool foldFile(const std::string &path, HistSums &sums) {
+    std::unique_ptr<TFile> f(TFile::Open(path.c_str(), "READ"));
+    if (!f || f->IsZombie()) return false;
+    std::set<std::string> seen; // keys are listed highest cycle first
+    TIter next(f->GetListOfKeys());
+    while (TKey *key = static_cast<TKey*>(next())) {
+        TClass *cl = TClass::GetClass(key->GetClassName());
+        if (!cl || !cl->InheritsFrom(TH1::Class())) continue;
+        if (!seen.insert(key->GetName()).second) continue;
+        std::unique_ptr<TH1> h(static_cast<TH1*>(key->ReadObj()));
+        if (!h) continue;
+        h->SetDirectory(nullptr);
+        fold(sums, key->GetName(), std::move(h));
+    }
+    return true;
+}
+
+static void usage(const char *me) {
+    std::cerr << "Usage: " << me << " -o OUTPUT [-j N] [--totals] INPUT [INPUT ...]\n";
+    std::cerr << "  INPUT          ROOT file, or a directory whose *.root files are merged\n";
+    std::cerr << "  -o, --output   Merged ROOT file (replaced)\n";
+    std::cerr << "  -j, --threads  Reader threads (default: all cores)\n";
+    std::cerr << "  --totals       Also write totals/<bin>__<var>: the sum of the background processes\n";
+}
+
+int main(int argc, char **argv) {
+    std::string output;
+    unsigned nThreads = 0;
+    bool totals = false;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto next = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (a == "-o" || a == "--output") output = next();
+        else if (a == "-j" || a == "--threads") nThreads = std::atoi(next().c_str());
+        else if (a == "--totals") totals = true;
+        else if (!a.empty() && a[0] == '-') { usage(argv[0]); return 1; }
+        else args.push_back(a);
+    }
+    if (output.empty() || args.empty()) { usage(argv[0]); return 1; }
+
+    std::vector<std::string> inputs;
+    for (const auto &a : args) {
+        if (fs::is_directory(a)) {
+            for (const auto &entry : fs::directory_iterator(a))
+                if (entry.is_regular_file() && entry.path().extension() == ".root") inputs.push_back(entry.path().string());
+        } else {
+            inputs.push_back(a);
+        }
+    }
+    const std::string outAbs = fs::weakly_canonical(output).string();
+    inputs.erase(std::remove_if(inputs.begin(), inputs.end(),
+                                [&](const std::string &p) { return fs::weakly_canonical(p).string() == outAbs; }),
+                 inputs.end());
+    std::sort(inputs.begin(), inputs.end()); // outputs of one sample are adjacent
+    if (inputs.empty()) { std::cerr << "[mergeHists] No ROOT files to merge\n"; return 2; }
+
+    ROOT::EnableThreadSafety();
+    TH1::AddDirectory(false);
+    if (nThreads == 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min<unsigned>(nThreads, inputs.size());
+
+    // contiguous chunks, so a thread mostly sees the same histogram names
+    const size_t chunk = std::max<size_t>(1, inputs.size() / (4 * nThreads));
+    std::vector<HistSums> partial(nThreads);
+    std::atomic<size_t> nextChunk{0};
+    std::atomic<int> failed{0};
+    std::mutex logMutex;
+    auto reader = [&](unsigned t) {
+        for (size_t c = nextChunk++; c * chunk < inputs.size(); c = nextChunk++) {
+            for (size_t i = c * chunk; i < std::min(inputs.size(), (c + 1) * chunk); ++i) {
+                if (foldFile(inputs[i], partial[t])) continue;
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << "[mergeHists] Cannot read " << inputs[i] << "\n";
+                ++failed;
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < nThreads; ++t) pool.emplace_back(reader, t);
+    reader(0);
+    for (auto &th : pool) th.join();
+    pool.clear();
+    if (failed) return 3;
+
+    // reduce across threads, one histogram name at a time, into partial[0]
+    std::vector<std::string> names;
+    for (const auto &p : partial)
+        for (const auto &kv : p) names.push_back(kv.first);
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    for (const auto &n : names) partial[0].emplace(n, nullptr); // no insertions while threads run
+    std::atomic<size_t> nextName{0};
+    auto reducer = [&]() {
+        for (size_t i = nextName++; i < names.size(); i = nextName++) {
+            std::unique_ptr<TH1> &sum = partial[0][names[i]];
+            for (size_t t = 1; t < partial.size(); ++t) {
+                auto it = partial[t].find(names[i]);
+                if (it == partial[t].end()) continue;
+                if (!sum) { sum = std::move(it->second); continue; }
+                TList list;
+                list.Add(it->second.get());
+                sum->Merge(&list);
+            }
+        }
+    };
+    for (unsigned t = 1; t < nThreads; ++t) pool.emplace_back(reducer);
+    reducer();
+    for (auto &th : pool) th.join();
+    HistSums &merged = partial[0];
+
+    const std::string tmp = output + ".tmp" + std::to_string(getpid());
+    {
+        std::unique_ptr<TFile> out(TFile::Open(tmp.c_str(), "RECREATE"));
+        if (!out || out->IsZombie()) { std::cerr << "[mergeHists] Cannot create " << tmp << "\n"; return 4; }
+        out->cd();
+        for (const auto &kv : merged) kv.second->Write(kv.first.c_str());
+
+        if (totals) {
+            const SampleCatalog &catalog = SampleCatalog::Instance();
+            HistSums sums;
+            for (const auto &kv : merged) {
+                const HistId id = ParseHistName(kv.first);
+                if (!catalog.IsBackground(id.proc)) continue;
+                std::unique_ptr<TH1> h(static_cast<TH1*>(kv.second->Clone()));
+                h->SetDirectory(nullptr);
+                fold(sums, HistGroupKey(id), std::move(h));
+            }
+            TDirectory *dir = out->mkdir("totals");
+            dir->cd();
+            for (const auto &kv : sums) kv.second->Write(kv.first.c_str());
+            out->cd();
+        }
+        out->Close();
+    }
+    if (std::rename(tmp.c_str(), output.c_str()) != 0) {
+        std::cerr << "[mergeHists] Cannot move " << tmp << " to " << output << "\n";
+        std::remove(tmp.c_str());
+        return 4;
+    }
+    std::cout << "[mergeHists] " << inputs.size() << " files, " << merged.size() << " histograms -> " << output << "\n";
+    return 0;
+}
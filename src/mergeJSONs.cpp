@@ -8,170 +8,198 @@
 #include <map>
 #include <vector>
 #include <string>
-#include "SampleTool.h"
+#include <set>
+#include <algorithm>
+#include <cstdlib>
+#include <chrono>
+#include "SampleCatalog.h"
+#include "MergeTools.h"
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
-bool mergeJSONsFlattenedWithFileBreakdown(const std::vector<std::string> &inputFiles,
-                                          const std::string &outMergedFile,
-                                          const std::string &outFilesFile = "")
-{
-    SampleTool ST;
-    ST.LoadAllFromMaster();
-
-    auto resolveGroup = [&ST](const std::string &jsonKey) -> std::string {
-        std::string keyBase = fs::path(jsonKey).filename().string();
-    
-        for (const auto &kv : ST.MasterDict) {       // kv.first = canonical group
-            for (const auto &entry : kv.second) {    // entry = full path
-                std::string entryBase = fs::path(entry).filename().string();
-    
-                // Use starts-with match instead of find anywhere
-                if (keyBase.rfind(entryBase.substr(0, entryBase.find("_")), 0) == 0)
-                    return kv.first;
-            }
-        }
-        return jsonKey; // fallback
-    };
-
-    // merged[bin][group] -> { count, sumW, var }
-    std::map<std::string, std::map<std::string,std::array<double,3>>> merged;
+// Group of the first catalog file whose basename prefix starts the key
+static std::string resolveGroup(const std::string &jsonKey) {
+    const std::string *group = SampleCatalog::Instance().GroupOfPrefix(jsonKey);
+    return group ? *group : jsonKey; // fallback
+}
 
-    // filesBreakdown[bin][group][file] -> { count, sumW, var }
-    std::map<std::string, std::map<std::string,std::map<std::string,std::array<double,3>>>> filesBreakdown;
+// "<size> <mtime>" of an input as listed in a shard, empty when it cannot be read
+static std::string inputStamp(const std::string &path) {
+    std::error_code ec;
+    const auto size = fs::file_size(path, ec);
+    if (ec) return "";
+    const auto mtime = fs::last_write_time(path, ec);
+    if (ec) return "";
+    return std::to_string(size) + " " +
+           std::to_string(std::chrono::duration_cast<std::chrono::seconds>(mtime.time_since_epoch()).count());
+}
 
-    for (const auto &fname : inputFiles) {
-        std::ifstream ifs(fname);
-        if (!ifs.is_open()) {
-            std::cerr << "[mergeJSONs] Cannot open " << fname << "\n";
-            return false;
-        }
-        json j;
-        ifs >> j;
-
-        for (auto &binItem : j.items()) {
-            const std::string &binName = binItem.key();
-            const json &binContent = binItem.value();
-
-            auto &binMap = merged[binName];
-            auto &filesBinMap = filesBreakdown[binName];
-
-            for (auto &sampleItem : binContent.items()) {
-                std::string origKey = sampleItem.key();
-                const json &sampleObj = sampleItem.value();
-
-                std::string group = resolveGroup(origKey);
-
-                double cnt  = sampleObj["totals"][0].get<double>();
-                double sumW = sampleObj["totals"][1].get<double>();
-                double err  = sampleObj["totals"][2].get<double>();
-
-                // merge totals
-                auto &arr = binMap[group];
-                arr[0] += cnt;
-                arr[1] += sumW;
-                arr[2] += err*err;
-
-                // store per-file breakdown only if requested
-                if (!outFilesFile.empty() && sampleObj.contains("files")) {
-                    auto &fileMap = filesBinMap[group];
-                    for (auto &fkv : sampleObj["files"].items()) {
-                        std::string fname = fkv.key();
-                        double fcnt  = fkv.value()[0].get<double>();
-                        double fsumW = fkv.value()[1].get<double>();
-                        double ferr  = fkv.value()[2].get<double>();
-                        auto &fileArr = fileMap[fname];
-                        fileArr[0] += fcnt;
-                        fileArr[1] += fsumW;
-                        fileArr[2] += ferr*ferr;
-                    }
-                }
-            }
+// Shards: inputs merged `shardSize` at a time into shardDir/shard_NNNN.byf, with the
+// list of inputs in shard_NNNN.list (written last, so a listed shard is complete), one
+// "input <TAB> size mtime" line each. Inputs of a listed shard are skipped, so a production can be
+// merged while jobs still run; a shard with an input that was rewritten (e.g. a resubmitted job)
+// or removed since is dropped and its inputs are sharded again.
+static bool updateShards(std::vector<std::string> &inputs, const std::string &shardDir, size_t shardSize,
+                         unsigned nThreads, std::vector<std::string> &shards)
+{
+    fs::create_directories(shardDir);
+    const std::set<std::string> present(inputs.begin(), inputs.end());
+    std::set<std::string> done;
+    int nextIndex = 0, rebuilt = 0;
+    for (const auto &entry : fs::directory_iterator(shardDir)) {
+        if (entry.path().extension() != ".list") continue;
+        const std::string stem = entry.path().stem().string(); // shard_NNNN
+        nextIndex = std::max(nextIndex, std::atoi(stem.substr(stem.find('_') + 1).c_str()) + 1);
+        fs::path shardFile = entry.path();
+        shardFile.replace_extension(".byf");
+        if (!fs::exists(shardFile)) continue;
+        std::vector<std::string> listed;
+        bool current = true;
+        std::ifstream list(entry.path());
+        for (std::string line; std::getline(list, line);) {
+            if (line.empty()) continue;
+            const size_t tab = line.find('\t');
+            const std::string in = line.substr(0, tab);
+            // lists without stamps come from older versions and cannot be checked
+            if (tab == std::string::npos || !present.count(in) || inputStamp(in) != line.substr(tab + 1)) current = false;
+            listed.push_back(in);
         }
-    }
-
-    // finalize errors
-    for (auto &binPair : merged) {
-        for (auto &samplePair : binPair.second) {
-            samplePair.second[2] = std::sqrt(samplePair.second[2]);
+        if (!current) {
+            std::error_code ec;
+            fs::remove(entry.path(), ec);
+            fs::remove(shardFile, ec);
+            ++rebuilt;
+            continue;
         }
+        done.insert(listed.begin(), listed.end());
+        shards.push_back(shardFile.string());
     }
-    if (!outFilesFile.empty()) {
-        for (auto &binPair : filesBreakdown) {
-            for (auto &samplePair : binPair.second) {
-                for (auto &filePair : samplePair.second) {
-                    filePair.second[2] = std::sqrt(filePair.second[2]);
-                }
-            }
+    if (rebuilt)
+        std::cout << "[mergeJSONs] " << rebuilt << " shards had inputs rewritten or removed since; sharding them again\n";
+
+    std::vector<std::string> pending;
+    for (const auto &in : inputs) if (!done.count(in)) pending.push_back(in);
+    std::sort(pending.begin(), pending.end());
+
+    // only full shards are written (always with the per-file breakdown); the remainder is merged directly
+    size_t used = 0;
+    for (; used + shardSize <= pending.size(); used += shardSize) {
+        std::vector<std::string> chunk(pending.begin() + used, pending.begin() + used + shardSize);
+        std::vector<std::string> stamps; // before merging, so a rewrite during the merge is noticed next time
+        for (const auto &in : chunk) stamps.push_back(inputStamp(in));
+        MergeAccumulator acc;
+        if (!MergePartialJSONs(chunk, acc, true, resolveGroup, nThreads)) return false;
+        char name[32];
+        std::snprintf(name, sizeof(name), "shard_%04d", nextIndex++);
+        const std::string base = (fs::path(shardDir) / name).string();
+        if (!WriteYieldBinary(base + ".byf", acc, true)) {
+            std::cerr << "[mergeJSONs] Cannot write " << base << ".byf\n";
+            return false;
         }
+        std::ofstream list(base + ".list.tmp");
+        for (size_t k = 0; k < chunk.size(); ++k) list << chunk[k] << "\t" << stamps[k] << "\n";
+        list.close();
+        fs::rename(base + ".list.tmp", base + ".list");
+        shards.push_back(base + ".byf");
     }
+    std::cout << "[mergeJSONs] " << shards.size() << " shards in " << shardDir << ", "
+              << done.size() + used << " inputs sharded, " << pending.size() - used << " merged directly\n";
+    inputs.assign(pending.begin() + used, pending.end());
+    return true;
+}
 
-    // write merged totals
-    json outMerged;
-    for (const auto &binPair : merged) {
-        const std::string &binName = binPair.first;
-        for (const auto &samplePair : binPair.second) {
-            outMerged[binName][samplePair.first] = {samplePair.second[0],
-                                                    samplePair.second[1],
-                                                    samplePair.second[2]};
-        }
-    }
-    std::ofstream ofs1(outMergedFile);
-    if (!ofs1.is_open()) return false;
-    ofs1 << outMerged.dump(4) << "\n";
-
-    // write per-file breakdown
-    if (!outFilesFile.empty()) {
-        json outFiles;
-        for (const auto &binPair : filesBreakdown) {
-            const std::string &binName = binPair.first;
-            for (const auto &samplePair : binPair.second) {
-                for (const auto &filePair : samplePair.second) {
-                    outFiles[binName][samplePair.first][filePair.first] = {filePair.second[0],
-                                                                           filePair.second[1],
-                                                                           filePair.second[2]};
-                }
-            }
-        }
-        std::ofstream ofs2(outFilesFile);
-        if (!ofs2.is_open()) return false;
-        ofs2 << outFiles.dump(4) << "\n";
+bool mergeJSONsFlattenedWithFileBreakdown(const std::vector<std::string> &inputFiles,
+                                          const std::string &outMergedFile,
+                                          const std::string &outFilesFile = "",
+                                          unsigned nThreads = 0,
+                                          const std::vector<std::string> &shardFiles = {},
+                                          const std::string &yieldFormat = "json")
+{
+    const bool keepFiles = !outFilesFile.empty();
+    MergeAccumulator acc;
+    // shard keys are groups already
+    if (!MergePartialJSONs(shardFiles, acc, keepFiles, nullptr, nThreads)) return false;
+    if (!MergePartialJSONs(inputFiles, acc, keepFiles, resolveGroup, nThreads)) return false;
+
+    // binary: one file with the totals and, with the breakdown, the per-file records
+    if (yieldFormat != "json" && !WriteYieldBinary(YieldPathFor(outMergedFile, "binary"), acc, keepFiles)) {
+        std::cerr << "[mergeJSONs] Cannot write " << YieldPathFor(outMergedFile, "binary") << "\n";
+        return false;
     }
+    if (yieldFormat == "binary") return true;
 
-    return true;
+    // JSON: totals, plus the per-file breakdown when requested
+    return WriteYieldJSON(outMergedFile, acc, outFilesFile);
+}
+
+static void usage(const char *me) {
+    std::cerr << "Usage: " << me << " merged output_directory [--per_file] [-j N] [--shard-size N [--shard-dir DIR]]"
+                 " [--yield-format json|binary|both]\n";
+    std::cerr << "  Inputs are the *.json and *.byf (binary yields) files of output_directory\n";
+    std::cerr << "  --per_file     Also write merged_files.json with the per-file breakdown\n";
+    std::cerr << "  -j, --threads  Parser threads (default: all cores)\n";
+    std::cerr << "  --shard-size   Merge inputs N at a time into reusable shards first, then merge the shards\n";
+    std::cerr << "  --shard-dir    Shard directory (default: <merged>_shards)\n";
+    std::cerr << "  --yield-format Output merged.json (default), merged.byf or both\n";
 }
 
 int main(int argc, char **argv) {
-    if (argc < 3 || argc > 4) {
-        std::cerr << "Usage: " << argv[0] << " merged output_directory [--per_file]\n";
+    std::vector<std::string> positional;
+    bool per_file = false;
+    unsigned nThreads = 0;
+    size_t shardSize = 0;
+    std::string shardDir, yieldFormat = "json";
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        auto next = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        if (a == "--per_file") per_file = true;
+        else if (a == "-j" || a == "--threads") nThreads = std::atoi(next().c_str());
+        else if (a == "--shard-size") shardSize = std::atol(next().c_str());
+        else if (a == "--shard-dir") shardDir = next();
+        else if (a == "--yield-format") yieldFormat = next();
+        else if (!a.empty() && a[0] == '-') { usage(argv[0]); return 1; }
+        else positional.push_back(a);
+    }
+    if (positional.size() != 2 || (yieldFormat != "json" && yieldFormat != "binary" && yieldFormat != "both")) {
+        usage(argv[0]);
         return 1;
     }
 
-    std::string outFile = argv[1];
-    std::string jsonDir = argv[2];
-    bool per_file = (argc == 4 && std::string(argv[3]) == "--per_file");
+    std::string outFile = positional[0];
+    std::string jsonDir = positional[1];
+    if (shardDir.empty()) shardDir = outFile + "_shards";
 
-    std::vector<std::string> inputs;
+    // one input per job: the binary yields when a job wrote both formats
+    std::map<std::string, std::string> byStem;
     for (const auto &entry : fs::directory_iterator(jsonDir)) {
-        if (entry.is_regular_file() && entry.path().extension() == ".json") {
-            inputs.push_back(entry.path().string());
-        }
+        const fs::path ext = entry.path().extension();
+        if (!entry.is_regular_file() || (ext != ".json" && ext != ".byf")) continue;
+        const std::string path = fs::weakly_canonical(entry.path()).string(); // stable shard lists
+        auto &slot = byStem[fs::path(path).replace_extension().string()];
+        if (slot.empty() || ext == ".byf") slot = path;
     }
+    std::vector<std::string> inputs;
+    for (const auto &kv : byStem) inputs.push_back(kv.second);
 
     if (inputs.empty()) {
         std::cerr << "[mergeJSONs] No JSON files found in " << jsonDir << "\n";
         return 2;
     }
+    const size_t nInputs = inputs.size();
+
+    std::vector<std::string> shards;
+    if (shardSize > 0 && !updateShards(inputs, shardDir, shardSize, nThreads, shards)) return 3;
 
     bool success = per_file ?
-        mergeJSONsFlattenedWithFileBreakdown(inputs, outFile + ".json", outFile + "_files.json") :
-        mergeJSONsFlattenedWithFileBreakdown(inputs, outFile + ".json", "");
+        mergeJSONsFlattenedWithFileBreakdown(inputs, outFile + ".json", outFile + "_files.json", nThreads, shards, yieldFormat) :
+        mergeJSONsFlattenedWithFileBreakdown(inputs, outFile + ".json", "", nThreads, shards, yieldFormat);
 
     if (!success) return 3;
 
-    std::cout << "[mergeJSONs] Merged " << inputs.size() << " JSONs to " << outFile << "\n";
-    if (per_file) std::cout << "[mergeJSONs] Per-file breakdown written to " << outFile << "_files.json\n";
+    std::cout << "[mergeJSONs] Merged " << nInputs << " JSONs to " << outFile << "\n";
+    if (per_file && yieldFormat != "binary") std::cout << "[mergeJSONs] Per-file breakdown written to " << outFile << "_files.json\n";
+    if (yieldFormat != "json") std::cout << "[mergeJSONs] Binary yields written to " << outFile << ".byf\n";
 
     return 0;
 }
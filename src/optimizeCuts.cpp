@@ -0,0 +1,501 @@
+// src/optimizeCuts.cpp
+// Cut-threshold optimiser: the events passing a base bin's cuts are read once through
+// BuildFitInput's loaders into a compact table (one float column per scanned expression plus
+// the scaled weight), optionally cached on disk. Thresholds are then tuned per signal point by
+// coordinate ascent: for one variable at a time the events passing the other cuts are
+// prefix-summed in that variable's sorted order, so every candidate threshold costs a binary
+// search instead of a loop over events. The best bins are written in the config/bin_cfgs schema.
+#include <getopt.h>
+#include <regex>
+#include <numeric>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include "TROOT.h"
+
+#include "BFICondorTools.h"
+#include "CutCache.h"
+#include "SignificanceTools.h"
+
+enum class CutOp { GE, LE, GT, LT };
+
+// One scanned cut: <expr> <op> threshold, candidates lo, lo+step, ..., hi
+struct ScanVar {
+    std::string expr, op;
+    CutOp cmp = CutOp::GE;
+    double lo = 0., hi = 0., step = 1.;
+    std::vector<double> Candidates() const {
+        std::vector<double> c;
+        for (double t = lo; t <= hi + 1e-9 * std::abs(step); t += step) c.push_back(t);
+        return c;
+    }
+};
+
+// Events of one process after the base cuts: cols[v][i] is scan variable v of event i
+struct EventTable {
+    std::string name;
+    bool isSignal = false;
+    std::vector<std::vector<float>> cols;
+    std::vector<double> w;
+    size_t Size() const { return w.size(); }
+};
+
+static const uint32_t kTableMagic = 0x544f4642; // "BFOT"
+
+// "MET>=100,400,25" -> {MET, >=, 100, 400, 25}
+static bool parseScan(const std::string &s, ScanVar &v) {
+    static const std::regex re(R"(^(.*)(>=|<=|>|<)([^<>=]+)$)");
+    std::smatch m;
+    if (!std::regex_match(s, m, re)) return false;
+    std::vector<std::string> nums = splitTopLevel(m[3].str());
+    if (nums.size() != 3) return false;
+    try {
+        v.lo = std::stod(nums[0]); v.hi = std::stod(nums[1]); v.step = std::stod(nums[2]);
+    } catch (...) { return false; }
+    v.expr = m[1].str();
+    v.expr.erase(v.expr.find_last_not_of(" \t") + 1);
+    v.expr.erase(0, v.expr.find_first_not_of(" \t"));
+    v.op = m[2].str();
+    v.cmp = v.op == ">=" ? CutOp::GE : v.op == "<=" ? CutOp::LE : v.op == ">" ? CutOp::GT : CutOp::LT;
+    return !v.expr.empty() && v.step > 0. && v.hi >= v.lo;
+}
+
+// A base cut "<expr> <op> <number>" on a scanned expression/op is replaced by the scan
+static bool replacedByScan(const std::string &cut, const std::vector<ScanVar> &vars) {
+    static const std::regex re(R"(^(.*)(>=|<=|>|<)\s*([-+0-9.eE]+)\s*$)");
+    std::smatch m;
+    if (!std::regex_match(cut, m, re)) return false;
+    for (const auto &s : vars)
+        if (SkimCutKey(s.expr) == SkimCutKey(m[1].str()) && s.op == m[2].str()) return true;
+    return false;
+}
+
+static bool writeTables(const std::string &path, const std::string &key, const std::vector<EventTable> &tables) {
+    const std::string tmp = path + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        if (!out) return false;
+        auto put = [&](const void *p, size_t n) { out.write(static_cast<const char*>(p), n); };
+        auto putStr = [&](const std::string &s) { uint64_t n = s.size(); put(&n, 8); put(s.data(), n); };
+        put(&kTableMagic, 4);
+        putStr(key);
+        uint64_t nt = tables.size();
+        put(&nt, 8);
+        for (const auto &t : tables) {
+            putStr(t.name);
+            uint8_t sig = t.isSignal;
+            put(&sig, 1);
+            uint64_t nv = t.cols.size(), ne = t.Size();
+            put(&nv, 8); put(&ne, 8);
+            for (const auto &c : t.cols) put(c.data(), ne * sizeof(float));
+            put(t.w.data(), ne * sizeof(double));
+        }
+        if (!out) { std::remove(tmp.c_str()); return false; }
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Every count is checked against the bytes left in the file before anything is allocated, so a
+// truncated or stale cache is rebuilt instead of read into a huge allocation
+static bool readTables(const std::string &path, const std::string &key, std::vector<EventTable> &tables) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    uint64_t left = static_cast<uint64_t>(in.tellg());
+    in.seekg(0);
+    auto get = [&](void *p, uint64_t n) {
+        if (n > left) return false;
+        in.read(static_cast<char*>(p), n);
+        left -= n;
+        return bool(in);
+    };
+    auto getStr = [&](std::string &s) {
+        uint64_t n = 0;
+        if (!get(&n, 8) || n > (1u << 20) || n > left) return false;
+        s.resize(n);
+        return get(&s[0], n);
+    };
+    uint32_t magic = 0;
+    std::string fileKey;
+    uint64_t nt = 0;
+    if (!get(&magic, 4) || magic != kTableMagic || !getStr(fileKey) || fileKey != key || !get(&nt, 8)) return false;
+    const uint64_t minTable = 8 + 1 + 8 + 8; // empty name, flag, nv, ne
+    if (nt > left / minTable) return false;
+    tables.assign(nt, EventTable{});
+    for (auto &t : tables) {
+        uint8_t sig = 0;
+        uint64_t nv = 0, ne = 0;
+        if (!getStr(t.name) || !get(&sig, 1) || !get(&nv, 8) || !get(&ne, 8)) return false;
+        // ne events of nv floats and a double each (nv is one column per scanned variable)
+        if (nv > (1u << 16) || ne > left / sizeof(double) ||
+            (ne > 0 && nv > (left / ne - sizeof(double)) / sizeof(float))) return false;
+        t.isSignal = sig;
+        t.cols.assign(nv, std::vector<float>(ne));
+        for (auto &c : t.cols) if (!get(c.data(), ne * sizeof(float))) return false;
+        t.w.resize(ne);
+        if (!get(t.w.data(), ne * sizeof(double))) return false;
+    }
+    return true;
+}
+
+// Per-variable sort order of a table
+struct SortedTable {
+    const EventTable *t = nullptr;
+    std::vector<std::vector<uint32_t>> order; // order[v]: events by increasing cols[v]
+    std::vector<std::vector<float>> sorted;   // sorted[v][k] = cols[v][order[v][k]]
+    explicit SortedTable(const EventTable &table) : t(&table) {
+        for (const auto &c : table.cols) {
+            std::vector<uint32_t> o(table.Size());
+            std::iota(o.begin(), o.end(), 0u);
+            std::stable_sort(o.begin(), o.end(), [&](uint32_t a, uint32_t b) { return c[a] < c[b]; });
+            std::vector<float> s(o.size());
+            for (size_t k = 0; k < o.size(); ++k) s[k] = c[o[k]];
+            order.push_back(std::move(o));
+            sorted.push_back(std::move(s));
+        }
+    }
+};
+
+// Thresholds of a candidate bin; NaN = variable not cut on
+typedef std::vector<double> Thresholds;
+
+// compared in float, like the binary searches over the sorted columns
+static bool passes(CutOp op, float x, double t) {
+    if (std::isnan(t)) return true;
+    const float tf = static_cast<float>(t);
+    switch (op) {
+        case CutOp::GE: return x >= tf;
+        case CutOp::LE: return x <= tf;
+        case CutOp::GT: return x > tf;
+        default:        return x < tf;
+    }
+}
+
+// Prefix sums over the events passing every cut but `skip`, in the sort order of `skip`
+struct Prefix {
+    std::vector<double> w;     // w[k]: weight of the first k sorted events that pass
+    std::vector<uint32_t> n;   // unweighted count
+};
+
+static void buildPrefix(const SortedTable &st, const std::vector<ScanVar> &vars, const Thresholds &th,
+                        size_t skip, Prefix &p) {
+    const EventTable &t = *st.t;
+    const auto &order = st.order[skip];
+    p.w.assign(order.size() + 1, 0.);
+    p.n.assign(order.size() + 1, 0);
+    for (size_t k = 0; k < order.size(); ++k) {
+        const uint32_t i = order[k];
+        bool pass = true;
+        for (size_t v = 0; v < vars.size() && pass; ++v)
+            if (v != skip) pass = passes(vars[v].cmp, t.cols[v][i], th[v]);
+        p.w[k + 1] = p.w[k] + (pass ? t.w[i] : 0.);
+        p.n[k + 1] = p.n[k] + (pass ? 1 : 0);
+    }
+}
+
+// Weight and count of the events passing `op t` on the skipped variable
+static std::pair<double, uint32_t> passing(const std::vector<float> &sorted, const Prefix &p, CutOp op, double t) {
+    const size_t N = sorted.size();
+    if (std::isnan(t)) return {p.w[N], p.n[N]};
+    const float tf = static_cast<float>(t);
+    const size_t lb = std::lower_bound(sorted.begin(), sorted.end(), tf) - sorted.begin();
+    const size_t ub = std::upper_bound(sorted.begin(), sorted.end(), tf) - sorted.begin();
+    switch (op) {
+        case CutOp::GE: return {p.w[N] - p.w[lb], p.n[N] - p.n[lb]};
+        case CutOp::GT: return {p.w[N] - p.w[ub], p.n[N] - p.n[ub]};
+        case CutOp::LE: return {p.w[ub], p.n[ub]};
+        default:        return {p.w[lb], p.n[lb]};
+    }
+}
+
+struct OptConfig {
+    std::string metric = "zbi";
+    double unc = 0.2;      // relative background uncertainty (Zbi) / lnN kappa - 1 (asimov)
+    double minBkg = 1.;    // weighted
+    unsigned minBkgMC = 10;
+    int rounds = 5;
+};
+
+static double score(const OptConfig &cfg, double S, double B, uint32_t nB) {
+    if (B < cfg.minBkg || nB < cfg.minBkgMC || S <= 0.) return -1.;
+    if (cfg.metric == "asimov") return SigTools::ExpectedZ(&S, &B, 1, 1. + cfg.unc);
+    return SigTools::Zbi(S, B, cfg.unc);
+}
+
+struct OptResult {
+    std::string signal;
+    Thresholds th;
+    double Z = -1., S = 0., B = 0.;
+};
+
+// Coordinate ascent over the scan variables for one signal point
+static OptResult optimise(const SortedTable &sig, const SortedTable &bkg, const std::vector<ScanVar> &vars,
+                          const OptConfig &cfg) {
+    OptResult r;
+    r.signal = sig.t->name;
+    r.th.assign(vars.size(), std::nan(""));
+    Prefix ps, pb;
+    for (int round = 0; round < cfg.rounds; ++round) {
+        bool changed = false;
+        for (size_t v = 0; v < vars.size(); ++v) {
+            buildPrefix(sig, vars, r.th, v, ps);
+            buildPrefix(bkg, vars, r.th, v, pb);
+            std::vector<double> cand = vars[v].Candidates();
+            cand.insert(cand.begin(), std::nan("")); // no cut on v
+            double bestZ = r.Z, bestT = r.th[v], bestS = r.S, bestB = r.B;
+            for (double t : cand) {
+                const double S = passing(sig.sorted[v], ps, vars[v].cmp, t).first;
+                const auto B = passing(bkg.sorted[v], pb, vars[v].cmp, t);
+                const double Z = score(cfg, S, B.first, B.second);
+                if (Z > bestZ + 1e-9) { bestZ = Z; bestT = t; bestS = S; bestB = B.first; }
+            }
+            const bool same = (std::isnan(bestT) && std::isnan(r.th[v])) || bestT == r.th[v];
+            if (!same) changed = true;
+            r.th[v] = bestT; r.Z = bestZ; r.S = bestS; r.B = bestB;
+        }
+        if (!changed) break;
+    }
+    return r;
+}
+
+static std::string joinCuts(const std::vector<std::string> &cuts) {
+    std::string s;
+    for (const auto &c : cuts) s += (s.empty() ? "" : ";") + c;
+    return s;
+}
+
+static void usage(const char *me) {
+    std::cerr << "Usage: " << me << " --bins-yaml BINS.yaml --bin NAME --scan EXPR>=LO,HI,STEP [--scan ...] [options]\n\n";
+    std::cerr << "  --bins-yaml     Bins YAML (config/bin_cfgs format) holding the base bin\n";
+    std::cerr << "  --bin           Base bin: its cuts select the events, scanned cuts replace its '<expr> <op> <number>' cuts\n";
+    std::cerr << "  --scan          Threshold scan, e.g. MET>=150,400,25 or \"Mperp<=10,60,5\" (repeatable)\n";
+    std::cerr << "  --bkgs          Background groups (default ttbar,ST,DY,ZInv,DBTB,QCD,Wjets)\n";
+    std::cerr << "  --sigs          Signal groups (default Cascades)\n";
+    std::cerr << "  --sms-filters   Comma-separated SMS mass points to keep\n";
+    std::cerr << "  --lumi          Integrated luminosity (default 400)\n";
+    std::cerr << "  --metric        zbi (default) or asimov\n";
+    std::cerr << "  --unc           Relative background uncertainty (default 0.2)\n";
+    std::cerr << "  --min-bkg       Minimum weighted background in a bin (default 1)\n";
+    std::cerr << "  --min-bkg-mc    Minimum background MC events in a bin (default 10)\n";
+    std::cerr << "  --rounds        Coordinate ascent rounds (default 5)\n";
+    std::cerr << "  --top           Write only the N best bins (default all signal points)\n";
+    std::cerr << "  --table         Event table cache; reused when the configuration matches\n";
+    std::cerr << "  --skim-dir      Read BFI_skim.x outputs where valid\n";
+    std::cerr << "  -j, --threads   Threads for the scan (default all cores)\n";
+    std::cerr << "  -o, --output    Output bins YAML (default optimized_bins.yaml)\n";
+}
+
+int main(int argc, char **argv) {
+    RegisterSafeHelpers();
+    std::string binsYamlPath, binName, tablePath, skimDir, output = "optimized_bins.yaml";
+    std::vector<std::string> bkgGroups = {"ttbar", "ST", "DY", "ZInv", "DBTB", "QCD", "Wjets"}, sigGroups = {"Cascades"}, smsFilters;
+    std::vector<ScanVar> vars;
+    OptConfig cfg;
+    double lumi = 400.;
+    unsigned top = 0, nThreads = 0;
+
+    static struct option long_options[] = {
+        {"bins-yaml", required_argument, 0, 'B'}, {"bin", required_argument, 0, 'b'},
+        {"scan", required_argument, 0, 's'}, {"bkgs", required_argument, 0, 'K'},
+        {"sigs", required_argument, 0, 'S'}, {"sms-filters", required_argument, 0, 'F'},
+        {"lumi", required_argument, 0, 'L'}, {"metric", required_argument, 0, 'm'},
+        {"unc", required_argument, 0, 'u'}, {"min-bkg", required_argument, 0, 'n'},
+        {"min-bkg-mc", required_argument, 0, 'N'}, {"rounds", required_argument, 0, 'r'},
+        {"top", required_argument, 0, 't'}, {"table", required_argument, 0, 'T'},
+        {"skim-dir", required_argument, 0, 'D'}, {"threads", required_argument, 0, 'j'},
+        {"output", required_argument, 0, 'o'}, {"help", no_argument, 0, 'h'},
+        {0,0,0,0}
+    };
+    int opt, opt_index = 0;
+    while ((opt = getopt_long(argc, argv, "B:b:s:j:o:h", long_options, &opt_index)) != -1) {
+        switch (opt) {
+            case 'B': binsYamlPath = optarg; break;
+            case 'b': binName = optarg; break;
+            case 's': {
+                ScanVar v;
+                if (!parseScan(optarg, v)) { std::cerr << "[optimizeCuts] Bad --scan " << optarg << "\n"; return 1; }
+                vars.push_back(v);
+                break;
+            }
+            case 'K': bkgGroups = splitTopLevel(optarg); break;
+            case 'S': sigGroups = splitTopLevel(optarg); break;
+            case 'F': smsFilters = splitTopLevel(optarg); break;
+            case 'L': lumi = std::atof(optarg); break;
+            case 'm': cfg.metric = optarg; break;
+            case 'u': cfg.unc = std::atof(optarg); break;
+            case 'n': cfg.minBkg = std::atof(optarg); break;
+            case 'N': cfg.minBkgMC = std::atoi(optarg); break;
+            case 'r': cfg.rounds = std::atoi(optarg); break;
+            case 't': top = std::atoi(optarg); break;
+            case 'T': tablePath = optarg; break;
+            case 'D': skimDir = optarg; break;
+            case 'j': nThreads = std::atoi(optarg); break;
+            case 'o': output = optarg; break;
+            case 'h':
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (binsYamlPath.empty() || binName.empty() || vars.empty() || (cfg.metric != "zbi" && cfg.metric != "asimov") || cfg.unc <= 0.) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<BinSpec> bins;
+    try {
+        bins = loadBinsYAML(binsYamlPath, {binName});
+    } catch (const std::exception &e) {
+        std::cerr << "[optimizeCuts] ERROR reading bins YAML " << binsYamlPath << ": " << e.what() << "\n";
+        return 2;
+    }
+    if (bins.empty()) { std::cerr << "[optimizeCuts] No bin " << binName << " in " << binsYamlPath << "\n"; return 2; }
+    BinSpec base = bins.front();
+    if (!base.userCuts.empty())
+        std::cerr << "[optimizeCuts] WARNING: user-cuts of " << binName << " are not applied while scanning, only copied\n";
+
+    BuildFitInput BFI;
+    BFI.skimDir = skimDir;
+    std::vector<std::string> keptCuts; // base normal cuts not superseded by a scan
+    for (const auto &c : base.cuts) if (!replacedByScan(c, vars)) keptCuts.push_back(c);
+    std::vector<std::string> finalCuts, preselection;
+    buildCutsForBin(&BFI, keptCuts, base.lepCuts, base.predefCuts, finalCuts);
+    for (const auto &c : finalCuts) if (!c.empty()) preselection.push_back(BFI.ExpandMacros(c));
+    std::vector<std::string> scanExprs;
+    for (const auto &v : vars) scanExprs.push_back(BFI.ExpandMacros(v.expr));
+
+    // the cached table is valid for the same events, expressions, weights and samples
+    std::string keySrc = "lumi=" + std::to_string(lumi) + "\n";
+    for (const auto &c : preselection) keySrc += "cut:" + c + "\n";
+    for (const auto &e : scanExprs) keySrc += "var:" + e + "\n";
+    for (const auto &g : bkgGroups) keySrc += "bkg:" + g + "\n";
+    for (const auto &g : sigGroups) keySrc += "sig:" + g + "\n";
+    for (const auto &f : smsFilters) keySrc += "sms:" + f + "\n";
+    keySrc += "skim:" + skimDir + "\n";
+    const std::string key = CutCache::Hash(keySrc);
+
+    std::vector<EventTable> tables;
+    if (!tablePath.empty() && readTables(tablePath, key, tables)) {
+        std::cout << "[optimizeCuts] Read event table " << tablePath << "\n";
+    } else {
+        tables.clear();
+        ROOT::EnableImplicitMT(); // before the dataframes so the lepton kernel gets one buffer per slot
+        if (!smsFilters.empty()) BFTool::SetFilterSignalsSMS(smsFilters);
+        SampleTool ST;
+        ST.LoadBkgs(bkgGroups);
+        ST.LoadSigs(sigGroups);
+        std::vector<std::string> exprs = preselection;
+        exprs.insert(exprs.end(), scanExprs.begin(), scanExprs.end());
+        BFI.RequireColumns(exprs);
+        BFI.LoadBkg_byMap(ST.BkgDict, lumi);
+        BFI.LoadSig_byMap(ST.SigDict, lumi);
+
+        // one Take per column on every sample, all graphs run together
+        struct Booked {
+            std::string name;
+            bool isSignal;
+            std::vector<ROOT::RDF::RResultPtr<std::vector<float>>> cols;
+            ROOT::RDF::RResultPtr<std::vector<double>> w;
+        };
+        std::vector<Booked> booked;
+        std::vector<ROOT::RDF::RResultHandle> handles;
+        auto book = [&](std::map<std::string, std::unique_ptr<RNode>> &dict, bool isSignal) {
+            for (auto &kv : dict) {
+                ROOT::RDF::RNode node = *kv.second;
+                for (const auto &c : preselection) node = node.Filter(c);
+                Booked b{kv.first, isSignal, {}, {}};
+                for (size_t v = 0; v < scanExprs.size(); ++v) {
+                    const std::string col = "optimizeCuts_v" + std::to_string(v);
+                    node = node.Define(col, "static_cast<float>(" + scanExprs[v] + ")");
+                    b.cols.push_back(node.Take<float>(col));
+                    handles.emplace_back(b.cols.back());
+                }
+                b.w = node.Take<double>("weight_scaled");
+                handles.emplace_back(b.w);
+                booked.push_back(std::move(b));
+            }
+        };
+        book(BFI.rdf_BkgDict, false);
+        book(BFI.rdf_SigDict, true);
+        std::cout << "[optimizeCuts] Reading " << booked.size() << " samples ...\n";
+        ROOT::RDF::RunGraphs(handles);
+
+        // backgrounds are only ever used summed: one table
+        EventTable bkg;
+        bkg.name = "background";
+        bkg.cols.resize(vars.size());
+        for (auto &b : booked) {
+            if (b.isSignal) {
+                EventTable t;
+                t.name = b.name;
+                t.isSignal = true;
+                for (auto &c : b.cols) t.cols.push_back(std::move(*c));
+                t.w = std::move(*b.w);
+                tables.push_back(std::move(t));
+                continue;
+            }
+            for (size_t v = 0; v < vars.size(); ++v) bkg.cols[v].insert(bkg.cols[v].end(), b.cols[v]->begin(), b.cols[v]->end());
+            bkg.w.insert(bkg.w.end(), b.w->begin(), b.w->end());
+        }
+        tables.insert(tables.begin(), std::move(bkg));
+        if (!tablePath.empty()) {
+            if (writeTables(tablePath, key, tables)) std::cout << "[optimizeCuts] Wrote event table " << tablePath << "\n";
+            else std::cerr << "[optimizeCuts] WARNING: cannot write event table " << tablePath << "\n";
+        }
+    }
+    if (tables.size() < 2 || tables.front().isSignal) {
+        std::cerr << "[optimizeCuts] Need background and at least one signal sample\n";
+        return 3;
+    }
+    std::cout << "[optimizeCuts] " << tables.front().Size() << " background events, " << tables.size() - 1
+              << " signal points after the base cuts\n";
+
+    // --- Scan: one signal point per task ---
+    const SortedTable bkgSorted(tables.front());
+    std::vector<OptResult> results(tables.size() - 1);
+    if (nThreads == 0) nThreads = std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min<unsigned>(nThreads, results.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < results.size(); i = next++) {
+            const SortedTable sig(tables[i + 1]);
+            results[i] = optimise(sig, bkgSorted, vars, cfg);
+        }
+    };
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < nThreads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto &th : pool) th.join();
+
+    std::stable_sort(results.begin(), results.end(), [](const OptResult &a, const OptResult &b) { return a.Z > b.Z; });
+    if (top > 0 && results.size() > top) results.resize(top);
+
+    // --- Output in the bins YAML schema ---
+    const std::string tmp = output + ".tmp" + std::to_string(getpid());
+    {
+        std::ofstream ofs(tmp);
+        if (!ofs) { std::cerr << "[optimizeCuts] Cannot write " << tmp << "\n"; return 4; }
+        ofs << "# optimizeCuts.x: base bin " << binName << " of " << binsYamlPath << ", metric " << cfg.metric
+            << ", unc " << cfg.unc << ", lumi " << lumi << "\n";
+        for (const auto &r : results) {
+            std::vector<std::string> cuts = keptCuts;
+            char buf[64];
+            for (size_t v = 0; v < vars.size(); ++v) {
+                if (std::isnan(r.th[v])) continue;
+                std::snprintf(buf, sizeof(buf), "%g", r.th[v]);
+                cuts.push_back(vars[v].expr + vars[v].op + buf);
+            }
+            std::snprintf(buf, sizeof(buf), "Z=%.3f S=%.3g B=%.3g", r.Z, r.S, r.B);
+            ofs << "\n" << binName << "_" << r.signal << ": # " << buf << "\n";
+            ofs << "  cuts: \"" << joinCuts(cuts) << "\"\n";
+            ofs << "  lep-cuts: \"" << joinCuts(base.lepCuts) << "\"\n";
+            ofs << "  predefined-cuts: \"" << joinCuts(base.predefCuts) << "\"\n";
+            ofs << "  user-cuts: \"" << joinCuts(base.userCuts) << "\"\n";
+            std::cout << binName << "_" << r.signal << " " << buf << " cuts: " << joinCuts(cuts) << "\n";
+        }
+    }
+    if (std::rename(tmp.c_str(), output.c_str()) != 0) {
+        std::cerr << "[optimizeCuts] Cannot move " << tmp << " to " << output << "\n";
+        std::remove(tmp.c_str());
+        return 4;
+    }
+    std::cout << "[optimizeCuts] Wrote " << results.size() << " bins to " << output << "\n";
+    return 0;
+}